@@ -0,0 +1,75 @@
+#include "../logger/logger.hpp"
+#include "benchmark.hpp"
+#include <functional>
+#include <map>
+
+using namespace game_benchmark;
+
+namespace
+{
+
+const std::map<std::string,std::function<void(const body_count_list&)>> suites = {
+    {"spatial_index",spatial_index_benchmark},
+    {"bulk_load",bulk_load_benchmark},
+    {"parallel_query",parallel_query_benchmark},
+    {"batch_query",batch_query_benchmark},
+    {"name_pool",name_pool_benchmark},
+    {"hot_cold",hot_cold_benchmark},
+    {"galaxy_generator",galaxy_generator_benchmark},
+    {"snapshot",snapshot_benchmark},
+    {"journal",journal_benchmark},
+    {"orbits",orbits_benchmark},
+    {"gravity",gravity_benchmark},
+    {"broad_phase",broad_phase_benchmark},
+    {"hyperlanes",hyperlanes_benchmark},
+    {"route_hierarchy",route_hierarchy_benchmark},
+    {"visibility",visibility_benchmark},
+    {"influence",influence_benchmark},
+    {"rectangle_filter",rectangle_filter_benchmark}
+};
+
+void print_usage(const char* name)
+{
+    std::cout<<"Usage: "<<name<<" [suite|all] [body count]...\nAvailable suites:\n";
+    for(auto& suite : suites){
+        std::cout<<"  "<<suite.first<<"\n";
+    }
+}
+
+}
+
+/*
+ * Usage: benchmark [suite|all] [body count]...
+ * Without body counts each suite runs with its
+ * default sizes.
+ */
+int main(int argc,char** argv)
+{
+    log_inst.set_logging_level(logging::severity_type::error);
+
+    std::string selected_suite{"all"};
+    if(argc > 1){
+        selected_suite = argv[1];
+    }
+    body_count_list sizes;
+    for(int i{2};i<argc;i++){
+        sizes.push_back(std::stoull(argv[i]));
+    }
+    if(sizes.empty()){
+        sizes = {10000,100000,1000000,10000000};
+    }
+
+    bool executed{false};
+    for(auto& suite : suites){
+        if(selected_suite == "all" || selected_suite == suite.first){
+            std::cout<<"== "<<suite.first<<" ==\n";
+            suite.second(sizes);
+            executed = true;
+        }
+    }
+    if(!executed){
+        print_usage(argv[0]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <random>
+#include <iostream>
+
+namespace game_benchmark
+{
+
+using body_count_list = std::vector<std::size_t>;
+
+//Fixed seed, every run works on the same data
+static const uint64_t benchmark_seed = 0x5eed;
+
+/*
+ * Run the callable 'repetitions' times and return
+ * the average duration of one run in microseconds
+ */
+template<typename FUNC>
+double measure_us(std::size_t repetitions,FUNC&& func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t i{0};i<repetitions;i++){
+        func();
+    }
+    auto elapsed = std::chrono::duration_cast<
+            std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    return elapsed.count() / 1000.0 / repetitions;
+}
+
+/*
+ * Each benchmark suite receives the list of
+ * body counts it should be executed with
+ */
+void spatial_index_benchmark(const body_count_list& sizes);
+void rectangle_filter_benchmark(const body_count_list& sizes);
+void bulk_load_benchmark(const body_count_list& sizes);
+void parallel_query_benchmark(const body_count_list& sizes);
+void batch_query_benchmark(const body_count_list& sizes);
+void name_pool_benchmark(const body_count_list& sizes);
+void hot_cold_benchmark(const body_count_list& sizes);
+void galaxy_generator_benchmark(const body_count_list& sizes);
+void snapshot_benchmark(const body_count_list& sizes);
+void journal_benchmark(const body_count_list& sizes);
+void orbits_benchmark(const body_count_list& sizes);
+void gravity_benchmark(const body_count_list& sizes);
+void broad_phase_benchmark(const body_count_list& sizes);
+void hyperlanes_benchmark(const body_count_list& sizes);
+void route_hierarchy_benchmark(const body_count_list& sizes);
+void visibility_benchmark(const body_count_list& sizes);
+void influence_benchmark(const body_count_list& sizes);
+
+}
+
+#endif
@@ -0,0 +1,67 @@
+#include "benchmark.hpp"
+#include "../maps/simd_filter.hpp"
+#include <iomanip>
+
+namespace game_benchmark
+{
+
+using namespace game_maps;
+
+namespace
+{
+
+const uint32_t universe_side = 1 << 20;
+const std::size_t filter_repetitions = 20;
+
+}
+
+/*
+ * Throughput of the rectangle filter kernels supported
+ * by this CPU over contiguous coordinates, the area
+ * selects roughly 1/16 of the bodies.
+ */
+void rectangle_filter_benchmark(const body_count_list& sizes)
+{
+    std::vector<simd_kernel> kernels{simd_kernel::scalar};
+    if(available_simd_kernel() != simd_kernel::scalar){
+        kernels.push_back(simd_kernel::sse41);
+    }
+    if(available_simd_kernel() == simd_kernel::avx2){
+        kernels.push_back(simd_kernel::avx2);
+    }
+    std::cout<<std::setw(10)<<"bodies"<<std::setw(10)<<"kernel"
+             <<std::setw(14)<<"us/scan"<<std::setw(14)<<"bodies/ns"
+             <<std::setw(12)<<"found"<<"\n";
+    const object_area area(universe_side / 4,universe_side / 2 - 1,
+                           universe_side / 4,universe_side / 2 - 1);
+    for(auto body_count : sizes){
+        std::mt19937_64 eng(benchmark_seed);
+        std::uniform_int_distribution<uint32_t> coord(0,universe_side - 1);
+        std::vector<uint32_t> x(body_count),y(body_count),found_indexes(body_count);
+        for(std::size_t i{0};i<body_count;i++){
+            x[i] = coord(eng);
+            y[i] = coord(eng);
+        }
+        std::size_t reference_found{0};
+        for(auto kernel : kernels){
+            std::size_t found{0};
+            double scan_us = measure_us(filter_repetitions,[&](){
+                found = filter_within_area(kernel,x.data(),y.data(),body_count,
+                                           area,0,found_indexes.data());
+            });
+            if(kernel == simd_kernel::scalar){
+                reference_found = found;
+            }else if(found != reference_found){
+                std::cout<<"Mismatch! scalar found "<<reference_found<<" bodies, "
+                         <<simd_kernel_name(kernel)<<" "<<found<<"\n";
+            }
+            std::cout<<std::setw(10)<<body_count
+                     <<std::setw(10)<<simd_kernel_name(kernel)
+                     <<std::setw(14)<<std::fixed<<std::setprecision(2)<<scan_us
+                     <<std::setw(14)<<std::setprecision(3)<<body_count / (scan_us * 1000)
+                     <<std::setw(12)<<found<<"\n";
+        }
+    }
+}
+
+}
@@ -0,0 +1,1244 @@
+#include "benchmark.hpp"
+#include "../maps/maps.hpp"
+#include "../maps/generator.hpp"
+#include "../maps/orbits.hpp"
+#include "../maps/gravity.hpp"
+#include "../maps/broad_phase.hpp"
+#include "../maps/hyperlanes.hpp"
+#include "../maps/route_hierarchy.hpp"
+#include "../maps/visibility.hpp"
+#include "../maps/influence.hpp"
+#include <iomanip>
+#include <cmath>
+#include <thread>
+#include <cstdio>
+#include <fstream>
+
+namespace game_benchmark
+{
+
+using namespace game_maps;
+
+namespace
+{
+
+const uint32_t universe_side = 1 << 20;
+const std::size_t queries_per_run = 200;
+
+/*
+ * The linear scan find_bodies_within used to perform
+ * before the introduction of the uniform grid
+ */
+std::vector<celestial_body_cptr> linear_scan(const std::vector<celestial_body_ptr>& celestial_bodies,
+                                             const object_area& area)
+{
+    std::vector<celestial_body_cptr> bodies;
+    for(auto element:celestial_bodies)
+    {
+        auto body_coord = element->get_body_coordinates();
+        if(body_coord.x>=area.x_from && body_coord.x<=area.x_to &&
+           body_coord.y>=area.y_from && body_coord.y<=area.y_to)
+        {
+            bodies.push_back(element);
+        }
+    }
+    return bodies;
+}
+
+std::vector<object_area> random_areas(std::mt19937_64& eng,
+                                      uint32_t width,
+                                      uint32_t height)
+{
+    std::uniform_int_distribution<uint32_t> x_dist(0,universe_side - width),
+                                            y_dist(0,universe_side - height);
+    std::vector<object_area> areas;
+    for(std::size_t i{0};i<queries_per_run;i++){
+        uint32_t x = x_dist(eng),
+                 y = y_dist(eng);
+        areas.emplace_back(x,x + width - 1,y,y + height - 1);
+    }
+    return areas;
+}
+
+//Universe filled with a generated galaxy of body_count bodies
+universe_map make_galaxy_chart(std::size_t body_count)
+{
+    galaxy_parameters parameters;
+    parameters.seed = benchmark_seed;
+    parameters.body_count = body_count;
+    universe_map chart;
+    chart.set_universe_size(universe_side,universe_side);
+    galaxy_generator(parameters).populate(chart);
+    return chart;
+}
+
+/*
+ * Like measure_us, but the caches are flushed before each
+ * run: the queries of a game tick do not find the bodies
+ * in the cache.
+ */
+template<typename FUNC>
+double measure_cold_us(std::size_t repetitions,FUNC&& func)
+{
+    static std::vector<uint64_t> cache_flusher(16 * 1024 * 1024);
+    double total_us{0};
+    for(std::size_t i{0};i<repetitions;i++){
+        for(auto& value : cache_flusher){
+            ++value;
+        }
+        total_us += measure_us(1,func);
+    }
+    return total_us / repetitions;
+}
+
+/*
+ * Sensor ranges of fleets, the fleets gather around
+ * a few spots so that their ranges overlap
+ */
+std::vector<object_area> sensor_areas(std::mt19937_64& eng,
+                                      std::size_t area_count)
+{
+    const uint32_t sensor_side = universe_side / 64;
+    std::uniform_int_distribution<uint32_t> spot_dist(sensor_side,universe_side - 3 * sensor_side),
+                                            offset_dist(0,sensor_side);
+    std::vector<object_coordinates> spots;
+    for(std::size_t i{0};i<8;i++){
+        spots.emplace_back(spot_dist(eng),spot_dist(eng));
+    }
+    std::vector<object_area> areas;
+    for(std::size_t i{0};i<area_count;i++){
+        const auto& spot = spots[i % spots.size()];
+        uint32_t x = spot.x + offset_dist(eng),
+                 y = spot.y + offset_dist(eng);
+        areas.emplace_back(x,x + sensor_side - 1,y,y + sensor_side - 1);
+    }
+    return areas;
+}
+
+
+/*
+ * Layouts of the body data used before the split in
+ * hot and cold data: the original one owning its name and
+ * the one with the name interned in the name pool.
+ */
+struct string_object_info
+{
+    celestial_body_types body_type;
+    std::string          body_name;
+    object_coordinates   body_position;
+    celestial_body_spec  body_specifics;
+};
+
+struct merged_object_info
+{
+    celestial_body_types body_type;
+    name_id              body_name;
+    object_coordinates   body_position;
+    celestial_body_spec  body_specifics;
+};
+
+/*
+ * The update performed at each tick: the planets
+ * drift along the x axis, the stars stay still.
+ */
+template<typename RECORD>
+void drift_planets(std::vector<RECORD>& records)
+{
+    for(auto& record : records){
+        if(record.body_type == celestial_body_types::celestial_body_planet){
+            record.body_position.x = (record.body_position.x + 1) & (universe_side - 1);
+        }
+    }
+}
+
+
+//FNV-1a of the fields of the generated bodies
+uint64_t galaxy_checksum(const std::vector<celestial_body>& bodies)
+{
+    uint64_t checksum{14695981039346656037ULL};
+    auto mix = [&checksum](uint64_t value){
+        checksum = (checksum ^ value) * 1099511628211ULL;
+    };
+    for(auto& body : bodies){
+        mix(body.get_body_coordinates().x);
+        mix(body.get_body_coordinates().y);
+        mix(uint64_t(body.get_body_type()));
+        mix(body.get_body_specifics().diameter);
+        mix(body.get_body_name_id());
+    }
+    return checksum;
+}
+
+}
+
+/*
+ * Compare the old linear scan with the grid, quadtree and
+ * morton order backed find_bodies_within, for a screen
+ * sized viewport and for a zoomed out one.
+ */
+void spatial_index_benchmark(const body_count_list& sizes)
+{
+    std::cout<<std::setw(10)<<"bodies"<<std::setw(12)<<"viewport"
+             <<std::setw(14)<<"scan us/q"<<std::setw(14)<<"grid us/q"
+             <<std::setw(14)<<"qtree us/q"<<std::setw(14)<<"visit us/q"
+             <<std::setw(14)<<"morton us/q"
+             <<std::setw(12)<<"hits/q"<<"\n";
+    for(auto body_count : sizes){
+        std::mt19937_64 eng(benchmark_seed);
+        std::uniform_int_distribution<uint32_t> coord(0,universe_side - 1);
+
+        universe_map grid_chart,quadtree_chart,morton_chart;
+        grid_chart.set_spatial_index(spatial_index_type::uniform_grid);
+        grid_chart.set_universe_size(universe_side,universe_side);
+        quadtree_chart.set_spatial_index(spatial_index_type::loose_quadtree);
+        quadtree_chart.set_universe_size(universe_side,universe_side);
+        morton_chart.set_spatial_index(spatial_index_type::morton_order);
+        morton_chart.set_universe_size(universe_side,universe_side);
+        std::vector<celestial_body_ptr> celestial_bodies;
+        celestial_bodies.reserve(body_count);
+        for(std::size_t i{0};i<body_count;i++){
+            auto body = celestial_body::create(std::string(),
+                                               celestial_body_spec(),
+                                               object_coordinates(coord(eng),coord(eng)));
+            celestial_bodies.push_back(body);
+            grid_chart.add_celestial_body(body);
+            quadtree_chart.add_celestial_body(body);
+            morton_chart.add_celestial_body(body);
+        }
+
+        const std::pair<uint32_t,uint32_t> viewports[] = {
+            {1920,1080},
+            {universe_side / 16,universe_side / 16}
+        };
+        for(auto& viewport : viewports){
+            auto areas = random_areas(eng,viewport.first,viewport.second);
+            std::size_t scan_hits{0},grid_hits{0},quadtree_hits{0},area_idx{0};
+            double scan_us = measure_us(areas.size(),[&](){
+                scan_hits += linear_scan(celestial_bodies,areas[area_idx++]).size();
+            });
+            area_idx = 0;
+            double grid_us = measure_us(areas.size(),[&](){
+                grid_hits += grid_chart.find_bodies_within(areas[area_idx++]).size();
+            });
+            area_idx = 0;
+            double quadtree_us = measure_us(areas.size(),[&](){
+                quadtree_hits += quadtree_chart.find_bodies_within(areas[area_idx++]).size();
+            });
+            //Same as the quadtree, without allocations
+            std::size_t visit_hits{0};
+            area_idx = 0;
+            double visit_us = measure_us(areas.size(),[&](){
+                quadtree_chart.for_each_body_within(areas[area_idx++],
+                                                    [&visit_hits](const celestial_body_view&){
+                    ++visit_hits;
+                });
+            });
+            std::size_t morton_hits{0};
+            area_idx = 0;
+            double morton_us = measure_us(areas.size(),[&](){
+                morton_hits += morton_chart.find_bodies_within(areas[area_idx++]).size();
+            });
+            if(scan_hits != grid_hits || scan_hits != quadtree_hits ||
+               scan_hits != visit_hits || scan_hits != morton_hits){
+                std::cout<<"Mismatch! scan found "<<scan_hits<<" bodies, grid "<<grid_hits
+                         <<", quadtree "<<quadtree_hits<<", visit "<<visit_hits
+                         <<", morton "<<morton_hits<<"\n";
+            }
+            std::cout<<std::setw(10)<<body_count
+                     <<std::setw(12)<<(std::to_string(viewport.first)+"x"+std::to_string(viewport.second))
+                     <<std::setw(14)<<std::fixed<<std::setprecision(2)<<scan_us
+                     <<std::setw(14)<<grid_us
+                     <<std::setw(14)<<quadtree_us
+                     <<std::setw(14)<<visit_us
+                     <<std::setw(14)<<morton_us
+                     <<std::setw(12)<<grid_hits / areas.size()<<"\n";
+        }
+    }
+}
+
+
+
+/*
+ * Time needed to load the bodies one by one and in bulk
+ * with add_celestial_bodies, for each spatial index.
+ */
+void bulk_load_benchmark(const body_count_list& sizes)
+{
+    auto workers = std::make_shared<game_workers::worker_pool>();
+    const std::pair<spatial_index_type,const char*> index_types[] = {
+        {spatial_index_type::uniform_grid,"grid"},
+        {spatial_index_type::loose_quadtree,"quadtree"},
+        {spatial_index_type::morton_order,"morton"}
+    };
+    std::cout<<"Worker threads: "<<workers->size()<<"\n";
+    std::cout<<std::setw(10)<<"bodies"<<std::setw(12)<<"index"
+             <<std::setw(16)<<"one by one ms"<<std::setw(12)<<"bulk ms"
+             <<std::setw(16)<<"bulk 1 thr ms"<<"\n";
+    for(auto body_count : sizes){
+        std::mt19937_64 eng(benchmark_seed);
+        std::uniform_int_distribution<uint32_t> coord(0,universe_side - 1);
+        std::vector<celestial_body> celestial_bodies;
+        celestial_bodies.reserve(body_count);
+        for(std::size_t i{0};i<body_count;i++){
+            celestial_bodies.emplace_back(std::string(),
+                                          celestial_body_spec(),
+                                          object_coordinates(coord(eng),coord(eng)));
+        }
+        for(auto& index_type : index_types){
+            auto new_chart = [&index_type](){
+                auto chart = std::make_shared<universe_map>();
+                chart->set_spatial_index(index_type.first);
+                chart->set_universe_size(universe_side,universe_side);
+                return chart;
+            };
+            auto single_chart = new_chart();
+            double single_ms = measure_us(1,[&](){
+                for(auto& body : celestial_bodies){
+                    single_chart->add_celestial_body(body);
+                }
+            }) / 1000;
+            auto bulk_chart = new_chart();
+            bulk_chart->set_worker_pool(workers);
+            double bulk_ms = measure_us(1,[&](){
+                bulk_chart->add_celestial_bodies(celestial_bodies.begin(),
+                                                 celestial_bodies.end());
+            }) / 1000;
+            auto serial_chart = new_chart();
+            double serial_ms = measure_us(1,[&](){
+                serial_chart->add_celestial_bodies(celestial_bodies.begin(),
+                                                   celestial_bodies.end());
+            }) / 1000;
+            object_area probe(0,universe_side / 8,0,universe_side / 8);
+            std::size_t single_hits = single_chart->find_bodies_within(probe).size();
+            if(single_hits != bulk_chart->find_bodies_within(probe).size() ||
+               single_hits != serial_chart->find_bodies_within(probe).size()){
+                std::cout<<"Mismatch between the bulk and one by one loaded "
+                         <<index_type.second<<"!\n";
+            }
+            std::cout<<std::setw(10)<<body_count
+                     <<std::setw(12)<<index_type.second
+                     <<std::setw(16)<<std::fixed<<std::setprecision(2)<<single_ms
+                     <<std::setw(12)<<bulk_ms
+                     <<std::setw(16)<<serial_ms<<"\n";
+        }
+    }
+}
+
+/*
+ * Scaling of the parallel queries from one thread up to the
+ * hardware threads, for the whole universe, a quarter of it
+ * and an area small enough to be served by the spatial index.
+ */
+void parallel_query_benchmark(const body_count_list& sizes)
+{
+    std::vector<uint32_t> thread_counts;
+    for(uint32_t threads{1};threads < std::thread::hardware_concurrency();threads *= 2){
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(std::max(1U,std::thread::hardware_concurrency()));
+    const std::pair<uint32_t,const char*> area_sides[] = {
+        {universe_side,"full"},
+        {universe_side / 2,"quarter"},
+        {universe_side / 16,"1/256"}
+    };
+    std::cout<<std::setw(10)<<"bodies"<<std::setw(10)<<"area"
+             <<std::setw(10)<<"threads"<<std::setw(14)<<"seq ms"
+             <<std::setw(14)<<"unord ms"<<std::setw(14)<<"ordered ms"
+             <<std::setw(10)<<"speedup"<<"\n";
+    for(auto body_count : sizes){
+        std::mt19937_64 eng(benchmark_seed);
+        std::uniform_int_distribution<uint32_t> coord(0,universe_side - 1);
+        std::vector<celestial_body> celestial_bodies;
+        celestial_bodies.reserve(body_count);
+        for(std::size_t i{0};i<body_count;i++){
+            celestial_bodies.emplace_back(std::string(),
+                                          celestial_body_spec(),
+                                          object_coordinates(coord(eng),coord(eng)));
+        }
+        universe_map chart;
+        chart.set_universe_size(universe_side,universe_side);
+        chart.add_celestial_bodies(celestial_bodies.begin(),celestial_bodies.end());
+        const std::size_t repetitions = std::max<std::size_t>(1,10000000 / body_count);
+        for(auto& area_side : area_sides){
+            object_area area(0,area_side.first - 1,0,area_side.first - 1);
+            std::size_t expected = chart.find_bodies_within(area).size();
+            double seq_ms = measure_us(repetitions,[&](){
+                chart.find_bodies_within(area);
+            }) / 1000;
+            double single_thread_ms{0};
+            for(auto threads : thread_counts){
+                chart.set_worker_pool(std::make_shared<game_workers::worker_pool>(threads - 1));
+                std::size_t unordered_hits{0},ordered_hits{0};
+                double unordered_ms = measure_us(repetitions,[&](){
+                    unordered_hits = chart.find_bodies_within_parallel(area,
+                                                query_order::unordered).size();
+                }) / 1000;
+                double ordered_ms = measure_us(repetitions,[&](){
+                    ordered_hits = chart.find_bodies_within_parallel(area,
+                                                query_order::by_body_index).size();
+                }) / 1000;
+                if(unordered_hits != expected || ordered_hits != expected){
+                    std::cout<<"Mismatch! expected "<<expected<<" bodies, found "
+                             <<unordered_hits<<" and "<<ordered_hits<<"\n";
+                }
+                if(threads == 1){
+                    single_thread_ms = unordered_ms;
+                }
+                std::cout<<std::setw(10)<<body_count
+                         <<std::setw(10)<<area_side.second
+                         <<std::setw(10)<<threads
+                         <<std::setw(14)<<std::fixed<<std::setprecision(3)<<seq_ms
+                         <<std::setw(14)<<unordered_ms
+                         <<std::setw(14)<<ordered_ms
+                         <<std::setw(10)<<std::setprecision(2)<<single_thread_ms / unordered_ms<<"\n";
+            }
+            chart.set_worker_pool(nullptr);
+        }
+    }
+}
+
+/*
+ * K rectangle queries issued one at a time compared with
+ * a single batched query: sensor ranges served by the spatial
+ * index and minimap tiles served by the full scan.
+ */
+void batch_query_benchmark(const body_count_list& sizes)
+{
+    const std::pair<spatial_index_type,const char*> index_types[] = {
+        {spatial_index_type::uniform_grid,"grid"},
+        {spatial_index_type::loose_quadtree,"quadtree"},
+        {spatial_index_type::morton_order,"morton"}
+    };
+    std::cout<<std::setw(10)<<"bodies"<<std::setw(10)<<"index"
+             <<std::setw(10)<<"areas"<<std::setw(10)<<"kind"
+             <<std::setw(14)<<"single us"<<std::setw(14)<<"batch us"<<"\n";
+    for(auto body_count : sizes){
+        std::mt19937_64 eng(benchmark_seed);
+        std::uniform_int_distribution<uint32_t> coord(0,universe_side - 1);
+        std::vector<celestial_body> celestial_bodies;
+        celestial_bodies.reserve(body_count);
+        for(std::size_t i{0};i<body_count;i++){
+            celestial_bodies.emplace_back(std::string(),
+                                          celestial_body_spec(),
+                                          object_coordinates(coord(eng),coord(eng)));
+        }
+        //Minimap made of 4x4 tiles
+        std::vector<object_area> minimap_tiles;
+        for(uint32_t tile{0};tile < 16;++tile){
+            uint32_t x = (tile % 4) * (universe_side / 4),
+                     y = (tile / 4) * (universe_side / 4);
+            minimap_tiles.emplace_back(x,x + universe_side / 4 - 1,
+                                       y,y + universe_side / 4 - 1);
+        }
+        for(auto& index_type : index_types){
+            universe_map chart;
+            chart.set_spatial_index(index_type.first);
+            chart.set_universe_size(universe_side,universe_side);
+            chart.add_celestial_bodies(celestial_bodies.begin(),celestial_bodies.end());
+            std::vector<std::pair<std::vector<object_area>,const char*>> batches;
+            for(std::size_t area_count : {16,64,256}){
+                batches.emplace_back(sensor_areas(eng,area_count),"sensor");
+            }
+            batches.emplace_back(minimap_tiles,"minimap");
+            for(auto& batch : batches){
+                const auto& areas = batch.first;
+                std::size_t single_hits{0},batch_hits{0};
+                double single_us = measure_cold_us(10,[&](){
+                    for(auto& area : areas){
+                        chart.for_each_body_within(area,[&single_hits](const celestial_body_view&){
+                            ++single_hits;
+                        });
+                    }
+                });
+                double batch_us = measure_cold_us(10,[&](){
+                    chart.for_each_body_within(areas,[&batch_hits](uint32_t,const celestial_body_view&){
+                        ++batch_hits;
+                    });
+                });
+                if(single_hits != batch_hits){
+                    std::cout<<"Mismatch! single queries found "<<single_hits
+                             <<" bodies, the batch "<<batch_hits<<"\n";
+                }
+                std::cout<<std::setw(10)<<body_count
+                         <<std::setw(10)<<index_type.second
+                         <<std::setw(10)<<areas.size()
+                         <<std::setw(10)<<batch.second
+                         <<std::setw(14)<<std::fixed<<std::setprecision(2)<<single_us
+                         <<std::setw(14)<<batch_us<<"\n";
+            }
+        }
+    }
+}
+
+/*
+ * Memory used by procedurally generated names kept as
+ * std::string and interned in a name pool, and the time
+ * needed to find all the bodies with a given name.
+ */
+void name_pool_benchmark(const body_count_list& sizes)
+{
+    std::cout<<std::setw(10)<<"bodies"<<std::setw(14)<<"string MB"
+             <<std::setw(14)<<"pool MB"<<std::setw(14)<<"intern ms"
+             <<std::setw(14)<<"string cmp us"<<std::setw(14)<<"id cmp us"<<"\n";
+    for(auto body_count : sizes){
+        std::mt19937_64 eng(benchmark_seed);
+        //Catalogue names, a few of them are shared by many bodies
+        std::uniform_int_distribution<uint64_t> catalogue(0,body_count / 4);
+        std::vector<std::string> names;
+        names.reserve(body_count);
+        std::size_t string_bytes = names.capacity() * sizeof(std::string);
+        for(std::size_t i{0};i<body_count;i++){
+            names.push_back("Kepler catalogue " + std::to_string(catalogue(eng)));
+            if(names.back().capacity() > 15){
+                string_bytes += names.back().capacity() + 1;
+            }
+        }
+        name_pool pool;
+        std::vector<name_id> ids(body_count);
+        double intern_ms = measure_us(1,[&](){
+            for(std::size_t i{0};i<body_count;i++){
+                ids[i] = pool.intern(names[i]);
+            }
+        }) / 1000;
+        std::size_t pool_bytes = pool.memory_usage() + ids.capacity() * sizeof(name_id);
+
+        const std::string& wanted_name = names[body_count / 2];
+        name_id wanted_id = pool.find(wanted_name);
+        std::size_t string_hits{0},id_hits{0};
+        double string_us = measure_us(10,[&](){
+            for(auto& name : names){
+                string_hits += name == wanted_name;
+            }
+        });
+        double id_us = measure_us(10,[&](){
+            for(auto id : ids){
+                id_hits += id == wanted_id;
+            }
+        });
+        if(string_hits != id_hits){
+            std::cout<<"Mismatch! "<<string_hits<<" names found comparing the strings, "
+                     <<id_hits<<" comparing the ids\n";
+        }
+        std::cout<<std::setw(10)<<body_count
+                 <<std::setw(14)<<std::fixed<<std::setprecision(2)<<string_bytes / 1048576.0
+                 <<std::setw(14)<<pool_bytes / 1048576.0
+                 <<std::setw(14)<<intern_ms
+                 <<std::setw(14)<<string_us
+                 <<std::setw(14)<<id_us<<"\n";
+    }
+}
+
+/*
+ * Per tick update over all the bodies with the body data
+ * kept in a single record and split in hot and cold records,
+ * bytes/body is the stride of the data scanned by the update.
+ */
+void hot_cold_benchmark(const body_count_list& sizes)
+{
+    std::cout<<std::setw(10)<<"bodies"<<std::setw(12)<<"layout"
+             <<std::setw(12)<<"bytes/body"<<std::setw(14)<<"tick ms"
+             <<std::setw(14)<<"ns/body"<<"\n";
+    for(auto body_count : sizes){
+        std::mt19937_64 eng(benchmark_seed);
+        std::uniform_int_distribution<uint32_t> coord(0,universe_side - 1);
+        std::vector<string_object_info> string_records(body_count);
+        std::vector<merged_object_info> merged_records(body_count);
+        std::vector<object_hot_info> hot_records(body_count);
+        for(std::size_t i{0};i<body_count;i++){
+            object_coordinates position(coord(eng),coord(eng));
+            auto type = (i % 8) ? celestial_body_types::celestial_body_planet :
+                                  celestial_body_types::celestial_body_star;
+            string_records[i].body_type = type;
+            string_records[i].body_name = "Kepler catalogue " + std::to_string(i);
+            string_records[i].body_position = position;
+            merged_records[i].body_type = type;
+            merged_records[i].body_name = empty_name;
+            merged_records[i].body_position = position;
+            hot_records[i].body_type = type;
+            hot_records[i].body_position = position;
+        }
+        auto report = [body_count](const char* layout,std::size_t record_size,double tick_us){
+            std::cout<<std::setw(10)<<body_count
+                     <<std::setw(12)<<layout
+                     <<std::setw(12)<<record_size
+                     <<std::setw(14)<<std::fixed<<std::setprecision(2)<<tick_us / 1000
+                     <<std::setw(14)<<tick_us * 1000 / body_count<<"\n";
+        };
+        report("string",sizeof(string_object_info),measure_cold_us(5,[&](){
+            drift_planets(string_records);
+        }));
+        report("merged",sizeof(merged_object_info),measure_cold_us(5,[&](){
+            drift_planets(merged_records);
+        }));
+        report("hot",sizeof(object_hot_info),measure_cold_us(5,[&](){
+            drift_planets(hot_records);
+        }));
+        if(string_records.back().body_position.x != hot_records.back().body_position.x ||
+           merged_records.back().body_position.x != hot_records.back().body_position.x){
+            std::cout<<"Mismatch between the updated layouts!\n";
+        }
+    }
+}
+
+/*
+ * Generation of a galaxy from one thread up to the hardware
+ * threads, the checksum of the bodies shall not change with
+ * the amount of threads. Bulk loading the galaxy is timed too.
+ */
+void galaxy_generator_benchmark(const body_count_list& sizes)
+{
+    std::vector<uint32_t> thread_counts;
+    for(uint32_t threads{1};threads < std::thread::hardware_concurrency();threads *= 2){
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(std::max(1U,std::thread::hardware_concurrency()));
+    std::cout<<std::setw(10)<<"bodies"<<std::setw(10)<<"threads"
+             <<std::setw(14)<<"generate ms"<<std::setw(14)<<"load ms"
+             <<std::setw(20)<<"checksum"<<"\n";
+    for(auto body_count : sizes){
+        galaxy_parameters parameters;
+        parameters.seed = benchmark_seed;
+        parameters.body_count = body_count;
+        uint64_t first_checksum{0};
+        for(auto threads : thread_counts){
+            auto workers = std::make_shared<game_workers::worker_pool>(threads - 1);
+            galaxy_generator generator(parameters,workers);
+            std::vector<celestial_body> bodies;
+            double generate_ms = measure_us(1,[&](){
+                bodies = generator.generate(universe_side,universe_side);
+            }) / 1000;
+            universe_map chart;
+            chart.set_worker_pool(workers);
+            chart.set_universe_size(universe_side,universe_side);
+            double load_ms = measure_us(1,[&](){
+                chart.add_celestial_bodies(bodies.begin(),bodies.end());
+            }) / 1000;
+            uint64_t checksum = galaxy_checksum(bodies);
+            if(threads == thread_counts.front()){
+                first_checksum = checksum;
+            }
+            if(checksum != first_checksum || chart.get_bodies_count() != body_count){
+                std::cout<<"Mismatch! the galaxy changed with "<<threads<<" threads\n";
+            }
+            std::cout<<std::setw(10)<<body_count
+                     <<std::setw(10)<<threads
+                     <<std::setw(14)<<std::fixed<<std::setprecision(2)<<generate_ms
+                     <<std::setw(14)<<load_ms
+                     <<std::setw(20)<<std::hex<<checksum<<std::dec<<"\n";
+        }
+    }
+}
+
+/*
+ * Startup from a snapshot against generating the galaxy again:
+ * opening the snapshot maps it without reading the bodies,
+ * the first queries on the mapping pay the page faults.
+ */
+void snapshot_benchmark(const body_count_list& sizes)
+{
+    const std::string snapshot_file{"benchmark.snap"};
+    std::cout<<std::setw(10)<<"bodies"<<std::setw(14)<<"generate ms"
+             <<std::setw(12)<<"save ms"<<std::setw(12)<<"open ms"
+             <<std::setw(14)<<"queries ms"<<std::setw(12)<<"load ms"
+             <<std::setw(10)<<"MB"<<"\n";
+    for(auto body_count : sizes){
+        galaxy_parameters parameters;
+        parameters.seed = benchmark_seed;
+        parameters.body_count = body_count;
+        galaxy_generator generator(parameters);
+        universe_map chart;
+        chart.set_universe_size(universe_side,universe_side);
+        double generate_ms = measure_us(1,[&](){
+            generator.populate(chart);
+        }) / 1000;
+        double save_ms = measure_us(1,[&](){
+            chart.save_snapshot(snapshot_file);
+        }) / 1000;
+        universe_snapshot snapshot;
+        double open_ms = measure_us(1,[&](){
+            snapshot.open(snapshot_file);
+        }) / 1000;
+        std::mt19937_64 eng(benchmark_seed);
+        auto areas = random_areas(eng,universe_side / 64,universe_side / 64);
+        std::size_t found{0};
+        double queries_ms = measure_us(1,[&](){
+            for(const auto& area : areas){
+                snapshot.for_each_body_within(area,[&found](uint32_t){
+                    ++found;
+                });
+            }
+        }) / 1000;
+        universe_map loaded_chart;
+        double load_ms = measure_us(1,[&](){
+            loaded_chart.load_snapshot(snapshot);
+        }) / 1000;
+        if(loaded_chart.get_bodies_count() != chart.get_bodies_count()){
+            std::cout<<"Mismatch! the snapshot lost some body\n";
+        }
+        std::cout<<std::setw(10)<<body_count
+                 <<std::setw(14)<<std::fixed<<std::setprecision(2)<<generate_ms
+                 <<std::setw(12)<<save_ms
+                 <<std::setw(12)<<open_ms
+                 <<std::setw(14)<<queries_ms
+                 <<std::setw(12)<<load_ms
+                 <<std::setw(10)<<std::ifstream(snapshot_file,std::ios::ate | std::ios::binary).tellg() /
+                                     double(1 << 20)<<"\n";
+        snapshot.close();
+        std::remove(snapshot_file.c_str());
+    }
+}
+
+/*
+ * Autosave of a fixed amount of edits: the journal cost follows
+ * the edits while the full snapshot follows the universe size.
+ */
+void journal_benchmark(const body_count_list& sizes)
+{
+    const std::string snapshot_file{"benchmark.snap"},
+                      journal_file{"benchmark.jrnl"};
+    const std::size_t edits_per_autosave = 10000;
+    std::cout<<std::setw(10)<<"bodies"<<std::setw(10)<<"edits"
+             <<std::setw(14)<<"record ms"<<std::setw(14)<<"journal ms"
+             <<std::setw(14)<<"snapshot ms"<<std::setw(12)<<"replay ms"<<"\n";
+    for(auto body_count : sizes){
+        universe_map chart = make_galaxy_chart(body_count);
+        chart.save_snapshot(snapshot_file);
+        std::remove(journal_file.c_str());
+        auto journal = std::make_shared<universe_journal>();
+        journal->open(journal_file);
+        chart.set_journal(journal);
+        std::mt19937_64 eng(benchmark_seed);
+        std::uniform_int_distribution<uint32_t> body_dist(0,chart.get_bodies_count() - 1),
+                                                position_dist(0,universe_side - 1);
+        double record_ms = measure_us(1,[&](){
+            for(std::size_t edit{0};edit < edits_per_autosave;++edit){
+                chart.move_celestial_body(body_dist(eng),
+                                          object_coordinates(position_dist(eng),position_dist(eng)));
+            }
+        }) / 1000;
+        double journal_ms = measure_us(1,[&](){
+            journal->flush();
+            journal->wait();
+        }) / 1000;
+        chart.set_journal(nullptr);
+        double snapshot_ms = measure_us(1,[&](){
+            chart.save_snapshot("benchmark_full.snap");
+        }) / 1000;
+        universe_snapshot snapshot;
+        snapshot.open(snapshot_file);
+        universe_map loaded_chart;
+        loaded_chart.load_snapshot(snapshot);
+        uint64_t replayed{0};
+        double replay_ms = measure_us(1,[&](){
+            replayed = universe_journal::replay(journal_file,loaded_chart);
+        }) / 1000;
+        if(replayed != edits_per_autosave){
+            std::cout<<"Mismatch! only "<<replayed<<" edits replayed\n";
+        }
+        std::cout<<std::setw(10)<<body_count
+                 <<std::setw(10)<<edits_per_autosave
+                 <<std::setw(14)<<std::fixed<<std::setprecision(2)<<record_ms
+                 <<std::setw(14)<<journal_ms
+                 <<std::setw(14)<<snapshot_ms
+                 <<std::setw(12)<<replay_ms<<"\n";
+        snapshot.close();
+        std::remove(snapshot_file.c_str());
+        std::remove("benchmark_full.snap");
+        std::remove(journal_file.c_str());
+    }
+}
+
+/*
+ * One tick of orbital motion, each body count is the amount of
+ * planets orbiting a thousand stars. The solve is timed with each
+ * kernel, the advance includes moving the bodies in the map.
+ */
+void orbits_benchmark(const body_count_list& sizes)
+{
+    const uint32_t star_count = 1000,
+                   ticks = 5;
+    std::vector<simd_kernel> kernels{simd_kernel::scalar};
+    if(available_simd_kernel() == simd_kernel::avx2){
+        kernels.push_back(simd_kernel::avx2);
+    }
+    std::cout<<std::setw(10)<<"orbits"<<std::setw(10)<<"kernel"
+             <<std::setw(14)<<"solve ms"<<std::setw(14)<<"advance ms"<<"\n";
+    auto workers = std::make_shared<game_workers::worker_pool>();
+    for(auto body_count : sizes){
+        std::mt19937_64 eng(benchmark_seed);
+        std::uniform_int_distribution<uint32_t> star_dist(universe_side / 16,universe_side - universe_side / 16);
+        std::uniform_real_distribution<double> unit(0,1);
+        universe_map chart;
+        chart.set_worker_pool(workers);
+        chart.set_universe_size(universe_side,universe_side);
+        std::vector<body_handle> stars;
+        for(uint32_t star{0};star < star_count;++star){
+            stars.push_back(chart.add_celestial_body(celestial_body("",celestial_body_spec(),
+                                                                    object_coordinates(star_dist(eng),star_dist(eng)),
+                                                                    celestial_body_types::celestial_body_star)));
+        }
+        std::vector<celestial_body> planets(body_count,
+                                            celestial_body("",celestial_body_spec(),object_coordinates(),
+                                                           celestial_body_types::celestial_body_planet));
+        chart.add_celestial_bodies(planets.begin(),planets.end());
+        orbit_system orbits;
+        orbits.set_worker_pool(workers);
+        for(uint32_t body_index{star_count};body_index < chart.get_bodies_count();++body_index){
+            orbital_elements elements;
+            elements.parent = stars[body_index % star_count];
+            elements.semi_major_axis = 100 + unit(eng) * (universe_side / 32);
+            elements.eccentricity = unit(eng) * 0.5;
+            elements.argument_of_periapsis = unit(eng) * 6.283185307179586;
+            elements.mean_anomaly = unit(eng) * 6.283185307179586;
+            elements.mean_motion = 0.001 + unit(eng) * 0.01;
+            orbits.add_orbit(chart.get_body(body_index).get_body_handle(),elements);
+        }
+        for(auto kernel : kernels){
+            orbits.set_kernel(kernel);
+            long long tick{0};
+            double solve_ms = measure_us(ticks,[&](){
+                orbits.solve(++tick);
+            }) / 1000;
+            double advance_ms = measure_us(ticks,[&](){
+                orbits.advance(chart,++tick);
+            }) / 1000;
+            std::cout<<std::setw(10)<<orbits.get_orbits_count()
+                     <<std::setw(10)<<simd_kernel_name(kernel)
+                     <<std::setw(14)<<std::fixed<<std::setprecision(2)<<solve_ms
+                     <<std::setw(14)<<advance_ms<<"\n";
+        }
+    }
+}
+
+/*
+ * Barnes-Hut against the exact sum on the galaxy bodies, for
+ * some opening angles. The exact sum is O(N^2), so it is timed
+ * and compared on a sample of points only.
+ */
+void gravity_benchmark(const body_count_list& sizes)
+{
+    const std::size_t sample_points = 1000;
+    auto workers = std::make_shared<game_workers::worker_pool>();
+    std::cout<<std::setw(10)<<"bodies"<<std::setw(8)<<"angle"
+             <<std::setw(12)<<"build ms"<<std::setw(14)<<"tree ms"
+             <<std::setw(14)<<"exact ms"<<std::setw(12)<<"rel error"<<"\n";
+    for(auto body_count : sizes){
+        universe_map chart = make_galaxy_chart(body_count);
+        std::mt19937_64 eng(benchmark_seed);
+        std::uniform_real_distribution<double> position_dist(0,universe_side);
+        std::vector<gravity_vector> points(sample_points);
+        for(auto& point : points){
+            point = gravity_vector(position_dist(eng),position_dist(eng));
+        }
+        gravity_parameters exact_parameters;
+        exact_parameters.mode = gravity_mode::exact;
+        gravity_field exact_field(exact_parameters);
+        exact_field.set_worker_pool(workers);
+        exact_field.build(chart);
+        std::vector<gravity_vector> exact;
+        double exact_ms = measure_us(1,[&](){
+            exact = exact_field.accelerations_at(points);
+        }) / 1000;
+        for(double opening_angle : {0.3,0.5,0.8}){
+            gravity_parameters tree_parameters;
+            tree_parameters.opening_angle = opening_angle;
+            gravity_field tree_field(tree_parameters);
+            tree_field.set_worker_pool(workers);
+            double build_ms = measure_us(1,[&](){
+                tree_field.build(chart);
+            }) / 1000;
+            std::vector<gravity_vector> approximated;
+            double tree_ms = measure_us(1,[&](){
+                approximated = tree_field.accelerations_at(points);
+            }) / 1000;
+            double error{0},magnitude{0};
+            for(std::size_t point{0};point < sample_points;++point){
+                error += std::hypot(approximated[point].x - exact[point].x,
+                                    approximated[point].y - exact[point].y);
+                magnitude += std::hypot(exact[point].x,exact[point].y);
+            }
+            std::cout<<std::setw(10)<<body_count
+                     <<std::setw(8)<<std::fixed<<std::setprecision(2)<<opening_angle
+                     <<std::setw(12)<<build_ms
+                     <<std::setw(14)<<tree_ms
+                     <<std::setw(14)<<exact_ms
+                     <<std::setw(12)<<std::scientific<<std::setprecision(2)
+                     <<error / magnitude<<std::fixed<<"\n";
+        }
+    }
+}
+
+/*
+ * Objects drifting by few units each tick: the incremental
+ * update against sorting everything again at each tick
+ */
+void broad_phase_benchmark(const body_count_list& sizes)
+{
+    const uint32_t ticks = 20,
+                   object_radius = 64,
+                   max_drift = 4;
+    //The proximity pairs take about 100 bytes per object
+    const std::size_t max_objects = 2000000;
+    std::cout<<std::setw(10)<<"objects"<<std::setw(12)<<"insert ms"
+             <<std::setw(12)<<"tick ms"<<std::setw(14)<<"rebuild ms"
+             <<std::setw(14)<<"swaps/tick"<<std::setw(10)<<"pairs"<<"\n";
+    for(auto object_count : sizes){
+        if(object_count > max_objects){
+            std::cout<<std::setw(10)<<object_count<<"  skipped, above "<<max_objects<<" objects\n";
+            continue;
+        }
+        std::mt19937_64 eng(benchmark_seed);
+        std::uniform_int_distribution<uint32_t> position_dist(max_drift * ticks,
+                                                              universe_side - max_drift * ticks);
+        std::uniform_int_distribution<int> drift_dist(-int(max_drift),max_drift);
+        std::vector<object_coordinates> positions(object_count);
+        for(auto& position : positions){
+            position = object_coordinates(position_dist(eng),position_dist(eng));
+        }
+        sweep_and_prune broad_phase;
+        double insert_ms = measure_us(1,[&](){
+            for(uint64_t object{0};object < object_count;++object){
+                broad_phase.add_object(object,proximity_area(positions[object],object_radius));
+            }
+            broad_phase.update();
+        }) / 1000;
+        double tick_us{0};
+        uint64_t swaps{0};
+        for(uint32_t tick{0};tick < ticks;++tick){
+            for(uint64_t object{0};object < object_count;++object){
+                positions[object].x += drift_dist(eng);
+                positions[object].y += drift_dist(eng);
+                broad_phase.update_object(object,proximity_area(positions[object],object_radius));
+            }
+            tick_us += measure_us(1,[&](){
+                broad_phase.update();
+            });
+            swaps += broad_phase.get_last_swaps();
+        }
+        double rebuild_ms = measure_us(1,[&](){
+            sweep_and_prune rebuilt;
+            for(uint64_t object{0};object < object_count;++object){
+                rebuilt.add_object(object,proximity_area(positions[object],object_radius));
+            }
+            rebuilt.update();
+        }) / 1000;
+        std::cout<<std::setw(10)<<object_count
+                 <<std::setw(12)<<std::fixed<<std::setprecision(2)<<insert_ms
+                 <<std::setw(12)<<tick_us / ticks / 1000
+                 <<std::setw(14)<<rebuild_ms
+                 <<std::setw(14)<<swaps / ticks
+                 <<std::setw(10)<<broad_phase.get_pairs_count()<<"\n";
+    }
+}
+
+/*
+ * Hyperlanes over the stars of a generated galaxy, then
+ * the routes of many fleets sharing few destinations
+ */
+void hyperlanes_benchmark(const body_count_list& sizes)
+{
+    const std::size_t fleets = 10000,
+                      destinations = 50;
+    const std::size_t max_bodies = 2000000;
+    auto workers = std::make_shared<game_workers::worker_pool>();
+    std::cout<<std::setw(10)<<"bodies"<<std::setw(10)<<"stars"
+             <<std::setw(10)<<"lanes"<<std::setw(12)<<"build ms"
+             <<std::setw(14)<<"uncached ms"<<std::setw(12)<<"cached ms"
+             <<std::setw(10)<<"hits"<<"\n";
+    for(auto body_count : sizes){
+        if(body_count > max_bodies){
+            std::cout<<std::setw(10)<<body_count<<"  skipped, above "<<max_bodies<<" bodies\n";
+            continue;
+        }
+        universe_map chart = make_galaxy_chart(body_count);
+        auto graph = std::make_shared<hyperlane_graph>();
+        graph->set_worker_pool(workers);
+        double build_ms = measure_us(1,[&](){
+            graph->build(chart);
+        }) / 1000;
+        if(graph->get_stars_count() == 0)
+            continue;
+        std::mt19937_64 eng(benchmark_seed);
+        std::uniform_int_distribution<uint32_t> star_dist(0,graph->get_stars_count() - 1);
+        std::vector<body_handle> targets(destinations);
+        for(auto& target : targets){
+            target = graph->get_star_handle(star_dist(eng));
+        }
+        //Each fleet departs from one of few systems
+        std::vector<std::pair<body_handle,body_handle>> requests(fleets);
+        for(std::size_t fleet{0};fleet < fleets;++fleet){
+            requests[fleet] = {graph->get_star_handle(star_dist(eng) % destinations),
+                               targets[fleet % destinations]};
+        }
+        route_planner uncached_planner;
+        uncached_planner.set_graph(graph);
+        uncached_planner.set_cache_size(0);
+        uncached_planner.set_worker_pool(workers);
+        std::vector<std::pair<body_handle,body_handle>> sample(requests.begin(),requests.begin() + 100);
+        double uncached_ms = measure_us(1,[&](){
+            uncached_planner.find_routes(sample);
+        }) / 1000 * fleets / sample.size();
+        route_planner planner;
+        planner.set_graph(graph);
+        planner.set_cache_size(destinations * destinations);
+        planner.set_worker_pool(workers);
+        planner.find_routes(requests);
+        double cached_ms = measure_us(1,[&](){
+            planner.find_routes(requests);
+        }) / 1000;
+        std::cout<<std::setw(10)<<body_count
+                 <<std::setw(10)<<graph->get_stars_count()
+                 <<std::setw(10)<<graph->get_lanes_count()
+                 <<std::setw(12)<<std::fixed<<std::setprecision(2)<<build_ms
+                 <<std::setw(14)<<uncached_ms
+                 <<std::setw(12)<<cached_ms
+                 <<std::setw(10)<<planner.get_cache_hits()<<"\n";
+    }
+}
+
+/*
+ * Long routes between random stars: A* on the hyperlanes
+ * against the search on the abstract graph, then refined
+ * up to the first segment or to the whole route
+ */
+void route_hierarchy_benchmark(const body_count_list& sizes)
+{
+    const std::size_t routes = 100,
+                      stars_per_cluster = 256;
+    const std::size_t max_bodies = 2000000;
+    auto workers = std::make_shared<game_workers::worker_pool>();
+    std::cout<<std::setw(10)<<"stars"<<std::setw(10)<<"clusters"
+             <<std::setw(10)<<"borders"<<std::setw(12)<<"build ms"
+             <<std::setw(12)<<"A* us"<<std::setw(14)<<"abstract us"
+             <<std::setw(12)<<"first us"<<std::setw(12)<<"full us"
+             <<std::setw(12)<<"max error"<<"\n";
+    for(auto body_count : sizes){
+        if(body_count > max_bodies){
+            std::cout<<std::setw(10)<<body_count<<"  skipped, above "<<max_bodies<<" bodies\n";
+            continue;
+        }
+        universe_map chart = make_galaxy_chart(body_count);
+        auto graph = std::make_shared<hyperlane_graph>();
+        graph->set_worker_pool(workers);
+        graph->build(chart);
+        uint32_t stars_count = graph->get_stars_count();
+        if(stars_count < 2)
+            continue;
+        auto hierarchy = std::make_shared<route_hierarchy>();
+        hierarchy->set_worker_pool(workers);
+        hierarchy->set_cluster_capacity(stars_per_cluster);
+        double build_ms = measure_us(1,[&](){
+            hierarchy->build(graph);
+        }) / 1000;
+        std::mt19937_64 eng(benchmark_seed);
+        std::uniform_int_distribution<uint32_t> star_dist(0,stars_count - 1);
+        std::vector<std::pair<uint32_t,uint32_t>> endpoints(routes);
+        for(auto& route : endpoints){
+            route = {star_dist(eng),star_dist(eng)};
+        }
+        std::vector<double> lengths(routes);
+        std::vector<uint32_t> path;
+        double plain_us = measure_us(1,[&](){
+            for(std::size_t route{0};route < routes;++route){
+                lengths[route] = graph->find_path(endpoints[route].first,endpoints[route].second,path);
+            }
+        }) / routes;
+        std::vector<hierarchical_route> found(routes);
+        double abstract_us = measure_us(1,[&](){
+            for(std::size_t route{0};route < routes;++route){
+                found[route] = hierarchy->find_route(graph->get_star_handle(endpoints[route].first),
+                                                     graph->get_star_handle(endpoints[route].second));
+            }
+        }) / routes;
+        double first_us = measure_us(1,[&](){
+            for(auto& route : found){
+                route.refine();
+            }
+        }) / routes;
+        double full_us = measure_us(1,[&](){
+            for(auto& route : found){
+                route.refine_all();
+            }
+        }) / routes + first_us;
+        double max_error{0};
+        for(std::size_t route{0};route < routes;++route){
+            max_error = std::max(max_error,std::abs(found[route].get_length() - lengths[route]) /
+                                           std::max(1.0,lengths[route]));
+        }
+        std::cout<<std::setw(10)<<stars_count
+                 <<std::setw(10)<<hierarchy->get_clusters_count()
+                 <<std::setw(10)<<hierarchy->get_border_stars_count()
+                 <<std::setw(12)<<std::fixed<<std::setprecision(2)<<build_ms
+                 <<std::setw(12)<<plain_us
+                 <<std::setw(14)<<abstract_us
+                 <<std::setw(12)<<first_us
+                 <<std::setw(12)<<full_us
+                 <<std::setw(12)<<std::scientific<<std::setprecision(2)
+                 <<max_error<<std::fixed<<"\n";
+    }
+}
+
+
+/*
+ * Fleets of few players moving their sensors a little each
+ * tick: the incremental update against computing the fog of
+ * war from scratch, then an area query filtered by visibility
+ */
+void visibility_benchmark(const body_count_list& sizes)
+{
+    const uint32_t players = 8,
+                   sensors_per_player = 1000,
+                   sensor_range = universe_side / 128,
+                   max_drift = 256,
+                   ticks = 20;
+    auto workers = std::make_shared<game_workers::worker_pool>();
+    std::cout<<std::setw(10)<<"bodies"<<std::setw(12)<<"tick ms"
+             <<std::setw(12)<<"cells/tick"<<std::setw(14)<<"rebuild ms"
+             <<std::setw(12)<<"visible"<<std::setw(14)<<"filtered us"
+             <<std::setw(14)<<"all us"<<std::setw(14)<<"seen ratio"<<"\n";
+    for(auto body_count : sizes){
+        universe_map chart = make_galaxy_chart(body_count);
+
+        std::mt19937_64 eng(benchmark_seed);
+        std::uniform_int_distribution<uint32_t> position_dist(max_drift * ticks,
+                                                              universe_side - max_drift * ticks);
+        std::uniform_int_distribution<int> drift_dist(-int(max_drift),max_drift);
+        visibility_map fog;
+        fog.set_worker_pool(workers);
+        fog.set_universe_size(universe_side,universe_side);
+        std::vector<object_coordinates> positions(players * sensors_per_player);
+        for(uint32_t player{0};player < players;++player){
+            fog.add_player();
+        }
+        for(uint32_t sensor{0};sensor < positions.size();++sensor){
+            positions[sensor] = object_coordinates(position_dist(eng),position_dist(eng));
+            fog.add_sensor(sensor % players,sensor,positions[sensor],sensor_range);
+        }
+        fog.update(chart);
+
+        double tick_us{0};
+        std::size_t changed_cells{0};
+        for(uint32_t tick{0};tick < ticks;++tick){
+            tick_us += measure_us(1,[&](){
+                for(uint32_t sensor{0};sensor < positions.size();++sensor){
+                    positions[sensor].x += drift_dist(eng);
+                    positions[sensor].y += drift_dist(eng);
+                    fog.update_sensor(sensor,positions[sensor],sensor_range);
+                }
+                changed_cells += fog.update(chart);
+            });
+        }
+        double rebuild_ms = measure_us(1,[&](){
+            fog.rebuild(chart);
+        }) / 1000;
+
+        auto areas = random_areas(eng,universe_side / 16,universe_side / 16);
+        const body_bitset& visible = fog.get_visible(0);
+        std::size_t found{0};
+        double filtered_us = measure_us(1,[&](){
+            for(const auto& area : areas){
+                found += chart.find_bodies_within(area,visible).size();
+            }
+        }) / areas.size();
+        std::size_t within{0};
+        double unfiltered_us = measure_us(1,[&](){
+            for(const auto& area : areas){
+                within += chart.find_bodies_within(area).size();
+            }
+        }) / areas.size();
+        std::cout<<std::setw(10)<<body_count
+                 <<std::setw(12)<<std::fixed<<std::setprecision(2)<<tick_us / ticks / 1000
+                 <<std::setw(12)<<changed_cells / ticks
+                 <<std::setw(14)<<rebuild_ms
+                 <<std::setw(12)<<visible.count()
+                 <<std::setw(14)<<filtered_us
+                 <<std::setw(14)<<unfiltered_us
+                 <<std::setw(14)<<std::setprecision(3)<<double(found) / std::max<std::size_t>(1,within)<<"\n";
+    }
+}
+
+
+/*
+ * Empire borders over the stars of a generated galaxy on a
+ * 4096x4096 raster: the whole jump flood with both kernels,
+ * then a single system changing owner, or moving
+ */
+void influence_benchmark(const body_count_list& sizes)
+{
+    const uint32_t grid_size = 4096,
+                   empires = 16,
+                   owner_changes = 100;
+    auto workers = std::make_shared<game_workers::worker_pool>();
+    std::cout<<std::setw(10)<<"bodies"<<std::setw(10)<<"systems"
+             <<std::setw(12)<<"scalar ms"<<std::setw(12)<<"avx2 ms"
+             <<std::setw(14)<<"relabel ms"<<std::setw(12)<<"move ms"<<"\n";
+    for(auto body_count : sizes){
+        universe_map chart = make_galaxy_chart(body_count);
+
+        std::mt19937_64 eng(benchmark_seed);
+        std::uniform_int_distribution<uint32_t> owner_dist(0,empires);
+        influence_map borders;
+        borders.set_worker_pool(workers);
+        borders.set_universe_size(universe_side,universe_side);
+        borders.set_grid_size(grid_size,grid_size);
+        std::vector<uint64_t> systems;
+        std::vector<object_coordinates> positions;
+        for(uint32_t body{0};body < chart.get_bodies_count();++body){
+            auto view = chart.get_body(body);
+            if(view.get_body_type() != celestial_body_types::celestial_body_star)
+                continue;
+            //Some systems are still unclaimed
+            uint32_t owner = owner_dist(eng);
+            borders.set_system(view.get_body_unique_id(),view.get_body_coordinates(),
+                               owner == empires ? no_owner : owner);
+            systems.push_back(view.get_body_unique_id());
+            positions.push_back(view.get_body_coordinates());
+        }
+        if(systems.empty())
+            continue;
+        borders.set_kernel(simd_kernel::scalar);
+        double scalar_ms = measure_us(1,[&](){
+            borders.set_influence_radius(0);
+            borders.set_universe_size(universe_side,universe_side);
+            borders.update();
+        }) / 1000;
+        std::vector<uint16_t> scalar_owners = borders.get_owners();
+        borders.set_kernel(available_simd_kernel());
+        double vector_ms = measure_us(1,[&](){
+            borders.set_universe_size(universe_side,universe_side);
+            borders.update();
+        }) / 1000;
+        if(scalar_owners != borders.get_owners()){
+            std::cout<<"  the kernels disagree\n";
+        }
+        std::uniform_int_distribution<std::size_t> system_dist(0,systems.size() - 1);
+        double relabel_us{0};
+        for(uint32_t change{0};change < owner_changes;++change){
+            borders.set_owner(systems[system_dist(eng)],owner_dist(eng) % empires);
+            relabel_us += measure_us(1,[&](){
+                borders.update();
+            });
+        }
+        //A system jumps by up to a thousandth of the universe, only its surroundings are flooded
+        std::uniform_int_distribution<int64_t> jump_dist(-int64_t(universe_side / 1000),universe_side / 1000);
+        double move_us{0};
+        for(uint32_t change{0};change < owner_changes;++change){
+            std::size_t system = system_dist(eng);
+            object_coordinates& position = positions[system];
+            position.x = std::min<int64_t>(universe_side - 1,std::max<int64_t>(0,position.x + jump_dist(eng)));
+            position.y = std::min<int64_t>(universe_side - 1,std::max<int64_t>(0,position.y + jump_dist(eng)));
+            borders.set_system(systems[system],position,owner_dist(eng) % empires);
+            move_us += measure_us(1,[&](){
+                borders.update();
+            });
+        }
+        std::cout<<std::setw(10)<<body_count
+                 <<std::setw(10)<<systems.size()
+                 <<std::setw(12)<<std::fixed<<std::setprecision(2)<<scalar_ms
+                 <<std::setw(12)<<vector_ms
+                 <<std::setw(14)<<std::setprecision(3)<<relabel_us / owner_changes / 1000
+                 <<std::setw(12)<<move_us / owner_changes / 1000<<"\n";
+    }
+}
+
+}
@@ -9,6 +9,7 @@
 #include <iostream>
 #include <typeinfo>
 #include <mutex>
+#include <vector>
 
 namespace game_events
 {
@@ -59,6 +60,13 @@ public:
         return 1;
     }
 
+    uint32_t get_x() const{
+        return x_coord;
+    }
+    uint32_t get_y() const{
+        return y_coord;
+    }
+
     ~mouse_left_button_down_evt(){}
 };
 
@@ -78,9 +86,49 @@ public:
         return 2;
     }
 
+    uint32_t get_x() const{
+        return x_coord;
+    }
+    uint32_t get_y() const{
+        return y_coord;
+    }
+
     ~mouse_left_button_up_evt(){}
 };
 
+/*
+ * Two objects started or stopped to be close, the
+ * objects are identified by the id given by the owner
+ * of the proximity detection.
+ */
+struct proximity_change
+{
+    uint64_t first,
+             second;
+    bool     entered;
+};
+
+//All the proximity changes of one update, in one event
+class proximity_evt : public game_event_type
+{
+    std::vector<proximity_change> changes;
+public:
+    explicit proximity_evt(std::vector<proximity_change> new_changes):
+        game_event_type(4),
+        changes{std::move(new_changes)}
+    {}
+
+    event_id_t get_id(){
+        return 4;
+    }
+
+    const std::vector<proximity_change>& get_changes() const{
+        return changes;
+    }
+
+    ~proximity_evt(){}
+};
+
 template<typename EVENT_TYPE>
 class event_factory
 {
@@ -0,0 +1,93 @@
+#include "bodies.hpp"
+
+namespace game_maps
+{
+
+namespace
+{
+
+template<typename T>
+void reorder_array(std::vector<T>& data,
+                   const std::vector<uint32_t>& order)
+{
+    std::vector<T> reordered;
+    reordered.reserve(data.size());
+    for(auto source : order){
+        reordered.push_back(std::move(data[source]));
+    }
+    data.swap(reordered);
+}
+
+}
+
+void body_storage::reserve(std::size_t capacity)
+{
+    x.reserve(capacity);
+    y.reserve(capacity);
+    type.reserve(capacity);
+    handle.reserve(capacity);
+    cold.reserve(capacity);
+}
+
+uint32_t body_storage::add(const body_handle& new_handle,
+                           const celestial_body& body)
+{
+    const auto& position = body.get_body_coordinates();
+    x.push_back(position.x);
+    y.push_back(position.y);
+    type.push_back(body.get_body_type());
+    handle.push_back(new_handle);
+    cold.push_back(body.get_cold_info());
+    return x.size() - 1;
+}
+
+void body_storage::remove(uint32_t body_index)
+{
+    uint32_t last_index = x.size() - 1;
+    if(body_index != last_index){
+        x[body_index] = x[last_index];
+        y[body_index] = y[last_index];
+        type[body_index] = type[last_index];
+        handle[body_index] = handle[last_index];
+        cold[body_index] = cold[last_index];
+    }
+    x.pop_back();
+    y.pop_back();
+    type.pop_back();
+    handle.pop_back();
+    cold.pop_back();
+}
+
+void body_storage::clear()
+{
+    x.clear();
+    y.clear();
+    type.clear();
+    handle.clear();
+    cold.clear();
+}
+
+void body_storage::reorder(const std::vector<uint32_t>& order)
+{
+    reorder_array(x,order);
+    reorder_array(y,order);
+    reorder_array(type,order);
+    reorder_array(handle,order);
+    reorder_array(cold,order);
+}
+
+void body_storage::assign(const uint32_t* new_x,
+                          const uint32_t* new_y,
+                          const celestial_body_types* new_type,
+                          const body_handle* new_handle,
+                          std::vector<object_cold_info>&& new_cold)
+{
+    std::size_t count = new_cold.size();
+    x.assign(new_x,new_x + count);
+    y.assign(new_y,new_y + count);
+    type.assign(new_type,new_type + count);
+    handle.assign(new_handle,new_handle + count);
+    cold = std::move(new_cold);
+}
+
+}
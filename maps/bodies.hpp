@@ -0,0 +1,138 @@
+#ifndef BODIES_HPP
+#define BODIES_HPP
+
+#include "position.hpp"
+#include "objects.hpp"
+#include "slot_map.hpp"
+#include "name_pool.hpp"
+#include <vector>
+#include <string_view>
+
+namespace game_maps
+{
+
+using namespace coordinates;
+using namespace objects;
+
+/*
+ * Storage for the celestial bodies of the universe map.
+ * The hot data, touched by the queries and at each tick,
+ * are kept each in its own contiguous array so that scanning
+ * the positions does not drag through the cache the remaining
+ * data. The cold data, read only when a body is inspected,
+ * are kept together in a single record per body.
+ */
+class body_storage
+{
+    //Hot data
+    std::vector<uint32_t>             x,
+                                      y;
+    std::vector<celestial_body_types> type;
+    //Cold data
+    std::vector<body_handle>          handle;
+    std::vector<object_cold_info>     cold;
+public:
+    uint32_t size() const{
+        return x.size();
+    }
+    void reserve(std::size_t capacity);
+    uint32_t add(const body_handle& new_handle,
+                 const celestial_body& body);
+    //The last body is moved in place of the removed one
+    void remove(uint32_t body_index);
+    void clear();
+    //The body at position i is moved from position order[i]
+    void reorder(const std::vector<uint32_t>& order);
+    //Replace all the bodies, the hot arrays are copied as they are
+    void assign(const uint32_t* new_x,
+                const uint32_t* new_y,
+                const celestial_body_types* new_type,
+                const body_handle* new_handle,
+                std::vector<object_cold_info>&& new_cold);
+
+    object_coordinates position(uint32_t body_index) const{
+        return object_coordinates(x[body_index],y[body_index]);
+    }
+    void set_position(uint32_t body_index,
+                      const object_coordinates& new_position){
+        x[body_index] = new_position.x;
+        y[body_index] = new_position.y;
+    }
+
+    const uint32_t* x_data() const{
+        return x.data();
+    }
+    const uint32_t* y_data() const{
+        return y.data();
+    }
+    void set_specifics(uint32_t body_index,
+                       const celestial_body_spec& specifics){
+        cold[body_index].body_specifics = specifics;
+    }
+    uint32_t body_diameter(uint32_t body_index) const{
+        return cold[body_index].body_specifics.diameter;
+    }
+    const body_handle& handle_of(uint32_t body_index) const{
+        return handle[body_index];
+    }
+    celestial_body_types body_type(uint32_t body_index) const{
+        return type[body_index];
+    }
+    const object_cold_info& cold_info(uint32_t body_index) const{
+        return cold[body_index];
+    }
+    name_id body_name_id(uint32_t body_index) const{
+        return cold[body_index].body_name;
+    }
+    std::string_view body_name(uint32_t body_index) const{
+        return name_pool::shared().name(cold[body_index].body_name);
+    }
+};
+
+/*
+ * Lightweight reference to a body in the storage,
+ * it is invalidated by any change to the universe map.
+ */
+class celestial_body_view
+{
+    const body_storage* storage;
+    uint32_t            index;
+public:
+    celestial_body_view(const body_storage& bodies,
+                        uint32_t body_index) :
+        storage{&bodies},
+        index{body_index}
+    {}
+
+    uint32_t get_body_index() const{
+        return index;
+    }
+    object_coordinates get_body_coordinates() const{
+        return storage->position(index);
+    }
+    uint32_t get_body_diameter() const{
+        return storage->body_diameter(index);
+    }
+    body_handle get_body_handle() const{
+        return storage->handle_of(index);
+    }
+    uint64_t get_body_unique_id() const{
+        return storage->handle_of(index).id();
+    }
+    celestial_body_types get_body_type() const{
+        return storage->body_type(index);
+    }
+    const object_cold_info& get_cold_info() const{
+        return storage->cold_info(index);
+    }
+    name_id get_body_name_id() const{
+        return storage->body_name_id(index);
+    }
+    std::string_view get_body_name() const{
+        return storage->body_name(index);
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef BODY_BITSET_HPP
+#define BODY_BITSET_HPP
+
+#include <cstdint>
+#include <vector>
+
+namespace game_maps
+{
+
+/*
+ * One bit for each slot of the body handles, the slots
+ * never change while a body exists so the bits follow
+ * the bodies when the map moves them in the storage.
+ * The sets are combined one word of 64 bodies at time.
+ */
+class body_bitset
+{
+    std::vector<uint64_t> words;
+public:
+    static const uint32_t word_bits = 64;
+
+    //Make room for the slots up to 'slots_count', the new bits are reset
+    void resize(std::size_t slots_count){
+        if(slots_count > words.size() * word_bits){
+            words.resize((slots_count + word_bits - 1) / word_bits);
+        }
+    }
+    void clear(){
+        words.assign(words.size(),0);
+    }
+    std::size_t get_words_count() const{
+        return words.size();
+    }
+    const uint64_t* data() const{
+        return words.data();
+    }
+    uint64_t get_word(std::size_t word) const{
+        return word < words.size() ? words[word] : 0;
+    }
+    void set_word(std::size_t word,uint64_t bits){
+        words[word] = bits;
+    }
+
+    void set(uint32_t slot){
+        resize(std::size_t(slot) + 1);
+        words[slot / word_bits] |= uint64_t(1) << (slot % word_bits);
+    }
+    void reset(uint32_t slot){
+        if(slot / word_bits < words.size()){
+            words[slot / word_bits] &= ~(uint64_t(1) << (slot % word_bits));
+        }
+    }
+    bool test(uint32_t slot) const{
+        return (get_word(slot / word_bits) >> (slot % word_bits)) & 1;
+    }
+
+    std::size_t count() const{
+        std::size_t total{0};
+        for(uint64_t word : words){
+            total += __builtin_popcountll(word);
+        }
+        return total;
+    }
+    //Keep only the slots set in both, the shared vision of two players
+    body_bitset& operator&=(const body_bitset& other){
+        for(std::size_t word{0};word < words.size();++word){
+            words[word] &= other.get_word(word);
+        }
+        return *this;
+    }
+    body_bitset& operator|=(const body_bitset& other){
+        resize(other.words.size() * word_bits);
+        for(std::size_t word{0};word < other.words.size();++word){
+            words[word] |= other.words[word];
+        }
+        return *this;
+    }
+
+    template<typename FUNC>
+    void for_each_slot(FUNC&& func) const{
+        for(std::size_t word{0};word < words.size();++word){
+            for(uint64_t bits = words[word];bits != 0;bits &= bits - 1){
+                func(uint32_t(word * word_bits + __builtin_ctzll(bits)));
+            }
+        }
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,343 @@
+#include "../logger/logger.hpp"
+#include "broad_phase.hpp"
+#include <algorithm>
+
+namespace game_maps
+{
+
+namespace
+{
+
+const uint64_t max_end_bit = uint64_t(1) << 31;
+const uint64_t end_slot_mask = max_end_bit - 1;
+
+uint32_t end_slot(uint64_t key)
+{
+    return key & end_slot_mask;
+}
+
+bool is_max_end(uint64_t key)
+{
+    return key & max_end_bit;
+}
+
+//Objects whose box was just entered by the sweep, removed in O(1)
+class active_objects
+{
+    std::vector<uint32_t> slots,
+                          position_of;
+public:
+    explicit active_objects(std::size_t slots_count) :
+        position_of(slots_count)
+    {}
+
+    const std::vector<uint32_t>& get_slots() const{
+        return slots;
+    }
+    void insert(uint32_t slot){
+        position_of[slot] = slots.size();
+        slots.push_back(slot);
+    }
+    void erase(uint32_t slot){
+        uint32_t position = position_of[slot];
+        slots[position] = slots.back();
+        position_of[slots[position]] = position;
+        slots.pop_back();
+    }
+};
+
+}
+
+object_area proximity_area(const object_coordinates& position,
+                           uint32_t radius)
+{
+    return object_area(position.x > radius ? position.x - radius : 0,
+                       position.x < UINT32_MAX - radius ? position.x + radius : UINT32_MAX,
+                       position.y > radius ? position.y - radius : 0,
+                       position.y < UINT32_MAX - radius ? position.y + radius : UINT32_MAX);
+}
+
+sweep_and_prune::sweep_and_prune() :
+    last_swaps{0},
+    removed_count{0}
+{}
+
+void sweep_and_prune::set_event_queue(game_events::game_evt_pointer queue)
+{
+    event_queue = queue;
+}
+
+sweep_and_prune::end_key sweep_and_prune::make_key(uint32_t value,bool is_max,uint32_t slot)
+{
+    return (uint64_t(value) << 32) | (is_max ? max_end_bit : 0) | slot;
+}
+
+uint64_t sweep_and_prune::pair_key(uint32_t first_slot,uint32_t second_slot)
+{
+    if(first_slot > second_slot)
+        std::swap(first_slot,second_slot);
+    return (uint64_t(first_slot) << 32) | second_slot;
+}
+
+bool sweep_and_prune::boxes_overlap(uint32_t first_slot,uint32_t second_slot) const
+{
+    const object_area& first = boxes[first_slot];
+    const object_area& second = boxes[second_slot];
+    return first.x_from <= second.x_to && second.x_from <= first.x_to &&
+           first.y_from <= second.y_to && second.y_from <= first.y_to;
+}
+
+void sweep_and_prune::add_pair(uint32_t first_slot,uint32_t second_slot)
+{
+    if(pairs.insert(pair_key(first_slot,second_slot)).second){
+        ++pair_counts[first_slot];
+        ++pair_counts[second_slot];
+        changes.push_back({object_ids[first_slot],object_ids[second_slot],true});
+    }
+}
+
+void sweep_and_prune::remove_pair(uint32_t first_slot,uint32_t second_slot)
+{
+    if(pair_counts[first_slot] == 0 || pair_counts[second_slot] == 0)
+        return;
+    if(pairs.erase(pair_key(first_slot,second_slot)) > 0){
+        --pair_counts[first_slot];
+        --pair_counts[second_slot];
+        changes.push_back({object_ids[first_slot],object_ids[second_slot],false});
+    }
+}
+
+bool sweep_and_prune::add_object(uint64_t object_id,
+                                 const object_area& box)
+{
+    if(box.x_from > box.x_to || box.y_from > box.y_to){
+        WARN1("Invalid proximity box for the object ",object_id);
+        return false;
+    }
+    if(slot_of.find(object_id) != slot_of.end())
+        return false;
+    uint32_t slot;
+    if(!free_slots.empty()){
+        slot = free_slots.back();
+        free_slots.pop_back();
+    }else{
+        if(boxes.size() == end_slot_mask){
+            WARN1("Too many objects in the broad phase");
+            return false;
+        }
+        slot = boxes.size();
+        boxes.emplace_back();
+        object_ids.emplace_back();
+        states.emplace_back();
+        pair_counts.emplace_back();
+    }
+    boxes[slot] = box;
+    object_ids[slot] = object_id;
+    states[slot] = object_state::pending;
+    pending_slots.push_back(slot);
+    slot_of[object_id] = slot;
+    return true;
+}
+
+bool sweep_and_prune::update_object(uint64_t object_id,
+                                    const object_area& box)
+{
+    auto object = slot_of.find(object_id);
+    if(object == slot_of.end() || box.x_from > box.x_to || box.y_from > box.y_to)
+        return false;
+    boxes[object->second] = box;
+    return true;
+}
+
+/*
+ * The ends of a removed object stay sorted
+ * until the next update drops them
+ */
+bool sweep_and_prune::remove_object(uint64_t object_id)
+{
+    auto object = slot_of.find(object_id);
+    if(object == slot_of.end())
+        return false;
+    uint32_t slot = object->second;
+    slot_of.erase(object);
+    if(states[slot] == object_state::pending){
+        states[slot] = object_state::unused;
+        free_slots.push_back(slot);
+    }else{
+        states[slot] = object_state::removed;
+        ++removed_count;
+    }
+    return true;
+}
+
+uint32_t sweep_and_prune::get_objects_count() const
+{
+    return slot_of.size();
+}
+
+void sweep_and_prune::drop_removed_objects()
+{
+    for(auto pair = pairs.begin();pair != pairs.end();){
+        uint32_t first_slot = *pair >> 32,
+                 second_slot = *pair & UINT32_MAX;
+        if(states[first_slot] == object_state::removed ||
+           states[second_slot] == object_state::removed){
+            changes.push_back({object_ids[first_slot],object_ids[second_slot],false});
+            --pair_counts[first_slot];
+            --pair_counts[second_slot];
+            pair = pairs.erase(pair);
+        }else{
+            ++pair;
+        }
+    }
+}
+
+//The coordinates are taken again from the boxes, the order is kept
+void sweep_and_prune::refresh_ends(std::vector<end_key>& ends,bool x_axis)
+{
+    std::size_t kept{0};
+    for(end_key key : ends){
+        uint32_t slot = end_slot(key);
+        if(states[slot] == object_state::removed)
+            continue;
+        const object_area& box = boxes[slot];
+        uint32_t value = is_max_end(key) ? (x_axis ? box.x_to : box.y_to) :
+                                           (x_axis ? box.x_from : box.y_from);
+        ends[kept++] = make_key(value,is_max_end(key),slot);
+    }
+    ends.resize(kept);
+}
+
+/*
+ * Insertion sort, each swap is an inversion between the
+ * old and the new order of the ends. The pairs are checked
+ * against the new boxes, so the intermediate orders do not
+ * create pairs which are not overlapping after the update.
+ */
+void sweep_and_prune::sort_ends(std::vector<end_key>& ends)
+{
+    for(std::size_t position{1};position < ends.size();++position){
+        end_key key = ends[position];
+        std::size_t target{position};
+        while(target > 0 && ends[target - 1] > key){
+            end_key previous = ends[target - 1];
+            bool key_is_max = is_max_end(key);
+            if(key_is_max != is_max_end(previous)){
+                if(key_is_max){
+                    remove_pair(end_slot(key),end_slot(previous));
+                }else if(boxes_overlap(end_slot(key),end_slot(previous))){
+                    add_pair(end_slot(key),end_slot(previous));
+                }
+            }
+            ends[target] = previous;
+            --target;
+            ++last_swaps;
+        }
+        ends[target] = key;
+    }
+}
+
+/*
+ * The ends of the new objects are merged in the arrays, then
+ * a sweep along x finds their pairs: a new object is compared
+ * with all the objects it crosses, an old object only with the
+ * new ones.
+ */
+void sweep_and_prune::insert_pending_objects()
+{
+    std::vector<end_key> new_x_ends,
+                         new_y_ends;
+    for(uint32_t slot : pending_slots){
+        if(states[slot] != object_state::pending)
+            continue;
+        states[slot] = object_state::active;
+        const object_area& box = boxes[slot];
+        new_x_ends.push_back(make_key(box.x_from,false,slot));
+        new_x_ends.push_back(make_key(box.x_to,true,slot));
+        new_y_ends.push_back(make_key(box.y_from,false,slot));
+        new_y_ends.push_back(make_key(box.y_to,true,slot));
+    }
+    pending_slots.clear();
+    if(new_x_ends.empty())
+        return;
+    LOG3("Adding ",new_x_ends.size() / 2," objects to the broad phase");
+    std::vector<bool> is_new(boxes.size());
+    for(end_key key : new_x_ends){
+        is_new[end_slot(key)] = true;
+    }
+    for(auto ends : {std::make_pair(&x_ends,&new_x_ends),std::make_pair(&y_ends,&new_y_ends)}){
+        std::sort(ends.second->begin(),ends.second->end());
+        std::size_t old_count = ends.first->size();
+        ends.first->insert(ends.first->end(),ends.second->begin(),ends.second->end());
+        std::inplace_merge(ends.first->begin(),ends.first->begin() + old_count,ends.first->end());
+    }
+    active_objects all_active(boxes.size()),
+                   new_active(boxes.size());
+    for(end_key key : x_ends){
+        uint32_t slot = end_slot(key);
+        if(is_max_end(key)){
+            all_active.erase(slot);
+            if(is_new[slot])
+                new_active.erase(slot);
+            continue;
+        }
+        const object_area& box = boxes[slot];
+        for(uint32_t other : (is_new[slot] ? all_active : new_active).get_slots()){
+            if(box.y_from <= boxes[other].y_to && boxes[other].y_from <= box.y_to){
+                add_pair(slot,other);
+            }
+        }
+        all_active.insert(slot);
+        if(is_new[slot])
+            new_active.insert(slot);
+    }
+}
+
+const std::vector<proximity_change>& sweep_and_prune::update()
+{
+    changes.clear();
+    last_swaps = 0;
+    if(removed_count > 0){
+        drop_removed_objects();
+    }
+    refresh_ends(x_ends,true);
+    refresh_ends(y_ends,false);
+    if(removed_count > 0){
+        for(uint32_t slot{0};slot < states.size();++slot){
+            if(states[slot] == object_state::removed){
+                states[slot] = object_state::unused;
+                free_slots.push_back(slot);
+            }
+        }
+        removed_count = 0;
+    }
+    sort_ends(x_ends);
+    sort_ends(y_ends);
+    insert_pending_objects();
+    if(event_queue && !changes.empty()){
+        event_queue->push(game_events::event_factory<game_events::proximity_evt>::create(changes));
+    }
+    return changes;
+}
+
+bool sweep_and_prune::are_close(uint64_t first_id,
+                                uint64_t second_id) const
+{
+    auto first = slot_of.find(first_id),
+         second = slot_of.find(second_id);
+    if(first == slot_of.end() || second == slot_of.end())
+        return false;
+    return pairs.find(pair_key(first->second,second->second)) != pairs.end();
+}
+
+std::size_t sweep_and_prune::get_pairs_count() const
+{
+    return pairs.size();
+}
+
+uint64_t sweep_and_prune::get_last_swaps() const
+{
+    return last_swaps;
+}
+
+}
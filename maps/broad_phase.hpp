@@ -0,0 +1,104 @@
+#ifndef BROAD_PHASE_HPP
+#define BROAD_PHASE_HPP
+
+#include "../events/events.hpp"
+#include "position.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace game_maps
+{
+
+using namespace coordinates;
+using game_events::proximity_change;
+
+//The box of an object within 'radius' from its position
+object_area proximity_area(const object_coordinates& position,
+                           uint32_t radius);
+
+/*
+ * Sweep and prune broad phase: the two ends of the box of
+ * each object are kept sorted along both axes. Between the
+ * updates the objects move a little, the arrays are almost
+ * sorted and an insertion sort puts them back in order with
+ * few swaps. A min end passing a max end is where two boxes
+ * may start to overlap, a max passing a min is where they
+ * stop: the pairs are maintained only on those swaps.
+ * The boxes are closed, touching boxes are overlapping.
+ */
+class sweep_and_prune
+{
+    enum class object_state : uint8_t
+    {
+        unused,
+        //Added since the last update, not yet sorted
+        pending,
+        active,
+        //Removed since the last update, still sorted
+        removed
+    };
+
+    /*
+     * An end is the coordinate in the high half, then a bit
+     * set for the max ends, so that at the same coordinate
+     * the min ends come first, then the object slot.
+     */
+    using end_key = uint64_t;
+
+    std::vector<object_area>   boxes;
+    std::vector<uint64_t>      object_ids;
+    std::vector<object_state>  states;
+    //Pairs of each object, most have none and skip the pair lookup
+    std::vector<uint32_t>      pair_counts;
+    std::vector<uint32_t>      free_slots,
+                               pending_slots;
+    std::vector<end_key>       x_ends,
+                               y_ends;
+    std::unordered_map<uint64_t,uint32_t> slot_of;
+    //Overlapping pairs, lower slot in the high half
+    std::unordered_set<uint64_t> pairs;
+    std::vector<proximity_change> changes;
+    game_events::game_evt_pointer event_queue;
+    uint64_t                   last_swaps;
+    uint32_t                   removed_count;
+
+    static end_key make_key(uint32_t value,bool is_max,uint32_t slot);
+    static uint64_t pair_key(uint32_t first_slot,uint32_t second_slot);
+    bool boxes_overlap(uint32_t first_slot,uint32_t second_slot) const;
+    void add_pair(uint32_t first_slot,uint32_t second_slot);
+    void remove_pair(uint32_t first_slot,uint32_t second_slot);
+    void drop_removed_objects();
+    void refresh_ends(std::vector<end_key>& ends,bool x_axis);
+    void sort_ends(std::vector<end_key>& ends);
+    void insert_pending_objects();
+public:
+    sweep_and_prune();
+    //The changes of each update are pushed in one event, if any
+    void set_event_queue(game_events::game_evt_pointer queue);
+
+    /*
+     * The objects are known by an id chosen by the caller, like
+     * the id of a body handle. The changes of the objects are
+     * applied by the next update.
+     */
+    bool add_object(uint64_t object_id,
+                    const object_area& box);
+    bool update_object(uint64_t object_id,
+                       const object_area& box);
+    bool remove_object(uint64_t object_id);
+    uint32_t get_objects_count() const;
+
+    //Sort the ends again and return the pairs changed since the last update
+    const std::vector<proximity_change>& update();
+    bool are_close(uint64_t first_id,
+                   uint64_t second_id) const;
+    std::size_t get_pairs_count() const;
+    //Swaps done by the last update, low when the objects move a little
+    uint64_t get_last_swaps() const;
+};
+
+}
+
+#endif
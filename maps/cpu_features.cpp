@@ -0,0 +1,45 @@
+#include "../logger/logger.hpp"
+#include "cpu_features.hpp"
+
+namespace game_maps
+{
+
+namespace
+{
+
+simd_kernel detect_simd_kernel()
+{
+    simd_kernel kernel{simd_kernel::scalar};
+#ifdef MAPS_X86_KERNELS
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+        kernel = simd_kernel::avx2;
+    }else if(__builtin_cpu_supports("sse4.1")){
+        kernel = simd_kernel::sse41;
+    }
+#endif
+    LOG3("SIMD kernels: ",simd_kernel_name(kernel));
+    return kernel;
+}
+
+}
+
+simd_kernel available_simd_kernel()
+{
+    static const simd_kernel kernel = detect_simd_kernel();
+    return kernel;
+}
+
+const char* simd_kernel_name(simd_kernel kernel)
+{
+    switch(kernel){
+    case simd_kernel::avx2:
+        return "avx2";
+    case simd_kernel::sse41:
+        return "sse4.1";
+    default:
+        return "scalar";
+    }
+}
+
+}
@@ -0,0 +1,30 @@
+#ifndef CPU_FEATURES_HPP
+#define CPU_FEATURES_HPP
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MAPS_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace game_maps
+{
+
+/*
+ * Instruction sets of the vector kernels of the maps, each
+ * family of kernels falls back to the best version it has
+ * when it has none for the given one.
+ */
+enum class simd_kernel
+{
+    scalar,
+    sse41,
+    avx2
+};
+
+//Best instruction set supported by the CPU, checked only once
+simd_kernel available_simd_kernel();
+const char* simd_kernel_name(simd_kernel kernel);
+
+}
+
+#endif
@@ -0,0 +1,383 @@
+#include "../logger/logger.hpp"
+#include "galaxy.hpp"
+
+namespace game_maps
+{
+
+galaxy_map::galaxy_map() :
+    sector_bits{default_sector_bits},
+    index_type{spatial_index_type::loose_quadtree},
+    source_sectors{0},
+    max_resident_sectors{default_resident_sectors},
+    visiting_sectors{0},
+    stream{std::make_shared<sector_stream>()}
+{
+    LOG3("Creating the galaxy map");
+}
+
+/*
+ * The settings of the universe map apply to each sector,
+ * universe_sector_bits sets the size of the sectors.
+ */
+void galaxy_map::configure(game_configuration::game_config_ptr game_config)
+{
+    game_conf = game_config;
+    std::string bits = game_conf->get_option("universe_sector_bits");
+    if(!bits.empty()){
+        set_sector_bits(std::stoul(bits));
+    }
+    std::string resident_sectors = game_conf->get_option("universe_resident_sectors");
+    if(!resident_sectors.empty()){
+        set_resident_sectors(std::stoul(resident_sectors));
+    }
+    for(auto& sector : sectors){
+        sector.second.sector_map->configure(game_conf);
+        sector.second.sector_map->set_universe_size(get_sector_side(),get_sector_side());
+    }
+}
+
+void galaxy_map::set_worker_pool(game_workers::worker_pool_ptr worker_pool)
+{
+    workers = worker_pool;
+    for(auto& sector : sectors){
+        sector.second.sector_map->set_worker_pool(workers);
+    }
+}
+
+/*
+ * The size of the sectors can change only
+ * while the galaxy is empty
+ */
+bool galaxy_map::set_sector_bits(uint32_t bits)
+{
+    if(bits == 0 || bits > max_sector_bits || !sectors.empty()){
+        WARN1("Unable to set the sector size to 2^",bits);
+        return false;
+    }
+    LOG3("Setting the sector size to 2^",bits);
+    sector_bits = bits;
+    return true;
+}
+
+void galaxy_map::set_spatial_index(spatial_index_type new_index_type)
+{
+    index_type = new_index_type;
+    for(auto& sector : sectors){
+        sector.second.sector_map->set_spatial_index(index_type);
+    }
+}
+
+/*
+ * From now on the missing sectors of a galaxy spanning
+ * sectors_per_side sectors are produced by the source
+ */
+void galaxy_map::set_sector_source(sector_source new_source,
+                                   uint32_t sectors_per_side)
+{
+    LOG3("Streaming a galaxy of ",sectors_per_side,"x",sectors_per_side,
+         " sectors, up to ",max_resident_sectors," resident");
+    source = new_source;
+    source_sectors = sectors_per_side;
+}
+
+//Unchanged sectors kept in memory while streaming
+void galaxy_map::set_resident_sectors(std::size_t resident_sectors)
+{
+    max_resident_sectors = resident_sectors;
+    evict_sectors();
+}
+
+uint32_t galaxy_map::get_sector_bits() const
+{
+    return sector_bits;
+}
+
+uint64_t galaxy_map::get_sector_side() const
+{
+    return uint64_t(1) << sector_bits;
+}
+
+std::size_t galaxy_map::get_sectors_count() const
+{
+    return sectors.size();
+}
+
+std::size_t galaxy_map::get_pending_sectors_count() const
+{
+    std::lock_guard<std::mutex> lock(stream->stream_mtx);
+    return stream->pending.size();
+}
+
+//Bodies of the sectors in memory
+uint64_t galaxy_map::get_bodies_count() const
+{
+    uint64_t count{0};
+    for(const auto& sector : sectors){
+        count += sector.second.sector_map->get_bodies_count();
+    }
+    return count;
+}
+
+const universe_map* galaxy_map::get_sector(const sector_id& sector) const
+{
+    auto found = sectors.find(sector.key());
+    if(found == sectors.end())
+        return nullptr;
+    return found->second.sector_map.get();
+}
+
+/*
+ * The sector maps are created the same way on the owner
+ * thread and by the background generation jobs
+ */
+galaxy_map::sector_ptr galaxy_map::create_sector_map() const
+{
+    auto sector_map = std::make_unique<universe_map>();
+    if(game_conf){
+        sector_map->configure(game_conf);
+    }else{
+        sector_map->set_spatial_index(index_type);
+    }
+    sector_map->set_worker_pool(workers);
+    sector_map->set_universe_size(get_sector_side(),get_sector_side());
+    return sector_map;
+}
+
+universe_map& galaxy_map::insert_sector(uint64_t key,sector_ptr sector_map)
+{
+    sectors_lru.push_front(key);
+    auto& entry = sectors[key];
+    entry.sector_map = std::move(sector_map);
+    entry.lru_position = sectors_lru.begin();
+    entry.modified = false;
+    return *entry.sector_map;
+}
+
+//The sector is marked as the most recently used
+universe_map* galaxy_map::find_sector(const sector_id& sector)
+{
+    auto found = sectors.find(sector.key());
+    if(found == sectors.end())
+        return nullptr;
+    sectors_lru.splice(sectors_lru.begin(),sectors_lru,found->second.lru_position);
+    return found->second.sector_map.get();
+}
+
+/*
+ * Return the sector, generating it if it is missing from the
+ * generated galaxy. A sector already being generated in background
+ * is waited for, any other missing sector is generated right away.
+ */
+universe_map* galaxy_map::load_sector(const sector_id& sector)
+{
+    universe_map* sector_map = find_sector(sector);
+    if(sector_map != nullptr || !source ||
+       sector.x >= source_sectors || sector.y >= source_sectors)
+        return sector_map;
+    {
+        std::unique_lock<std::mutex> lock(stream->stream_mtx);
+        if(stream->pending.count(sector.key()) > 0){
+            stream->sector_ready.wait(lock,[this,&sector](){
+                return stream->pending.count(sector.key()) == 0;
+            });
+        }
+    }
+    update();
+    sector_map = find_sector(sector);
+    if(sector_map != nullptr)
+        return sector_map;
+    LOG3("Generating the sector ",sector.x,",",sector.y);
+    auto bodies = source(sector);
+    auto new_sector = create_sector_map();
+    new_sector->add_celestial_bodies(bodies.begin(),bodies.end());
+    return &insert_sector(sector.key(),std::move(new_sector));
+}
+
+/*
+ * Sectors receiving bodies are marked as changed, with a
+ * source they are generated first.
+ */
+universe_map& galaxy_map::get_or_create_sector(const sector_id& sector)
+{
+    universe_map* sector_map = load_sector(sector);
+    if(sector_map == nullptr){
+        LOG3("Creating the sector ",sector.x,",",sector.y);
+        sector_map = &insert_sector(sector.key(),create_sector_map());
+    }
+    sectors[sector.key()].modified = true;
+    return *sector_map;
+}
+
+/*
+ * Drop the least recently used sectors beyond the resident
+ * limit, the changed sectors cannot be generated again
+ * and are kept. Nothing is dropped while a query runs.
+ */
+void galaxy_map::evict_sectors()
+{
+    if(!source || visiting_sectors > 0)
+        return;
+    auto candidate = sectors_lru.end();
+    std::size_t resident = sectors.size();
+    while(resident > max_resident_sectors && candidate != sectors_lru.begin()){
+        --candidate;
+        auto found = sectors.find(*candidate);
+        if(found->second.modified){
+            continue;
+        }
+        LOG3("Evicting the sector ",uint32_t(*candidate),",",uint32_t(*candidate >> 32));
+        sectors.erase(found);
+        candidate = sectors_lru.erase(candidate);
+        --resident;
+    }
+}
+
+/*
+ * Schedule the generation of the missing sectors overlapped by
+ * the area as background jobs of the worker pool, each job
+ * generates the bodies and builds the sector map. Without workers nothing is scheduled,
+ * the sectors are generated when they are queried.
+ */
+void galaxy_map::request_sectors(const world_area& area)
+{
+    update();
+    if(!source || !workers || workers->size() == 0 ||
+       area.x_from > area.x_to || area.y_from > area.y_to ||
+       (area.x_from >> sector_bits) >= source_sectors ||
+       (area.y_from >> sector_bits) >= source_sectors)
+        return;
+    uint64_t last_x = std::min<uint64_t>(area.x_to >> sector_bits,source_sectors - 1),
+             last_y = std::min<uint64_t>(area.y_to >> sector_bits,source_sectors - 1);
+    for(uint64_t y{area.y_from >> sector_bits};y <= last_y;++y){
+        for(uint64_t x{area.x_from >> sector_bits};x <= last_x;++x){
+            sector_id sector{uint32_t(x),uint32_t(y)};
+            if(find_sector(sector) != nullptr)
+                continue;
+            {
+                std::lock_guard<std::mutex> lock(stream->stream_mtx);
+                if(!stream->pending.insert(sector.key()).second)
+                    continue;
+            }
+            auto sector_stream = stream;
+            auto sector_source = source;
+            //The empty sector map is created here, the job generates and loads the bodies
+            auto new_sector = std::make_shared<sector_ptr>(create_sector_map());
+            workers->submit_background([sector,sector_stream,sector_source,new_sector](){
+                auto bodies = sector_source(sector);
+                (*new_sector)->add_celestial_bodies(bodies.begin(),bodies.end());
+                std::lock_guard<std::mutex> lock(sector_stream->stream_mtx);
+                sector_stream->ready.emplace_back(sector.key(),std::move(*new_sector));
+                sector_stream->pending.erase(sector.key());
+                sector_stream->sector_ready.notify_all();
+            });
+        }
+    }
+}
+
+void galaxy_map::update()
+{
+    std::vector<std::pair<uint64_t,sector_ptr>> ready;
+    {
+        std::lock_guard<std::mutex> lock(stream->stream_mtx);
+        ready.swap(stream->ready);
+    }
+    for(auto& sector : ready){
+        //A sector may have been generated meanwhile by a query
+        if(sectors.count(sector.first) == 0){
+            insert_sector(sector.first,std::move(sector.second));
+        }
+    }
+    evict_sectors();
+}
+
+galaxy_body_handle galaxy_map::add_celestial_body(const sector_id& sector,
+                                                  const celestial_body& new_body)
+{
+    update();
+    return {sector,get_or_create_sector(sector).add_celestial_body(new_body)};
+}
+
+galaxy_body_handle galaxy_map::add_celestial_body(const world_coordinates& position,
+                                                  celestial_body new_body)
+{
+    auto sector_position = to_sector_coordinates(position,sector_bits);
+    new_body.set_body_coordinates(sector_position.offset);
+    return add_celestial_body(sector_position.sector,new_body);
+}
+
+/*
+ * Empty sectors are not released, the bodies
+ * may come back soon
+ */
+bool galaxy_map::remove_celestial_body(const galaxy_body_handle& handle)
+{
+    update();
+    universe_map* sector_map = load_sector(handle.sector);
+    if(sector_map == nullptr){
+        WARN1("Unable to remove the body ",handle.body.id(),", no such sector");
+        return false;
+    }
+    if(!sector_map->remove_celestial_body(handle.body))
+        return false;
+    sectors[handle.sector.key()].modified = true;
+    return true;
+}
+
+/*
+ * Within the sector the body keeps its handle, a body
+ * moving to another sector is added to that sector and
+ * receives a new handle. The null handle is returned
+ * if the body cannot be moved.
+ */
+galaxy_body_handle galaxy_map::move_celestial_body(const galaxy_body_handle& handle,
+                                                   const world_coordinates& new_position)
+{
+    update();
+    universe_map* sector_map = load_sector(handle.sector);
+    if(sector_map == nullptr)
+        return galaxy_body_handle();
+    uint32_t body_index = sector_map->find_body(handle.body);
+    if(body_index == no_body)
+        return galaxy_body_handle();
+    auto sector_position = to_sector_coordinates(new_position,sector_bits);
+    sectors[handle.sector.key()].modified = true;
+    if(sector_position.sector == handle.sector){
+        if(!sector_map->move_celestial_body(body_index,sector_position.offset))
+            return galaxy_body_handle();
+        return handle;
+    }
+    auto body = sector_map->get_body(body_index);
+    object_hot_info hot_info;
+    hot_info.body_position = sector_position.offset;
+    hot_info.body_type = body.get_body_type();
+    celestial_body moved_body(hot_info,body.get_cold_info());
+    sector_map->remove_celestial_body(body_index);
+    return add_celestial_body(sector_position.sector,moved_body);
+}
+
+bool galaxy_map::get_body_position(const galaxy_body_handle& handle,
+                                   world_coordinates& position)
+{
+    update();
+    const universe_map* sector_map = load_sector(handle.sector);
+    if(sector_map == nullptr)
+        return false;
+    uint32_t body_index = sector_map->find_body(handle.body);
+    if(body_index == no_body)
+        return false;
+    position = to_world_coordinates(sector_coordinates(handle.sector,
+                                                       sector_map->get_body(body_index).get_body_coordinates()),
+                                    sector_bits);
+    return true;
+}
+
+std::vector<galaxy_body_view> galaxy_map::find_bodies_within(const world_area& area)
+{
+    std::vector<galaxy_body_view> bodies;
+    for_each_body_within(area,[&bodies](const sector_id& sector,const celestial_body_view& body){
+        bodies.emplace_back(sector,body);
+    });
+    return bodies;
+}
+
+}
@@ -0,0 +1,265 @@
+#ifndef GALAXY_HPP
+#define GALAXY_HPP
+
+#include "maps.hpp"
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <list>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+
+namespace game_maps
+{
+
+using namespace coordinates;
+using namespace objects;
+
+//Sectors of 2^20 units per side, unless configured otherwise
+static const uint32_t default_sector_bits = 20;
+//The offsets within a sector shall fit the universe_map coordinates
+static const uint32_t max_sector_bits = 31;
+//Generated sectors kept in memory, unless configured otherwise
+static const std::size_t default_resident_sectors = 64;
+
+struct galaxy_body_handle
+{
+    sector_id   sector;
+    body_handle body;
+
+    bool is_null() const{
+        return body.is_null();
+    }
+};
+
+struct galaxy_body_view
+{
+    sector_id           sector;
+    celestial_body_view body;
+
+    galaxy_body_view(const sector_id& body_sector,
+                     const celestial_body_view& sector_body) :
+        sector{body_sector},
+        body{sector_body}
+    {}
+};
+
+/*
+ * Produce the bodies of a sector, with their offset within
+ * the sector. It shall return the same bodies each time it is
+ * called for a sector and it is called from the worker threads.
+ * It is asked only for the sectors within the generated galaxy.
+ */
+using sector_source = std::function<std::vector<celestial_body>(const sector_id&)>;
+
+/*
+ * Universe made of square sectors, each sector is a
+ * universe_map holding the bodies by their offset within
+ * the sector. Only the sectors with some body exist.
+ * The queries are split in one query per sector, the
+ * filtering within a sector is done on 32 bit offsets.
+ *
+ * With a sector source the galaxy is streamed: the sectors are
+ * generated when first touched and only a bounded amount of them
+ * stays in memory, the least recently used are evicted. Sectors
+ * changed by adding, moving or removing bodies are never evicted.
+ * No sector is evicted while a query runs, the eviction happens
+ * at the next call after the query, so the views returned by a
+ * query stay valid until then. Beyond the generated galaxy only
+ * the sectors which received bodies exist.
+ * The galaxy map shall be used by a single thread.
+ */
+class galaxy_map
+{
+    using sector_ptr = std::unique_ptr<universe_map>;
+    using lru_list = std::list<uint64_t>;
+
+    struct sector_entry
+    {
+        sector_ptr         sector_map;
+        lru_list::iterator lru_position;
+        bool               modified;
+    };
+
+    //Shared with the background generation jobs, which may outlive the map
+    struct sector_stream
+    {
+        std::mutex                                    stream_mtx;
+        std::condition_variable                       sector_ready;
+        std::unordered_set<uint64_t>                  pending;
+        std::vector<std::pair<uint64_t,sector_ptr>>   ready;
+    };
+
+    uint32_t                              sector_bits;
+    spatial_index_type                    index_type;
+    game_configuration::game_config_ptr   game_conf;
+    game_workers::worker_pool_ptr         workers;
+    std::unordered_map<uint64_t,sector_entry> sectors;
+    //Most recently used first
+    lru_list                              sectors_lru;
+    sector_source                         source;
+    //Sectors per side of the generated galaxy
+    uint32_t                              source_sectors;
+    std::size_t                           max_resident_sectors;
+    //Queries in progress, the eviction waits for them
+    uint32_t                              visiting_sectors;
+    std::shared_ptr<sector_stream>        stream;
+
+    sector_ptr create_sector_map() const;
+    universe_map& insert_sector(uint64_t key,sector_ptr sector_map);
+    universe_map* load_sector(const sector_id& sector);
+    universe_map& get_or_create_sector(const sector_id& sector);
+    universe_map* find_sector(const sector_id& sector);
+    void evict_sectors();
+    template<typename FUNC>
+    void visit_sectors_within(const world_area& area,
+                              FUNC&& visitor);
+public:
+    galaxy_map();
+    void configure(game_configuration::game_config_ptr game_config);
+    void set_worker_pool(game_workers::worker_pool_ptr worker_pool);
+    bool set_sector_bits(uint32_t bits);
+    void set_spatial_index(spatial_index_type new_index_type);
+    void set_sector_source(sector_source new_source,
+                           uint32_t sectors_per_side);
+    void set_resident_sectors(std::size_t resident_sectors);
+
+    uint32_t get_sector_bits() const;
+    uint64_t get_sector_side() const;
+    std::size_t get_sectors_count() const;
+    std::size_t get_pending_sectors_count() const;
+    uint64_t get_bodies_count() const;
+    const universe_map* get_sector(const sector_id& sector) const;
+
+    //The coordinates of the body are its offset within the sector
+    galaxy_body_handle add_celestial_body(const sector_id& sector,
+                                          const celestial_body& new_body);
+    galaxy_body_handle add_celestial_body(const world_coordinates& position,
+                                          celestial_body new_body);
+    template<typename ITERATOR>
+    uint32_t add_celestial_bodies(const sector_id& sector,
+                                  ITERATOR first,ITERATOR last);
+    bool remove_celestial_body(const galaxy_body_handle& handle);
+    galaxy_body_handle move_celestial_body(const galaxy_body_handle& handle,
+                                           const world_coordinates& new_position);
+    bool get_body_position(const galaxy_body_handle& handle,
+                           world_coordinates& position);
+
+    //Never waits, the missing sectors are generated in background
+    void request_sectors(const world_area& area);
+    //Take in the sectors generated in background
+    void update();
+
+    //Missing sectors are loaded, waiting for them if needed
+    std::vector<galaxy_body_view> find_bodies_within(const world_area& area);
+    template<typename FUNC>
+    void for_each_body_within(const world_area& area,
+                              FUNC&& func);
+};
+
+/*
+ * Bulk load of the bodies of a single sector,
+ * return the amount of bodies in the sector.
+ */
+template<typename ITERATOR>
+uint32_t galaxy_map::add_celestial_bodies(const sector_id& sector,
+                                          ITERATOR first,ITERATOR last)
+{
+    return get_or_create_sector(sector).add_celestial_bodies(first,last);
+}
+
+/*
+ * Call visitor with each sector overlapped by the area and the
+ * part of the area within that sector, as offsets. The missing
+ * sectors of the generated galaxy are loaded. Elsewhere, when
+ * the area spans more sectors than those existing the existing
+ * sectors are checked instead of the spanned ones.
+ */
+template<typename FUNC>
+void galaxy_map::visit_sectors_within(const world_area& area,
+                                      FUNC&& visitor)
+{
+    const uint64_t last_sector = UINT32_MAX;
+    if(area.x_from > area.x_to || area.y_from > area.y_to ||
+       (area.x_from >> sector_bits) > last_sector ||
+       (area.y_from >> sector_bits) > last_sector)
+        return;
+    uint64_t first_x = area.x_from >> sector_bits,
+             last_x = std::min(area.x_to >> sector_bits,last_sector),
+             first_y = area.y_from >> sector_bits,
+             last_y = std::min(area.y_to >> sector_bits,last_sector),
+             sector_side = get_sector_side();
+    auto visit_sector = [&](const sector_id& sector,const universe_map& sector_map){
+        uint64_t sector_x = uint64_t(sector.x) << sector_bits,
+                 sector_y = uint64_t(sector.y) << sector_bits;
+        object_area sector_area(std::max(area.x_from,sector_x) - sector_x,
+                                std::min(area.x_to,sector_x + sector_side - 1) - sector_x,
+                                std::max(area.y_from,sector_y) - sector_y,
+                                std::min(area.y_to,sector_y + sector_side - 1) - sector_y);
+        visitor(sector,sector_map,sector_area);
+    };
+    update();
+    ++visiting_sectors;
+    bool generated_span = source && first_x < source_sectors && first_y < source_sectors;
+    uint64_t last_generated_x = std::min<uint64_t>(last_x,uint64_t(source_sectors) - 1),
+             last_generated_y = std::min<uint64_t>(last_y,uint64_t(source_sectors) - 1);
+    auto generated = [&](uint64_t x,uint64_t y){
+        return generated_span && x <= last_generated_x && y <= last_generated_y;
+    };
+    double spanned_sectors = double(last_x - first_x + 1) * double(last_y - first_y + 1);
+    if(spanned_sectors > sectors.size()){
+        for(const auto& entry : sectors){
+            sector_id sector(uint32_t(entry.first),uint32_t(entry.first >> 32));
+            if(sector.x >= first_x && sector.x <= last_x &&
+               sector.y >= first_y && sector.y <= last_y &&
+               !generated(sector.x,sector.y)){
+                visit_sector(sector,*entry.second.sector_map);
+            }
+        }
+    }else{
+        for(uint64_t y{first_y};y <= last_y;++y){
+            for(uint64_t x{first_x};x <= last_x;++x){
+                sector_id sector{uint32_t(x),uint32_t(y)};
+                universe_map* sector_map = generated(x,y) ? nullptr : find_sector(sector);
+                if(sector_map != nullptr){
+                    visit_sector(sector,*sector_map);
+                }
+            }
+        }
+    }
+    if(generated_span){
+        for(uint64_t y{first_y};y <= last_generated_y;++y){
+            for(uint64_t x{first_x};x <= last_generated_x;++x){
+                sector_id sector{uint32_t(x),uint32_t(y)};
+                universe_map* sector_map = load_sector(sector);
+                if(sector_map != nullptr){
+                    visit_sector(sector,*sector_map);
+                }
+            }
+        }
+    }
+    --visiting_sectors;
+}
+
+/*
+ * Call func with the sector and the celestial_body_view
+ * of each body within the area
+ */
+template<typename FUNC>
+void galaxy_map::for_each_body_within(const world_area& area,
+                                      FUNC&& func)
+{
+    visit_sectors_within(area,[&func](const sector_id& sector,
+                                      const universe_map& sector_map,
+                                      const object_area& sector_area){
+        sector_map.for_each_body_within(sector_area,[&func,&sector](const celestial_body_view& body){
+            func(sector,body);
+        });
+    });
+}
+
+}
+
+#endif
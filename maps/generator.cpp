@@ -0,0 +1,306 @@
+#include "../logger/logger.hpp"
+#include "generator.hpp"
+#include <cmath>
+
+namespace game_maps
+{
+
+namespace
+{
+
+const double two_pi = 6.283185307179586;
+
+//Resamplings of a disk body falling outside the galaxy before clamping it
+const uint32_t max_disk_samples = 8;
+
+uint64_t splitmix64(uint64_t& state)
+{
+    uint64_t value = (state += 0x9e3779b97f4a7c15ULL);
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+/*
+ * Random stream of a single body, it depends only on
+ * the seed of the galaxy and on the index of the body.
+ */
+class body_random
+{
+    uint64_t state;
+public:
+    body_random(uint64_t seed,
+                uint64_t body_index) :
+        state{seed}
+    {
+        state ^= splitmix64(body_index);
+        splitmix64(state);
+    }
+
+    //Uniform in [0,1)
+    double uniform(){
+        return (splitmix64(state) >> 11) * (1.0 / 9007199254740992.0);
+    }
+    //Box-Muller, one of the two values is dropped
+    double gaussian(){
+        double radius = std::sqrt(-2.0 * std::log(1.0 - uniform()));
+        return radius * std::cos(two_pi * uniform());
+    }
+};
+
+uint32_t to_universe(double coordinate,uint32_t side)
+{
+    double position = (coordinate * 0.5 + 0.5) * (double(side) - 1);
+    if(position < 0)
+        return 0;
+    if(position > double(side) - 1)
+        return side - 1;
+    return uint32_t(position);
+}
+
+//The type and the size of the body are drawn from the random stream
+celestial_body make_body(body_random& random,
+                         const galaxy_parameters& parameters,
+                         const object_coordinates& position,
+                         name_id body_name)
+{
+    object_hot_info hot_info;
+    object_cold_info cold_info;
+    hot_info.body_position = position;
+    uint32_t diameter_min{parameters.planet_diameter_min},
+             diameter_max{parameters.planet_diameter_max};
+    hot_info.body_type = celestial_body_types::celestial_body_planet;
+    if(random.uniform() < parameters.star_ratio){
+        hot_info.body_type = celestial_body_types::celestial_body_star;
+        diameter_min = parameters.star_diameter_min;
+        diameter_max = parameters.star_diameter_max;
+    }
+    cold_info.body_specifics.diameter = diameter_min +
+            uint32_t(random.uniform() * (double(diameter_max) - diameter_min + 1));
+    cold_info.body_name = body_name;
+    return celestial_body(hot_info,cold_info);
+}
+
+//Both profiles decrease with the distance from the center
+double bulge_density(const galaxy_parameters& parameters,
+                     double radius)
+{
+    return std::exp(-radius * radius /
+                    (2 * parameters.bulge_radius * parameters.bulge_radius));
+}
+
+double disk_density(const galaxy_parameters& parameters,
+                    double radius)
+{
+    return radius > 1 ? 0 : std::exp(-radius / parameters.disk_scale_length);
+}
+
+//Closest point of [from,to] to the center of the galaxy
+double closest_to_center(double from,double to)
+{
+    return from > 0 ? from : to < 0 ? to : 0;
+}
+
+}
+
+galaxy_parameters::galaxy_parameters() :
+    seed{0x9a1a},
+    body_count{100000},
+    arm_count{4},
+    arm_winding{two_pi * 0.75},
+    arm_spread{0.25},
+    bulge_fraction{0.15},
+    bulge_radius{0.12},
+    disk_scale_length{0.35},
+    star_ratio{0.2},
+    star_diameter_min{1000},
+    star_diameter_max{20000},
+    planet_diameter_min{10},
+    planet_diameter_max{500},
+    named_bodies{false}
+{}
+
+void galaxy_parameters::configure(game_configuration::game_config_ptr game_conf)
+{
+    std::string option = game_conf->get_option("galaxy_seed");
+    if(!option.empty()){
+        seed = std::stoull(option);
+    }
+    option = game_conf->get_option("galaxy_body_count");
+    if(!option.empty()){
+        body_count = std::stoul(option);
+    }
+    option = game_conf->get_option("galaxy_arm_count");
+    if(!option.empty()){
+        arm_count = std::stoul(option);
+    }
+    option = game_conf->get_option("galaxy_star_ratio");
+    if(!option.empty()){
+        star_ratio = std::stod(option);
+    }
+}
+
+galaxy_generator::galaxy_generator(const galaxy_parameters& galaxy_params,
+                                   game_workers::worker_pool_ptr worker_pool) :
+    parameters{galaxy_params},
+    workers{worker_pool}
+{}
+
+/*
+ * The bulge is a gaussian blob around the center, the disk
+ * bodies follow an exponential profile along the radius and
+ * gather around the arms, logarithmic-like spirals winding
+ * linearly with the distance from the center.
+ */
+celestial_body galaxy_generator::generate_body(uint32_t body_index,
+                                               uint32_t width,
+                                               uint32_t height,
+                                               name_id body_name) const
+{
+    body_random random(parameters.seed,body_index);
+    double x,y;
+    if(random.uniform() < parameters.bulge_fraction){
+        x = random.gaussian() * parameters.bulge_radius;
+        y = random.gaussian() * parameters.bulge_radius;
+    }else{
+        double radius{1};
+        for(uint32_t sample{0};sample < max_disk_samples;++sample){
+            radius = -parameters.disk_scale_length * std::log(1.0 - random.uniform());
+            if(radius <= 1)
+                break;
+        }
+        radius = std::min(radius,1.0);
+        double angle = random.uniform() * two_pi;
+        if(parameters.arm_count > 0){
+            uint32_t arm = std::min<uint32_t>(parameters.arm_count - 1,
+                                              random.uniform() * parameters.arm_count);
+            angle = arm * two_pi / parameters.arm_count +
+                    radius * parameters.arm_winding +
+                    random.gaussian() * parameters.arm_spread;
+        }
+        x = radius * std::cos(angle);
+        y = radius * std::sin(angle);
+    }
+    return make_body(random,parameters,
+                     object_coordinates(to_universe(x,width),
+                                        to_universe(y,height)),
+                     body_name);
+}
+
+/*
+ * Generate the bodies for a universe of the given size, the
+ * galaxy is centered and spans the whole universe. The names
+ * are interned first and in order, so their ids do not depend
+ * on the scheduling of the workers either.
+ */
+std::vector<celestial_body> galaxy_generator::generate(uint32_t width,
+                                                       uint32_t height) const
+{
+    LOG3("Generating a galaxy of ",parameters.body_count," bodies, seed ",parameters.seed);
+    std::vector<name_id> names;
+    if(parameters.named_bodies){
+        names.resize(parameters.body_count);
+        for(uint32_t body_index{0};body_index < parameters.body_count;++body_index){
+            names[body_index] = name_pool::shared().intern("GX-" + std::to_string(parameters.seed) +
+                                                           "-" + std::to_string(body_index));
+        }
+    }
+    std::vector<celestial_body> bodies(parameters.body_count);
+    auto generate_range = [&](std::size_t first,std::size_t last){
+        for(std::size_t body_index{first};body_index < last;++body_index){
+            bodies[body_index] = generate_body(body_index,width,height,
+                                               names.empty() ? empty_name : names[body_index]);
+        }
+    };
+    if(workers){
+        workers->parallel_for(bodies.size(),generate_range);
+    }else{
+        generate_range(0,bodies.size());
+    }
+    return bodies;
+}
+
+/*
+ * Relative density of the galaxy at the given point,
+ * in the units of the galaxy radius: 1 at the center.
+ */
+double galaxy_generator::density_at(double x,double y) const
+{
+    double radius = std::sqrt(x * x + y * y),
+           bulge = bulge_density(parameters,radius),
+           disk = disk_density(parameters,radius);
+    if(parameters.arm_count > 0 && radius > 0){
+        double arm_distance = std::atan2(y,x) - radius * parameters.arm_winding,
+               arm_angle = two_pi / parameters.arm_count;
+        arm_distance -= std::floor(arm_distance / arm_angle) * arm_angle;
+        arm_distance = std::min(arm_distance,arm_angle - arm_distance);
+        disk *= std::exp(-arm_distance * arm_distance /
+                         (2 * parameters.arm_spread * parameters.arm_spread));
+    }
+    return std::min(1.0,parameters.bulge_fraction * bulge +
+                        (1 - parameters.bulge_fraction) * disk);
+}
+
+/*
+ * Bodies of a single sector of a galaxy spanning galaxy_sectors
+ * sectors per side, body_count is the amount of bodies of a
+ * sector as dense as the center of the galaxy. The candidates
+ * are spread uniformly over the sector and each is kept with
+ * a probability proportional to the density at its position:
+ * the bound is the density without the arms at the point of
+ * the sector closest to the center, no point of the sector is
+ * denser. The sector seeds its own random streams, so it is
+ * the same whenever and wherever it is generated.
+ * The positions are offsets within the sector.
+ */
+std::vector<celestial_body> galaxy_generator::generate_sector(const sector_id& sector,
+                                                              uint32_t sector_bits,
+                                                              uint32_t galaxy_sectors) const
+{
+    double sector_size = 2.0 / galaxy_sectors,
+           x_from = sector.x * sector_size - 1,
+           y_from = sector.y * sector_size - 1,
+           closest_x = closest_to_center(x_from,x_from + sector_size),
+           closest_y = closest_to_center(y_from,y_from + sector_size),
+           closest_radius = std::sqrt(closest_x * closest_x + closest_y * closest_y),
+           bulge = bulge_density(parameters,closest_radius),
+           disk = disk_density(parameters,closest_radius),
+           density_bound = std::min(1.0,parameters.bulge_fraction * bulge +
+                                        (1 - parameters.bulge_fraction) * disk);
+    uint32_t candidate_count = uint32_t(parameters.body_count * density_bound + 0.5);
+    uint64_t sector_side = uint64_t(1) << sector_bits,
+             sector_seed = parameters.seed ^ (sector.key() * 0x9e3779b97f4a7c15ULL);
+    std::vector<celestial_body> bodies;
+    for(uint32_t candidate{0};candidate < candidate_count;++candidate){
+        body_random random(sector_seed,candidate);
+        double offset_x = random.uniform(),
+               offset_y = random.uniform();
+        if(random.uniform() * density_bound >= density_at(x_from + offset_x * sector_size,
+                                                          y_from + offset_y * sector_size))
+            continue;
+        object_coordinates offset(uint32_t(offset_x * sector_side),
+                                  uint32_t(offset_y * sector_side));
+        name_id body_name{empty_name};
+        if(parameters.named_bodies){
+            body_name = name_pool::shared().intern("GX-" + std::to_string(parameters.seed) +
+                                                   "-" + std::to_string(sector.x) +
+                                                   "-" + std::to_string(sector.y) +
+                                                   "-" + std::to_string(bodies.size()));
+        }
+        bodies.push_back(make_body(random,parameters,offset,body_name));
+    }
+    return bodies;
+}
+
+/*
+ * Generate a galaxy as big as the universe of the star
+ * chart and bulk load it, return the amount of bodies
+ */
+uint32_t galaxy_generator::populate(universe_map& star_chart) const
+{
+    auto bodies = generate(star_chart.get_universe_width(),
+                           star_chart.get_universe_height());
+    return star_chart.add_celestial_bodies(bodies.begin(),bodies.end());
+}
+
+}
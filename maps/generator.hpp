@@ -0,0 +1,73 @@
+#ifndef GENERATOR_HPP
+#define GENERATOR_HPP
+
+#include "maps.hpp"
+
+namespace game_maps
+{
+
+using namespace coordinates;
+using namespace objects;
+
+/*
+ * Shape of a spiral galaxy, the distances are
+ * fractions of the galaxy radius.
+ */
+struct galaxy_parameters
+{
+    uint64_t seed;
+    uint32_t body_count,
+             arm_count;
+    //Rotation of the arms from the center to the rim, in radians
+    double   arm_winding,
+    //Angular scatter of the bodies around their arm, in radians
+             arm_spread,
+    //Bodies in the central bulge and its radius
+             bulge_fraction,
+             bulge_radius,
+    //The disk density decays exponentially with this scale length
+             disk_scale_length,
+    //Stars among the bodies, the others are planets
+             star_ratio;
+    uint32_t star_diameter_min,
+             star_diameter_max,
+             planet_diameter_min,
+             planet_diameter_max;
+    //Naming the bodies interns a name each, which is done serially
+    bool     named_bodies;
+
+    galaxy_parameters();
+    void configure(game_configuration::game_config_ptr game_conf);
+};
+
+/*
+ * Procedural generator of spiral galaxies. Each body is
+ * generated from a random stream seeded only by the galaxy
+ * seed and the body index, so the bodies can be generated in
+ * parallel and the galaxy is the same for any thread count.
+ */
+class galaxy_generator
+{
+    galaxy_parameters             parameters;
+    game_workers::worker_pool_ptr workers;
+
+    celestial_body generate_body(uint32_t body_index,
+                                 uint32_t width,
+                                 uint32_t height,
+                                 name_id body_name) const;
+public:
+    explicit galaxy_generator(const galaxy_parameters& galaxy_params,
+                              game_workers::worker_pool_ptr worker_pool = nullptr);
+
+    std::vector<celestial_body> generate(uint32_t width,
+                                         uint32_t height) const;
+    std::vector<celestial_body> generate_sector(const sector_id& sector,
+                                                uint32_t sector_bits,
+                                                uint32_t galaxy_sectors) const;
+    double density_at(double x,double y) const;
+    uint32_t populate(universe_map& star_chart) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,262 @@
+#include "../logger/logger.hpp"
+#include "gravity.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace game_maps
+{
+
+namespace
+{
+
+//Points evaluated by each job of the parallel evaluation
+const std::size_t points_per_chunk = 1024;
+
+}
+
+gravity_parameters::gravity_parameters() :
+    mode{gravity_mode::barnes_hut},
+    gravitational_constant{1},
+    opening_angle{0.5},
+    softening{1}
+{}
+
+void gravity_parameters::configure(game_configuration::game_config_ptr game_conf)
+{
+    std::string option = game_conf->get_option("gravity_mode");
+    if(option == "exact"){
+        mode = gravity_mode::exact;
+    }else if(option == "barnes_hut"){
+        mode = gravity_mode::barnes_hut;
+    }else if(!option.empty()){
+        WARN2("Unknown gravity mode: ",option.c_str());
+    }
+    option = game_conf->get_option("gravity_opening_angle");
+    if(!option.empty()){
+        opening_angle = std::stod(option);
+    }
+    option = game_conf->get_option("gravity_softening");
+    if(!option.empty()){
+        softening = std::stod(option);
+    }
+}
+
+gravity_field::gravity_field()
+{}
+
+gravity_field::gravity_field(const gravity_parameters& gravity_params) :
+    parameters{gravity_params}
+{}
+
+void gravity_field::set_parameters(const gravity_parameters& gravity_params)
+{
+    parameters = gravity_params;
+}
+
+void gravity_field::set_worker_pool(game_workers::worker_pool_ptr worker_pool)
+{
+    workers = worker_pool;
+}
+
+/*
+ * The root covers the whole universe, the nodes are split
+ * in four until they hold few bodies. The bodies of a node
+ * are partitioned in place among its children.
+ */
+void gravity_field::build(const universe_map& star_chart)
+{
+    uint32_t body_count = star_chart.get_bodies_count();
+    LOG3("Building the gravity tree of ",body_count," bodies");
+    body_x.resize(body_count);
+    body_y.resize(body_count);
+    body_mass.resize(body_count);
+    body_order.resize(body_count);
+    for(uint32_t body_index{0};body_index < body_count;++body_index){
+        auto body = star_chart.get_body(body_index);
+        double diameter = body.get_body_diameter();
+        body_x[body_index] = body.get_body_coordinates().x;
+        body_y[body_index] = body.get_body_coordinates().y;
+        body_mass[body_index] = diameter * diameter * diameter;
+        body_order[body_index] = body_index;
+    }
+    double half_size = std::max(star_chart.get_universe_width(),
+                                star_chart.get_universe_height()) / 2.0;
+    nodes.clear();
+    nodes.push_back({0,0,0,half_size,half_size,half_size,no_node,0,body_count});
+    build_node(0,0);
+}
+
+void gravity_field::build_node(uint32_t node,uint32_t depth)
+{
+    gravity_node current = nodes[node];
+    if(current.body_count > gravity_leaf_capacity && depth < gravity_max_depth){
+        auto first = body_order.begin() + current.first_body,
+             last = first + current.body_count;
+        auto west = [this,&current](uint32_t body_index){
+            return body_x[body_index] < current.center_x;
+        };
+        auto north = [this,&current](uint32_t body_index){
+            return body_y[body_index] < current.center_y;
+        };
+        auto middle = std::partition(first,last,west);
+        std::array<decltype(first),5> bounds{{first,std::partition(first,middle,north),
+                                              middle,std::partition(middle,last,north),last}};
+        double child_size = current.half_size / 2;
+        current.first_child = nodes.size();
+        for(uint32_t quadrant{0};quadrant < 4;++quadrant){
+            double child_x = current.center_x + (quadrant < 2 ? -child_size : child_size),
+                   child_y = current.center_y + (quadrant % 2 == 0 ? -child_size : child_size);
+            nodes.push_back({0,0,0,child_x,child_y,child_size,no_node,
+                             uint32_t(bounds[quadrant] - body_order.begin()),
+                             uint32_t(bounds[quadrant + 1] - bounds[quadrant])});
+        }
+        for(uint32_t child{current.first_child};child < current.first_child + 4;++child){
+            if(nodes[child].body_count > 0){
+                build_node(child,depth + 1);
+                current.mass += nodes[child].mass;
+                current.mass_x += nodes[child].mass_x * nodes[child].mass;
+                current.mass_y += nodes[child].mass_y * nodes[child].mass;
+            }
+        }
+    }else{
+        for(uint32_t position{current.first_body};
+            position < current.first_body + current.body_count;++position){
+            uint32_t body_index = body_order[position];
+            current.mass += body_mass[body_index];
+            current.mass_x += body_x[body_index] * body_mass[body_index];
+            current.mass_y += body_y[body_index] * body_mass[body_index];
+        }
+    }
+    if(current.mass > 0){
+        current.mass_x /= current.mass;
+        current.mass_y /= current.mass;
+    }
+    nodes[node] = current;
+}
+
+uint32_t gravity_field::get_bodies_count() const
+{
+    return body_x.size();
+}
+
+uint32_t gravity_field::get_nodes_count() const
+{
+    return nodes.size();
+}
+
+gravity_vector gravity_field::attraction(double x,double y,
+                                         double mass,double mass_x,double mass_y) const
+{
+    double dx = mass_x - x,
+           dy = mass_y - y,
+           distance_square = dx * dx + dy * dy + parameters.softening * parameters.softening,
+           strength = parameters.gravitational_constant * mass /
+                      (distance_square * std::sqrt(distance_square));
+    return gravity_vector(dx * strength,dy * strength);
+}
+
+gravity_vector gravity_field::exact_acceleration(double x,double y,uint32_t excluded_body) const
+{
+    gravity_vector total;
+    for(uint32_t body_index{0};body_index < body_x.size();++body_index){
+        if(body_index == excluded_body)
+            continue;
+        auto pull = attraction(x,y,body_mass[body_index],body_x[body_index],body_y[body_index]);
+        total.x += pull.x;
+        total.y += pull.y;
+    }
+    return total;
+}
+
+/*
+ * A node far enough, compared to its size, attracts as a single
+ * mass. The nodes containing the point are always opened, so a
+ * body never attracts itself.
+ */
+gravity_vector gravity_field::tree_acceleration(double x,double y,uint32_t excluded_body) const
+{
+    gravity_vector total;
+    if(nodes.empty())
+        return total;
+    const double opening_square = parameters.opening_angle * parameters.opening_angle;
+    std::array<uint32_t,3 * gravity_max_depth + 4> pending;
+    std::size_t pending_count{0};
+    pending[pending_count++] = 0;
+    while(pending_count > 0){
+        const gravity_node& node = nodes[pending[--pending_count]];
+        if(node.mass <= 0)
+            continue;
+        double dx = node.mass_x - x,
+               dy = node.mass_y - y,
+               size = 2 * node.half_size;
+        bool contains_point = std::abs(x - node.center_x) <= node.half_size &&
+                              std::abs(y - node.center_y) <= node.half_size;
+        if(!contains_point && size * size < opening_square * (dx * dx + dy * dy)){
+            auto pull = attraction(x,y,node.mass,node.mass_x,node.mass_y);
+            total.x += pull.x;
+            total.y += pull.y;
+        }else if(node.first_child != no_node){
+            for(uint32_t child{node.first_child};child < node.first_child + 4;++child){
+                pending[pending_count++] = child;
+            }
+        }else{
+            for(uint32_t position{node.first_body};
+                position < node.first_body + node.body_count;++position){
+                uint32_t body_index = body_order[position];
+                if(body_index == excluded_body)
+                    continue;
+                auto pull = attraction(x,y,body_mass[body_index],body_x[body_index],body_y[body_index]);
+                total.x += pull.x;
+                total.y += pull.y;
+            }
+        }
+    }
+    return total;
+}
+
+gravity_vector gravity_field::acceleration(double x,double y,uint32_t excluded_body) const
+{
+    if(parameters.mode == gravity_mode::exact)
+        return exact_acceleration(x,y,excluded_body);
+    return tree_acceleration(x,y,excluded_body);
+}
+
+gravity_vector gravity_field::acceleration_at(double x,double y) const
+{
+    return acceleration(x,y,no_body);
+}
+
+std::vector<gravity_vector> gravity_field::accelerations_at(const std::vector<gravity_vector>& points) const
+{
+    std::vector<gravity_vector> result(points.size());
+    auto evaluate = [this,&points,&result](std::size_t first,std::size_t last){
+        for(std::size_t point{first};point < last;++point){
+            result[point] = acceleration(points[point].x,points[point].y,no_body);
+        }
+    };
+    if(workers){
+        workers->parallel_for(points.size(),evaluate,points_per_chunk);
+    }else{
+        evaluate(0,points.size());
+    }
+    return result;
+}
+
+std::vector<gravity_vector> gravity_field::body_accelerations() const
+{
+    std::vector<gravity_vector> result(body_x.size());
+    auto evaluate = [this,&result](std::size_t first,std::size_t last){
+        for(std::size_t body_index{first};body_index < last;++body_index){
+            result[body_index] = acceleration(body_x[body_index],body_y[body_index],body_index);
+        }
+    };
+    if(workers){
+        workers->parallel_for(result.size(),evaluate,points_per_chunk);
+    }else{
+        evaluate(0,result.size());
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,109 @@
+#ifndef GRAVITY_HPP
+#define GRAVITY_HPP
+
+#include "maps.hpp"
+
+namespace game_maps
+{
+
+using namespace coordinates;
+
+//Bodies in a leaf of the Barnes-Hut tree
+static const uint32_t gravity_leaf_capacity = 8;
+//Deeper nodes would be smaller than a universe unit
+static const uint32_t gravity_max_depth = 32;
+
+enum class gravity_mode
+{
+    //Every body attracts the point, O(N) per point, for validation
+    exact,
+    //Far groups of bodies attract as their center of mass, O(log N)
+    barnes_hut
+};
+
+struct gravity_parameters
+{
+    gravity_mode mode;
+    double       gravitational_constant,
+    //A node is used as a whole if its size over the distance is below this
+                 opening_angle,
+    //Added to the squared distances, avoids the singularity near the bodies
+                 softening;
+
+    gravity_parameters();
+    void configure(game_configuration::game_config_ptr game_conf);
+};
+
+struct gravity_vector
+{
+    double x,
+           y;
+
+    gravity_vector(double x_value = 0,
+                   double y_value = 0) :
+        x{x_value},
+        y{y_value}
+    {}
+};
+
+/*
+ * Approximate N-body gravity over the bodies of a universe map.
+ * The mass of a body is its volume: diameter^3. The tree is a
+ * quadtree over the body positions, each node knows the total
+ * mass and the center of mass of its bodies. It is built from a
+ * snapshot of the map and shall be rebuilt after the map changes.
+ */
+class gravity_field
+{
+    static const uint32_t no_node = UINT32_MAX;
+
+    struct gravity_node
+    {
+        double   mass,
+                 mass_x,
+                 mass_y,
+                 center_x,
+                 center_y,
+                 half_size;
+        //The four children are consecutive
+        uint32_t first_child,
+                 first_body,
+                 body_count;
+    };
+
+    gravity_parameters            parameters;
+    game_workers::worker_pool_ptr workers;
+    std::vector<double>           body_x,
+                                  body_y,
+                                  body_mass;
+    //Body indexes ordered so that each node holds a range
+    std::vector<uint32_t>         body_order;
+    std::vector<gravity_node>     nodes;
+
+    void build_node(uint32_t node,uint32_t depth);
+    gravity_vector attraction(double x,double y,
+                              double mass,double mass_x,double mass_y) const;
+    gravity_vector exact_acceleration(double x,double y,uint32_t excluded_body) const;
+    gravity_vector tree_acceleration(double x,double y,uint32_t excluded_body) const;
+    gravity_vector acceleration(double x,double y,uint32_t excluded_body) const;
+public:
+    gravity_field();
+    explicit gravity_field(const gravity_parameters& gravity_params);
+    void set_parameters(const gravity_parameters& gravity_params);
+    void set_worker_pool(game_workers::worker_pool_ptr worker_pool);
+
+    void build(const universe_map& star_chart);
+    uint32_t get_bodies_count() const;
+    uint32_t get_nodes_count() const;
+
+    //Acceleration of a free object, like a comet or a ship
+    gravity_vector acceleration_at(double x,double y) const;
+    //The points are spread across the workers
+    std::vector<gravity_vector> accelerations_at(const std::vector<gravity_vector>& points) const;
+    //Acceleration of each body of the map, by body index
+    std::vector<gravity_vector> body_accelerations() const;
+};
+
+}
+
+#endif
@@ -0,0 +1,207 @@
+#include "../logger/logger.hpp"
+#include "grid.hpp"
+#include <algorithm>
+
+namespace game_maps
+{
+
+uniform_grid::uniform_grid(uint32_t universe_width,
+                           uint32_t universe_height,
+                           uint32_t requested_cell_size) :
+    cell_size{default_grid_cell_size},
+    cells_per_row{1},
+    cells_per_column{1},
+    cells(1)
+{
+    resize(universe_width,universe_height,requested_cell_size);
+}
+
+uint32_t uniform_grid::cell_column(uint32_t x) const
+{
+    return std::min(x / cell_size, cells_per_row - 1);
+}
+
+uint32_t uniform_grid::cell_row(uint32_t y) const
+{
+    return std::min(y / cell_size, cells_per_column - 1);
+}
+
+std::vector<uniform_grid::grid_entry>& uniform_grid::cell_at(const object_coordinates& position)
+{
+    return cells[cell_row(position.y) * cells_per_row +
+                 cell_column(position.x)];
+}
+
+/*
+ * Prepare the cells for an universe of the given size,
+ * the cell size is increased if the requested one would
+ * produce more than max_grid_cells cells. The bodies
+ * already in the grid are moved to the new cells.
+ */
+void uniform_grid::resize(uint32_t universe_width,
+                          uint32_t universe_height,
+                          uint32_t requested_cell_size)
+{
+    uint64_t new_cell_size = std::max<uint32_t>(1,requested_cell_size);
+    uint64_t columns,rows;
+    while(true){
+        columns = std::max<uint64_t>(1,(universe_width + new_cell_size - 1) / new_cell_size);
+        rows = std::max<uint64_t>(1,(universe_height + new_cell_size - 1) / new_cell_size);
+        if(columns * rows <= max_grid_cells)
+            break;
+        new_cell_size *= 2;
+    }
+    if(new_cell_size != requested_cell_size){
+        WARN1("Grid cell size ",requested_cell_size," too small for the universe, using ",
+              new_cell_size);
+    }
+
+    std::vector<grid_entry> entries;
+    for(auto& cell : cells){
+        entries.insert(entries.end(),cell.begin(),cell.end());
+    }
+
+    cell_size = new_cell_size;
+    cells_per_row = columns;
+    cells_per_column = rows;
+    cells.clear();
+    cells.resize(columns * rows);
+    LOG3("Universe grid ready, ",columns,"x",rows," cells of size ",cell_size);
+
+    for(auto& entry : entries){
+        insert(entry.body_index,object_coordinates(entry.x,entry.y));
+    }
+}
+
+void uniform_grid::insert(uint32_t body_index,
+                          const object_coordinates& position)
+{
+    cell_at(position).push_back({position.x,position.y,body_index});
+}
+
+void uniform_grid::erase(uint32_t body_index,
+                         const object_coordinates& position)
+{
+    auto& cell = cell_at(position);
+    for(auto& entry : cell){
+        if(entry.body_index == body_index){
+            entry = cell.back();
+            cell.pop_back();
+            return;
+        }
+    }
+    WARN1("Body ",body_index," not found in the grid cell!");
+}
+
+/*
+ * Moving inside the same cell only requires
+ * the update of the entry coordinates
+ */
+void uniform_grid::relocate(uint32_t body_index,
+                            const object_coordinates& old_position,
+                            const object_coordinates& new_position)
+{
+    auto& old_cell = cell_at(old_position);
+    if(&old_cell == &cell_at(new_position)){
+        for(auto& entry : old_cell){
+            if(entry.body_index == body_index){
+                entry.x = new_position.x;
+                entry.y = new_position.y;
+                return;
+            }
+        }
+    }
+    erase(body_index,old_position);
+    insert(body_index,new_position);
+}
+
+void uniform_grid::clear()
+{
+    for(auto& cell : cells){
+        cell.clear();
+    }
+}
+
+/*
+ * Count the bodies of each cell first, so that every
+ * cell is allocated only once. With less bodies than
+ * cells counting costs more than it saves.
+ */
+void uniform_grid::build(const uint32_t* x,
+                         const uint32_t* y,
+                         uint32_t count,
+                         game_workers::worker_pool* workers)
+{
+    if(count < cells.size()){
+        spatial_index::build(x,y,count,workers);
+        return;
+    }
+    clear();
+    std::vector<uint32_t> body_cells(count);
+    auto locate = [this,&body_cells,x,y](std::size_t first,std::size_t last){
+        for(std::size_t body_index{first};body_index < last;++body_index){
+            body_cells[body_index] = cell_row(y[body_index]) * cells_per_row +
+                                     cell_column(x[body_index]);
+        }
+    };
+    if(workers){
+        workers->parallel_for(count,locate);
+    }else{
+        locate(0,count);
+    }
+    std::vector<uint32_t> cell_counts(cells.size(),0);
+    for(auto cell : body_cells){
+        ++cell_counts[cell];
+    }
+    for(std::size_t cell{0};cell < cells.size();++cell){
+        cells[cell].reserve(cell_counts[cell]);
+    }
+    for(uint32_t body_index{0};body_index < count;++body_index){
+        cells[body_cells[body_index]].push_back({x[body_index],y[body_index],body_index});
+    }
+}
+
+uint32_t uniform_grid::get_cell_size() const
+{
+    return cell_size;
+}
+
+/*
+ * Collect the index of the bodies within the area,
+ * the cells completely covered by the area do not need
+ * the per body boundary check.
+ */
+void uniform_grid::query(const object_area& area,
+                         body_visitor visitor) const
+{
+    if(area.x_from > area.x_to || area.y_from > area.y_to)
+        return;
+    uint32_t first_column = cell_column(area.x_from),
+             last_column = cell_column(area.x_to),
+             first_row = cell_row(area.y_from),
+             last_row = cell_row(area.y_to);
+    for(uint32_t row{first_row};row <= last_row;++row){
+        uint64_t cell_y_from = uint64_t(row) * cell_size,
+                 cell_y_to = cell_y_from + cell_size - 1;
+        bool rows_covered = cell_y_from >= area.y_from && cell_y_to <= area.y_to;
+        for(uint32_t column{first_column};column <= last_column;++column){
+            const auto& cell = cells[row * cells_per_row + column];
+            uint64_t cell_x_from = uint64_t(column) * cell_size,
+                     cell_x_to = cell_x_from + cell_size - 1;
+            if(rows_covered && cell_x_from >= area.x_from && cell_x_to <= area.x_to){
+                for(const auto& entry : cell){
+                    visitor(entry.body_index);
+                }
+                continue;
+            }
+            for(const auto& entry : cell){
+                if(entry.x >= area.x_from && entry.x <= area.x_to &&
+                   entry.y >= area.y_from && entry.y <= area.y_to){
+                    visitor(entry.body_index);
+                }
+            }
+        }
+    }
+}
+
+}
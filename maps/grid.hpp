@@ -0,0 +1,67 @@
+#ifndef GRID_HPP
+#define GRID_HPP
+
+#include "spatial_index.hpp"
+
+namespace game_maps
+{
+
+using namespace coordinates;
+
+static const uint32_t default_grid_cell_size = 512;
+//Upper limit for the amount of cells, bigger universes
+//get bigger cells.
+static const uint32_t max_grid_cells = 1 << 18;
+
+/*
+ * Bucketed uniform grid over the universe. Each cell
+ * keeps the coordinates of the bodies it contains together
+ * with their index in the universe_map storage, in this way
+ * a rectangle query touches only the overlapped cells and
+ * never dereference the bodies which are not in the result.
+ */
+class uniform_grid : public spatial_index
+{
+    struct grid_entry
+    {
+        uint32_t x,
+                 y,
+                 body_index;
+    };
+
+    uint32_t cell_size,
+             cells_per_row,
+             cells_per_column;
+    std::vector<std::vector<grid_entry>> cells;
+
+    uint32_t cell_column(uint32_t x) const;
+    uint32_t cell_row(uint32_t y) const;
+    std::vector<grid_entry>& cell_at(const object_coordinates& position);
+public:
+    uniform_grid(uint32_t universe_width = 0,
+                 uint32_t universe_height = 0,
+                 uint32_t requested_cell_size = default_grid_cell_size);
+    void resize(uint32_t universe_width,
+                uint32_t universe_height,
+                uint32_t requested_cell_size);
+    void insert(uint32_t body_index,
+                const object_coordinates& position);
+    void erase(uint32_t body_index,
+               const object_coordinates& position);
+    void relocate(uint32_t body_index,
+                  const object_coordinates& old_position,
+                  const object_coordinates& new_position);
+    void clear();
+    void build(const uint32_t* x,
+               const uint32_t* y,
+               uint32_t count,
+               game_workers::worker_pool* workers);
+    uint32_t get_cell_size() const;
+
+    void query(const object_area& area,
+               body_visitor visitor) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,368 @@
+#include "../logger/logger.hpp"
+#include "hyperlanes.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace game_maps
+{
+
+namespace
+{
+
+//Stars handled by each job of the lanes search
+const std::size_t stars_per_chunk = 4096;
+//Routes searched by each job of a batch
+const std::size_t routes_per_chunk = 16;
+
+//The versions are unique across the graphs
+std::atomic<uint64_t> next_graph_version{1};
+
+}
+
+hyperlane_graph::hyperlane_graph() :
+    candidates{default_hyperlane_candidates},
+    version{0}
+{}
+
+void hyperlane_graph::configure(game_configuration::game_config_ptr game_conf)
+{
+    std::string option = game_conf->get_option("hyperlane_candidates");
+    if(!option.empty()){
+        set_candidates(std::stoul(option));
+    }
+}
+
+void hyperlane_graph::set_worker_pool(game_workers::worker_pool_ptr worker_pool)
+{
+    workers = worker_pool;
+}
+
+void hyperlane_graph::set_candidates(uint32_t nearest_stars)
+{
+    if(nearest_stars == 0){
+        WARN1("At least one candidate star is needed for the hyperlanes");
+        return;
+    }
+    candidates = nearest_stars;
+}
+
+void hyperlane_graph::collect_stars(const universe_map& star_chart)
+{
+    star_handles.clear();
+    star_x.clear();
+    star_y.clear();
+    star_of.clear();
+    for(uint32_t body_index{0};body_index < star_chart.get_bodies_count();++body_index){
+        auto body = star_chart.get_body(body_index);
+        if(body.get_body_type() != celestial_body_types::celestial_body_star)
+            continue;
+        star_of[body.get_body_unique_id()] = star_handles.size();
+        star_handles.push_back(body.get_body_handle());
+        star_x.push_back(body.get_body_coordinates().x);
+        star_y.push_back(body.get_body_coordinates().y);
+    }
+}
+
+//Each lane is given once and stored in both directions
+void hyperlane_graph::add_lanes(const std::vector<std::pair<uint32_t,uint32_t>>& lanes)
+{
+    lane_offsets.assign(star_handles.size() + 1,0);
+    for(auto& lane : lanes){
+        ++lane_offsets[lane.first + 1];
+        ++lane_offsets[lane.second + 1];
+    }
+    for(std::size_t star{1};star < lane_offsets.size();++star){
+        lane_offsets[star] += lane_offsets[star - 1];
+    }
+    lane_targets.resize(2 * lanes.size());
+    lane_lengths.resize(2 * lanes.size());
+    std::vector<uint32_t> next_lane(lane_offsets.begin(),lane_offsets.end() - 1);
+    for(auto& lane : lanes){
+        double length = distance(lane.first,lane.second);
+        uint32_t forward = next_lane[lane.first]++,
+                 backward = next_lane[lane.second]++;
+        lane_targets[forward] = lane.second;
+        lane_lengths[forward] = length;
+        lane_targets[backward] = lane.first;
+        lane_lengths[backward] = length;
+    }
+}
+
+/*
+ * The candidates of a star are ordered by distance: the stars
+ * closer to it than a candidate are all in the list, so the
+ * test of the relative neighborhood is exact for each candidate.
+ */
+void hyperlane_graph::build(const universe_map& star_chart)
+{
+    collect_stars(star_chart);
+    uint32_t stars_count = star_handles.size();
+    LOG3("Building the hyperlanes of ",stars_count," stars");
+    //Rebuilt once here rather than by the first worker, the others would wait for it
+    star_chart.rebuild_nearest_index();
+    std::vector<uint32_t> found_lanes(std::size_t(stars_count) * candidates,no_star);
+    auto search_lanes = [&](std::size_t first,std::size_t last){
+        std::vector<uint32_t> nearest;
+        std::vector<double> nearest_distance;
+        for(std::size_t star{first};star < last;++star){
+            nearest.clear();
+            nearest_distance.clear();
+            object_coordinates position(star_x[star],star_y[star]);
+            for(auto& body : star_chart.find_nearest_bodies(position,candidates + 1,
+                                                            celestial_body_types::celestial_body_star)){
+                uint32_t other = star_of.find(body.get_body_unique_id())->second;
+                if(other == star)
+                    continue;
+                nearest.push_back(other);
+                nearest_distance.push_back(distance(star,other));
+            }
+            //Stars at the same position may push the star itself out of the list
+            nearest.resize(std::min<std::size_t>(nearest.size(),candidates));
+            nearest_distance.resize(nearest.size());
+            uint32_t* lanes = &found_lanes[star * candidates];
+            for(std::size_t candidate{0};candidate < nearest.size();++candidate){
+                double lane_length = nearest_distance[candidate];
+                bool blocked{false};
+                for(std::size_t closer{0};closer < candidate && !blocked;++closer){
+                    blocked = nearest_distance[closer] < lane_length &&
+                              distance(nearest[candidate],nearest[closer]) < lane_length;
+                }
+                if(!blocked){
+                    *lanes++ = nearest[candidate];
+                }
+            }
+        }
+    };
+    if(workers){
+        workers->parallel_for(stars_count,search_lanes,stars_per_chunk);
+    }else{
+        search_lanes(0,stars_count);
+    }
+    std::vector<std::pair<uint32_t,uint32_t>> lanes;
+    for(uint32_t star{0};star < stars_count;++star){
+        for(uint32_t candidate{0};candidate < candidates;++candidate){
+            uint32_t other = found_lanes[std::size_t(star) * candidates + candidate];
+            if(other == no_star)
+                break;
+            lanes.emplace_back(std::min(star,other),std::max(star,other));
+        }
+    }
+    std::sort(lanes.begin(),lanes.end());
+    lanes.erase(std::unique(lanes.begin(),lanes.end()),lanes.end());
+    add_lanes(lanes);
+    version = next_graph_version++;
+    LOG3("Built ",lanes.size()," hyperlanes, graph version ",version);
+}
+
+uint64_t hyperlane_graph::get_version() const
+{
+    return version;
+}
+
+uint32_t hyperlane_graph::get_stars_count() const
+{
+    return star_handles.size();
+}
+
+std::size_t hyperlane_graph::get_lanes_count() const
+{
+    return lane_targets.size() / 2;
+}
+
+uint32_t hyperlane_graph::star_of_body(const body_handle& handle) const
+{
+    auto star = star_of.find(handle.id());
+    if(star == star_of.end())
+        return no_star;
+    return star->second;
+}
+
+body_handle hyperlane_graph::get_star_handle(uint32_t star) const
+{
+    return star_handles[star];
+}
+
+double hyperlane_graph::get_star_x(uint32_t star) const
+{
+    return star_x[star];
+}
+
+double hyperlane_graph::get_star_y(uint32_t star) const
+{
+    return star_y[star];
+}
+
+double hyperlane_graph::distance(uint32_t first_star,uint32_t second_star) const
+{
+    double dx = star_x[first_star] - star_x[second_star],
+           dy = star_y[first_star] - star_y[second_star];
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+uint32_t hyperlane_graph::get_first_lane(uint32_t star) const
+{
+    return lane_offsets[star];
+}
+
+uint32_t hyperlane_graph::get_last_lane(uint32_t star) const
+{
+    return lane_offsets[star + 1];
+}
+
+uint32_t hyperlane_graph::get_lane_target(uint32_t lane) const
+{
+    return lane_targets[lane];
+}
+
+double hyperlane_graph::get_lane_length(uint32_t lane) const
+{
+    return lane_lengths[lane];
+}
+
+/*
+ * The straight distance to the destination never overestimates
+ * the remaining path, a star is final when it leaves the open set
+ */
+double hyperlane_graph::find_path(uint32_t from_star,
+                                  uint32_t to_star,
+                                  std::vector<uint32_t>& path) const
+{
+    return find_path(from_star,to_star,path,[](uint32_t){ return true; });
+}
+
+route_planner::route_planner() :
+    cache_size{default_route_cache_size},
+    hits{0},
+    misses{0}
+{}
+
+void route_planner::configure(game_configuration::game_config_ptr game_conf)
+{
+    std::string option = game_conf->get_option("route_cache_size");
+    if(!option.empty()){
+        set_cache_size(std::stoull(option));
+    }
+}
+
+void route_planner::set_worker_pool(game_workers::worker_pool_ptr worker_pool)
+{
+    workers = worker_pool;
+}
+
+void route_planner::set_cache_size(std::size_t max_routes)
+{
+    std::lock_guard<std::mutex> lock(planner_mtx);
+    cache_size = max_routes;
+    while(routes.size() > cache_size){
+        routes.erase(routes_lru.back());
+        routes_lru.pop_back();
+    }
+}
+
+void route_planner::set_graph(hyperlane_graph_ptr new_graph)
+{
+    std::lock_guard<std::mutex> lock(planner_mtx);
+    graph = new_graph;
+    routes.clear();
+    routes_lru.clear();
+}
+
+hyperlane_route_ptr route_planner::cached(const route_key& key)
+{
+    std::lock_guard<std::mutex> lock(planner_mtx);
+    auto found = routes.find(key);
+    if(found == routes.end()){
+        ++misses;
+        return nullptr;
+    }
+    ++hits;
+    routes_lru.splice(routes_lru.begin(),routes_lru,found->second.lru_position);
+    return found->second.route;
+}
+
+/*
+ * Two threads may search the same route at once,
+ * the first route stored is kept
+ */
+void route_planner::store(const route_key& key,hyperlane_route_ptr route)
+{
+    std::lock_guard<std::mutex> lock(planner_mtx);
+    if(cache_size == 0 || !graph || graph->get_version() != key.version ||
+       routes.find(key) != routes.end())
+        return;
+    routes_lru.push_front(key);
+    routes[key] = {route,routes_lru.begin()};
+    while(routes.size() > cache_size){
+        routes.erase(routes_lru.back());
+        routes_lru.pop_back();
+    }
+}
+
+hyperlane_route_ptr route_planner::find_route(const body_handle& from,
+                                              const body_handle& to)
+{
+    hyperlane_graph_ptr current_graph;
+    {
+        std::lock_guard<std::mutex> lock(planner_mtx);
+        current_graph = graph;
+    }
+    if(!current_graph)
+        return std::make_shared<hyperlane_route>();
+    route_key key{current_graph->star_of_body(from),
+                  current_graph->star_of_body(to),
+                  current_graph->get_version()};
+    if(key.from_star == no_star || key.to_star == no_star)
+        return std::make_shared<hyperlane_route>();
+    hyperlane_route_ptr route = cached(key);
+    if(route)
+        return route;
+    std::vector<uint32_t> path;
+    auto new_route = std::make_shared<hyperlane_route>();
+    double length = current_graph->find_path(key.from_star,key.to_star,path);
+    if(length >= 0){
+        new_route->length = length;
+        new_route->stars.reserve(path.size());
+        for(uint32_t star : path){
+            new_route->stars.push_back(current_graph->get_star_handle(star));
+        }
+    }
+    store(key,new_route);
+    return new_route;
+}
+
+std::vector<hyperlane_route_ptr> route_planner::find_routes(const std::vector<std::pair<body_handle,body_handle>>& requests)
+{
+    std::vector<hyperlane_route_ptr> found_routes(requests.size());
+    auto search_routes = [this,&requests,&found_routes](std::size_t first,std::size_t last){
+        for(std::size_t request{first};request < last;++request){
+            found_routes[request] = find_route(requests[request].first,requests[request].second);
+        }
+    };
+    if(workers){
+        workers->parallel_for(requests.size(),search_routes,routes_per_chunk);
+    }else{
+        search_routes(0,requests.size());
+    }
+    return found_routes;
+}
+
+std::size_t route_planner::get_cached_routes() const
+{
+    std::lock_guard<std::mutex> lock(planner_mtx);
+    return routes.size();
+}
+
+uint64_t route_planner::get_cache_hits() const
+{
+    std::lock_guard<std::mutex> lock(planner_mtx);
+    return hits;
+}
+
+uint64_t route_planner::get_cache_misses() const
+{
+    std::lock_guard<std::mutex> lock(planner_mtx);
+    return misses;
+}
+
+}
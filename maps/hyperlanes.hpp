@@ -0,0 +1,198 @@
+#ifndef HYPERLANES_HPP
+#define HYPERLANES_HPP
+
+#include "maps.hpp"
+#include "path_search.hpp"
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace game_maps
+{
+
+using namespace coordinates;
+
+//Nearest stars checked for the lanes of each star, unless configured otherwise
+static const uint32_t default_hyperlane_candidates = 8;
+//Routes kept by the planner, unless configured otherwise
+static const std::size_t default_route_cache_size = 4096;
+static const uint32_t no_star = UINT32_MAX;
+
+/*
+ * Travel lanes between the stars of a universe map. Two stars
+ * are linked when no other star is closer to both of them than
+ * they are to each other: the relative neighborhood graph, which
+ * is connected and has few lanes per star. Only the nearest
+ * stars of each star are candidates, so the build is O(N log N)
+ * and the rare lanes longer than all the candidates are missed.
+ * The lanes are stored as CSR: the lanes of the star s are
+ * lane_targets[lane_offsets[s]] up to lane_offsets[s + 1].
+ * The graph is a snapshot of the map, each build has a new
+ * version.
+ */
+class hyperlane_graph
+{
+    std::vector<body_handle> star_handles;
+    std::vector<double>      star_x,
+                             star_y;
+    std::vector<uint32_t>    lane_offsets,
+                             lane_targets;
+    std::vector<double>      lane_lengths;
+    std::unordered_map<uint64_t,uint32_t> star_of;
+    uint32_t                 candidates;
+    uint64_t                 version;
+    game_workers::worker_pool_ptr workers;
+
+    void collect_stars(const universe_map& star_chart);
+    void add_lanes(const std::vector<std::pair<uint32_t,uint32_t>>& lanes);
+public:
+    hyperlane_graph();
+    void configure(game_configuration::game_config_ptr game_conf);
+    void set_worker_pool(game_workers::worker_pool_ptr worker_pool);
+    void set_candidates(uint32_t nearest_stars);
+
+    void build(const universe_map& star_chart);
+    uint64_t get_version() const;
+    uint32_t get_stars_count() const;
+    std::size_t get_lanes_count() const;
+
+    //From a body handle to its star in the graph, no_star if not a star
+    uint32_t star_of_body(const body_handle& handle) const;
+    body_handle get_star_handle(uint32_t star) const;
+    double get_star_x(uint32_t star) const;
+    double get_star_y(uint32_t star) const;
+    double distance(uint32_t first_star,uint32_t second_star) const;
+    uint32_t get_first_lane(uint32_t star) const;
+    uint32_t get_last_lane(uint32_t star) const;
+    uint32_t get_lane_target(uint32_t lane) const;
+    double get_lane_length(uint32_t lane) const;
+
+    /*
+     * A* search from a star to another, the stars of the path are
+     * stored from the first to the last. Return the length of the
+     * path, negative if there is none.
+     */
+    double find_path(uint32_t from_star,
+                     uint32_t to_star,
+                     std::vector<uint32_t>& path) const;
+    //Same, only the lanes toward the stars accepted by follow(star) are used
+    template<typename FILTER>
+    double find_path(uint32_t from_star,
+                     uint32_t to_star,
+                     std::vector<uint32_t>& path,
+                     FILTER&& follow) const;
+};
+
+template<typename FILTER>
+double hyperlane_graph::find_path(uint32_t from_star,
+                                  uint32_t to_star,
+                                  std::vector<uint32_t>& path,
+                                  FILTER&& follow) const
+{
+    path.clear();
+    if(from_star >= star_handles.size() || to_star >= star_handles.size())
+        return -1;
+    auto expand = [this,&follow](uint32_t star,auto&& relax){
+        for(uint32_t lane{lane_offsets[star]};lane < lane_offsets[star + 1];++lane){
+            if(follow(lane_targets[lane]))
+                relax(lane_targets[lane],lane_lengths[lane]);
+        }
+    };
+    auto estimate = [this,to_star](uint32_t star){
+        return distance(star,to_star);
+    };
+    best_first(star_handles.size(),from_star,expand,estimate,[to_star](uint32_t star){
+        return star == to_star;
+    });
+    const search_state& state = thread_search_state();
+    if(!state.reached(to_star))
+        return -1;
+    state.path_to(to_star,path);
+    return state.cost[to_star];
+}
+
+using hyperlane_graph_ptr = std::shared_ptr<const hyperlane_graph>;
+
+struct hyperlane_route
+{
+    //From the departure to the destination, empty if unreachable
+    std::vector<body_handle> stars;
+    double                   length;
+
+    hyperlane_route() :
+        length{0}
+    {}
+    bool found() const{
+        return !stars.empty();
+    }
+};
+
+using hyperlane_route_ptr = std::shared_ptr<const hyperlane_route>;
+
+/*
+ * Routes over a hyperlane graph, the computed routes are kept
+ * in a LRU cache keyed by departure, destination and graph
+ * version: many fleets share the same routes. The planner can
+ * be used from many threads at once.
+ */
+class route_planner
+{
+    struct route_key
+    {
+        uint32_t from_star,
+                 to_star;
+        uint64_t version;
+        bool operator==(const route_key& other) const{
+            return from_star == other.from_star && to_star == other.to_star &&
+                   version == other.version;
+        }
+    };
+
+    struct route_key_hash
+    {
+        std::size_t operator()(const route_key& key) const{
+            uint64_t stars = (uint64_t(key.from_star) << 32) | key.to_star;
+            return std::hash<uint64_t>()(stars ^ (key.version * 0x9e3779b97f4a7c15ULL));
+        }
+    };
+
+    using lru_list = std::list<route_key>;
+
+    struct cached_route
+    {
+        hyperlane_route_ptr route;
+        lru_list::iterator  lru_position;
+    };
+
+    hyperlane_graph_ptr graph;
+    std::unordered_map<route_key,cached_route,route_key_hash> routes;
+    lru_list            routes_lru;
+    std::size_t         cache_size;
+    uint64_t            hits,
+                        misses;
+    mutable std::mutex  planner_mtx;
+    game_workers::worker_pool_ptr workers;
+
+    hyperlane_route_ptr cached(const route_key& key);
+    void store(const route_key& key,hyperlane_route_ptr route);
+public:
+    route_planner();
+    void configure(game_configuration::game_config_ptr game_conf);
+    void set_worker_pool(game_workers::worker_pool_ptr worker_pool);
+    void set_cache_size(std::size_t max_routes);
+    //The routes of the previous graph are dropped
+    void set_graph(hyperlane_graph_ptr new_graph);
+
+    hyperlane_route_ptr find_route(const body_handle& from,
+                                   const body_handle& to);
+    //The routes are searched across the workers
+    std::vector<hyperlane_route_ptr> find_routes(const std::vector<std::pair<body_handle,body_handle>>& requests);
+    std::size_t get_cached_routes() const;
+    uint64_t get_cache_hits() const;
+    uint64_t get_cache_misses() const;
+};
+
+}
+
+#endif
@@ -0,0 +1,767 @@
+#include "../logger/logger.hpp"
+#include "influence.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace game_maps
+{
+
+namespace
+{
+
+//Rows handled by each job of a flood pass
+const std::size_t rows_per_chunk = 16;
+const uint32_t no_pixel = UINT32_MAX,
+               no_system = UINT32_MAX;
+const int32_t no_distance = INT32_MAX;
+//Beyond one change every this many systems the whole raster is flooded
+const std::size_t systems_per_reflood_change = 16;
+
+//Distances of the row being flooded to its nearest system pixel so far
+thread_local std::vector<int32_t> row_distances;
+
+uint32_t pack_pixel(uint32_t column,uint32_t row)
+{
+    return (row << 16) | column;
+}
+
+uint32_t pixel_column(uint32_t pixel)
+{
+    return pixel & 0xffff;
+}
+
+uint32_t pixel_row(uint32_t pixel)
+{
+    return pixel >> 16;
+}
+
+//Same result as the sub and madd of the vector kernel
+int32_t pixel_distance(uint32_t system_pixel,uint32_t pixel)
+{
+    if(system_pixel == no_pixel)
+        return no_distance;
+    int32_t dx = int32_t(pixel_column(system_pixel)) - int32_t(pixel_column(pixel)),
+            dy = int32_t(pixel_row(system_pixel)) - int32_t(pixel_row(pixel));
+    return dx * dx + dy * dy;
+}
+
+//The pixel and its 8 neighbors are compared at once
+const uint32_t max_candidates = 9;
+
+/*
+ * Keep the closest of the current and the candidate system
+ * pixels for 'count' pixels of a row, the first of them is
+ * 'first_pixel'. The candidates are compared in order, on a
+ * tie the current one stays.
+ */
+void closer_scalar(const uint32_t* const* candidates,
+                   uint32_t candidates_count,
+                   uint32_t* nearest_pixels,
+                   int32_t* distances,
+                   uint32_t first_pixel,
+                   std::size_t count)
+{
+    for(std::size_t pixel{0};pixel < count;++pixel){
+        for(uint32_t candidate{0};candidate < candidates_count;++candidate){
+            uint32_t system_pixel = candidates[candidate][pixel];
+            int32_t distance = pixel_distance(system_pixel,first_pixel + pixel);
+            if(distance < distances[pixel]){
+                distances[pixel] = distance;
+                nearest_pixels[pixel] = system_pixel;
+            }
+        }
+    }
+}
+
+#ifdef MAPS_X86_KERNELS
+
+/*
+ * The packed pixels are subtracted as pairs of 16 bit
+ * coordinates, madd squares and sums the pair in one step.
+ */
+__attribute__((target("avx2")))
+void closer_avx2(const uint32_t* const* candidates,
+                 uint32_t candidates_count,
+                 uint32_t* nearest_pixels,
+                 int32_t* distances,
+                 uint32_t first_pixel,
+                 std::size_t count)
+{
+    const __m256i missing = _mm256_set1_epi32(-1),
+                  far = _mm256_set1_epi32(no_distance),
+                  next_pixels = _mm256_set1_epi32(8);
+    __m256i pixels = _mm256_add_epi32(_mm256_set1_epi32(first_pixel),
+                                      _mm256_setr_epi32(0,1,2,3,4,5,6,7));
+    std::size_t pixel{0};
+    for(;pixel + 8 <= count;pixel += 8){
+        __m256i best = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(distances + pixel)),
+                best_pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(nearest_pixels + pixel));
+        for(uint32_t candidate{0};candidate < candidates_count;++candidate){
+            __m256i system_pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(candidates[candidate] + pixel)),
+                    difference = _mm256_sub_epi16(system_pixels,pixels),
+                    distance = _mm256_madd_epi16(difference,difference);
+            distance = _mm256_blendv_epi8(distance,far,_mm256_cmpeq_epi32(system_pixels,missing));
+            __m256i closer = _mm256_cmpgt_epi32(best,distance);
+            best = _mm256_blendv_epi8(best,distance,closer);
+            best_pixels = _mm256_blendv_epi8(best_pixels,system_pixels,closer);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(distances + pixel),best);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(nearest_pixels + pixel),best_pixels);
+        pixels = _mm256_add_epi32(pixels,next_pixels);
+    }
+    const uint32_t* rest[max_candidates];
+    for(uint32_t candidate{0};candidate < candidates_count;++candidate){
+        rest[candidate] = candidates[candidate] + pixel;
+    }
+    closer_scalar(rest,candidates_count,nearest_pixels + pixel,distances + pixel,
+                  first_pixel + pixel,count - pixel);
+}
+
+#endif
+
+void closer_pixels(simd_kernel kernel,
+                   const uint32_t* const* candidates,
+                   uint32_t candidates_count,
+                   uint32_t* nearest_pixels,
+                   int32_t* distances,
+                   uint32_t first_pixel,
+                   std::size_t count)
+{
+    switch(kernel){
+#ifdef MAPS_X86_KERNELS
+    case simd_kernel::avx2:
+        closer_avx2(candidates,candidates_count,nearest_pixels,distances,first_pixel,count);
+        break;
+#endif
+    default:
+        closer_scalar(candidates,candidates_count,nearest_pixels,distances,first_pixel,count);
+    }
+}
+
+/*
+ * One jump flood pass over the columns from first_column up to
+ * last_column of a row, the target holds only those columns:
+ * each pixel starts from its own system pixel and looks at the 8
+ * pixels 'step' away. The row is swept once for all of them, the
+ * segments near the sides of the raster have fewer neighbors.
+ */
+void flood_row(simd_kernel kernel,
+               const uint32_t* source,
+               uint32_t* target,
+               uint32_t columns,
+               uint32_t rows,
+               uint32_t row,
+               uint32_t step,
+               uint32_t first_column,
+               uint32_t last_column)
+{
+    std::vector<int32_t>& distances = row_distances;
+    distances.assign(last_column - first_column,no_distance);
+    std::fill(target,target + (last_column - first_column),no_pixel);
+    //Within each segment of the row the same neighbors are inside the raster
+    uint32_t bounds[] = {first_column,std::min(step,columns),columns > step ? columns - step : 0,last_column};
+    for(uint32_t& bound : bounds){
+        bound = std::min(std::max(bound,first_column),last_column);
+    }
+    std::sort(bounds,bounds + 4);
+    for(uint32_t segment{0};segment < 3;++segment){
+        uint32_t segment_from = bounds[segment],
+                 segment_to = bounds[segment + 1];
+        if(segment_from == segment_to)
+            continue;
+        const uint32_t* candidates[max_candidates];
+        uint32_t candidates_count{0};
+        for(int32_t row_offset{-1};row_offset <= 1;++row_offset){
+            int64_t neighbor_row = int64_t(row) + row_offset * int64_t(step);
+            if(neighbor_row < 0 || neighbor_row >= rows)
+                continue;
+            const uint32_t* neighbors = source + std::size_t(neighbor_row) * columns + segment_from;
+            if(segment_from >= step)
+                candidates[candidates_count++] = neighbors - step;
+            candidates[candidates_count++] = neighbors;
+            if(uint64_t(segment_from) + step < columns)
+                candidates[candidates_count++] = neighbors + step;
+        }
+        closer_pixels(kernel,candidates,candidates_count,target + (segment_from - first_column),
+                      distances.data() + (segment_from - first_column),pack_pixel(segment_from,row),
+                      segment_to - segment_from);
+    }
+}
+
+}
+
+influence_map::influence_map() :
+    universe_width{0},
+    universe_height{0},
+    requested_columns{default_influence_grid_size},
+    requested_rows{default_influence_grid_size},
+    columns{default_influence_grid_size},
+    rows{default_influence_grid_size},
+    influence_radius{0},
+    pixel_side{1},
+    flood_needed{true},
+    labels_needed{true},
+    kernel{available_simd_kernel()}
+{}
+
+void influence_map::configure(game_configuration::game_config_ptr game_conf)
+{
+    std::string option = game_conf->get_option("influence_grid_size");
+    if(!option.empty()){
+        uint32_t grid_size = std::stoul(option);
+        set_grid_size(grid_size,grid_size);
+    }
+    option = game_conf->get_option("influence_radius");
+    if(!option.empty()){
+        set_influence_radius(std::stoul(option));
+    }
+}
+
+void influence_map::set_worker_pool(game_workers::worker_pool_ptr worker_pool)
+{
+    workers = worker_pool;
+}
+
+void influence_map::set_kernel(simd_kernel new_kernel)
+{
+    kernel = new_kernel;
+}
+
+void influence_map::set_universe_size(uint32_t width,
+                                      uint32_t height)
+{
+    universe_width = width;
+    universe_height = height;
+    fit_grid();
+    place_systems();
+}
+
+void influence_map::set_grid_size(uint32_t grid_columns,
+                                  uint32_t grid_rows)
+{
+    if(grid_columns == 0 || grid_rows == 0 ||
+       grid_columns > max_influence_grid_size || grid_rows > max_influence_grid_size){
+        WARN1("Invalid influence grid size ",grid_columns,"x",grid_rows);
+        return;
+    }
+    requested_columns = grid_columns;
+    requested_rows = grid_rows;
+    fit_grid();
+    place_systems();
+}
+
+void influence_map::set_influence_radius(uint32_t radius)
+{
+    influence_radius = radius;
+    labels_needed = true;
+}
+
+uint32_t influence_map::get_columns() const
+{
+    return columns;
+}
+
+uint32_t influence_map::get_rows() const
+{
+    return rows;
+}
+
+/*
+ * The pixel side is the smallest which fits the universe within
+ * the requested grid, the other side of the grid is then cut to
+ * what the universe needs.
+ */
+void influence_map::fit_grid()
+{
+    columns = requested_columns;
+    rows = requested_rows;
+    pixel_side = 1;
+    if(universe_width == 0 || universe_height == 0)
+        return;
+    pixel_side = std::max(double(universe_width) / requested_columns,
+                          double(universe_height) / requested_rows);
+    columns = std::min<uint32_t>(requested_columns,std::max(1.0,std::ceil(universe_width / pixel_side)));
+    rows = std::min<uint32_t>(requested_rows,std::max(1.0,std::ceil(universe_height / pixel_side)));
+    LOG3("Influence grid ready, ",columns,"x",rows," pixels of side ",pixel_side);
+}
+
+uint32_t influence_map::pixel_of(const object_coordinates& position) const
+{
+    uint32_t column = universe_width == 0 ? 0 : std::min<double>(position.x / pixel_side,columns - 1),
+             row = universe_height == 0 ? 0 : std::min<double>(position.y / pixel_side,rows - 1);
+    return pack_pixel(column,row);
+}
+
+//The pixels of the systems follow the universe and the grid size
+void influence_map::place_systems()
+{
+    for(uint32_t system{0};system < system_positions.size();++system){
+        system_pixels[system] = pixel_of(system_positions[system]);
+    }
+    flood_needed = true;
+}
+
+bool influence_map::set_system(uint64_t system_id,
+                               const object_coordinates& position,
+                               uint16_t owner)
+{
+    auto found = system_of.find(system_id);
+    if(found == system_of.end()){
+        system_of.emplace(system_id,system_ids.size());
+        system_ids.push_back(system_id);
+        system_positions.push_back(position);
+        system_pixels.push_back(pixel_of(position));
+        system_owners.push_back(owner);
+        system_boxes.emplace_back();
+        reached_pixels.push_back(system_pixels.back());
+        return true;
+    }
+    uint32_t system = found->second;
+    system_positions[system] = position;
+    if(system_pixels[system] != pixel_of(position)){
+        vacate(system);
+        system_pixels[system] = pixel_of(position);
+        system_owners[system] = owner;
+        reached_pixels.push_back(system_pixels[system]);
+        return true;
+    }
+    return set_owner(system_id,owner);
+}
+
+bool influence_map::set_owner(uint64_t system_id,
+                              uint16_t owner)
+{
+    auto found = system_of.find(system_id);
+    if(found == system_of.end())
+        return false;
+    uint32_t system = found->second;
+    if(system_owners[system] != owner){
+        system_owners[system] = owner;
+        changed_owners.push_back(system);
+    }
+    return true;
+}
+
+//The last system takes the place of the removed one
+bool influence_map::remove_system(uint64_t system_id)
+{
+    auto found = system_of.find(system_id);
+    if(found == system_of.end())
+        return false;
+    uint32_t system = found->second,
+             last_system = system_ids.size() - 1;
+    vacate(system);
+    system_of.erase(found);
+    if(system != last_system){
+        system_of[system_ids[last_system]] = system;
+        system_ids[system] = system_ids[last_system];
+        system_positions[system] = system_positions[last_system];
+        system_pixels[system] = system_pixels[last_system];
+        system_owners[system] = system_owners[last_system];
+        system_boxes[system] = system_boxes[last_system];
+    }
+    changed_owners.erase(std::remove(changed_owners.begin(),changed_owners.end(),system),
+                         changed_owners.end());
+    std::replace(changed_owners.begin(),changed_owners.end(),last_system,system);
+    system_ids.pop_back();
+    system_positions.pop_back();
+    system_pixels.pop_back();
+    system_owners.pop_back();
+    system_boxes.pop_back();
+    return true;
+}
+
+//The box is that of the last labelling, a system added since then held no pixels
+void influence_map::vacate(uint32_t system)
+{
+    vacated_pixels.push_back({system_pixels[system],system_boxes[system]});
+    system_boxes[system] = cell_box{};
+}
+
+uint32_t influence_map::get_systems_count() const
+{
+    return system_ids.size();
+}
+
+/*
+ * The steps go from half the raster side down to one,
+ * plus a last pass of step one which fixes most of the
+ * pixels the bigger steps got wrong.
+ */
+void influence_map::flood()
+{
+    std::size_t pixels = std::size_t(columns) * rows;
+    nearest.assign(pixels,no_pixel);
+    flood_scratch.resize(pixels);
+    for(uint32_t pixel : system_pixels){
+        nearest[std::size_t(pixel_row(pixel)) * columns + pixel_column(pixel)] = pixel;
+    }
+    vacated_pixels.clear();
+    reached_pixels.clear();
+    if(system_pixels.empty())
+        return;
+    uint32_t side = std::max(columns,rows),
+             step{1};
+    while(step * 2 < side){
+        step *= 2;
+    }
+    std::vector<uint32_t> steps;
+    for(;step > 0;step /= 2){
+        steps.push_back(step);
+    }
+    steps.push_back(1);
+    LOG3("Flooding the influence map, ",columns,"x",rows," pixels in ",steps.size()," passes");
+    for(uint32_t pass_step : steps){
+        auto flood_rows = [this,pass_step](std::size_t first,std::size_t last){
+            for(std::size_t row{first};row < last;++row){
+                flood_row(kernel,nearest.data(),flood_scratch.data() + row * columns,columns,rows,row,
+                          pass_step,0,columns);
+            }
+        };
+        if(workers){
+            workers->parallel_for(rows,flood_rows,rows_per_chunk);
+        }else{
+            flood_rows(0,rows);
+        }
+        nearest.swap(flood_scratch);
+    }
+}
+
+/*
+ * Same passes as the full flood, over the pixels of the window
+ * only. The pixels around it are already right and are read as
+ * they are, each pass copies the window back from its scratch.
+ */
+void influence_map::flood_window(const cell_box& window)
+{
+    uint32_t width = window.column_to - window.column_from + 1,
+             height = window.row_to - window.row_from + 1,
+             side = std::max(width,height),
+             step{1};
+    while(step * 2 < side){
+        step *= 2;
+    }
+    std::vector<uint32_t> steps;
+    for(;step > 0;step /= 2){
+        steps.push_back(step);
+    }
+    steps.push_back(1);
+    window_scratch.resize(std::size_t(width) * height);
+    for(uint32_t pass_step : steps){
+        auto flood_rows = [this,&window,pass_step,width](std::size_t first,std::size_t last){
+            for(std::size_t row{first};row < last;++row){
+                flood_row(kernel,nearest.data(),window_scratch.data() + row * width,columns,rows,
+                          window.row_from + row,pass_step,window.column_from,window.column_to + 1);
+            }
+        };
+        if(workers){
+            workers->parallel_for(height,flood_rows,rows_per_chunk);
+        }else{
+            flood_rows(0,height);
+        }
+        for(uint32_t row{0};row < height;++row){
+            std::copy(window_scratch.begin() + std::size_t(row) * width,
+                      window_scratch.begin() + std::size_t(row + 1) * width,
+                      nearest.begin() + std::size_t(window.row_from + row) * columns + window.column_from);
+        }
+    }
+}
+
+/*
+ * The pixels closer to the new system pixel than to their
+ * current one are connected to it, they are found by growing
+ * from the system pixel. The pixels on a tie are taken as well,
+ * or they would cut the growth short. Return the extent of the
+ * pixels taken.
+ */
+influence_map::cell_box influence_map::grow_from(uint32_t system_pixel)
+{
+    cell_box grown;
+    std::vector<uint32_t> pending{system_pixel};
+    while(!pending.empty()){
+        uint32_t pixel = pending.back(),
+                 column = pixel_column(pixel),
+                 row = pixel_row(pixel);
+        pending.pop_back();
+        uint32_t& nearest_pixel = nearest[std::size_t(row) * columns + column];
+        if(nearest_pixel == system_pixel ||
+           pixel_distance(system_pixel,pixel) > pixel_distance(nearest_pixel,pixel))
+            continue;
+        nearest_pixel = system_pixel;
+        grown.extend(column,column,row);
+        if(column > 0)
+            pending.push_back(pack_pixel(column - 1,row));
+        if(column + 1 < columns)
+            pending.push_back(pack_pixel(column + 1,row));
+        if(row > 0)
+            pending.push_back(pack_pixel(column,row - 1));
+        if(row + 1 < rows)
+            pending.push_back(pack_pixel(column,row + 1));
+    }
+    return grown;
+}
+
+/*
+ * The pixels held by a system pixel left empty are cleared
+ * first, so that no window is flooded from a pixel which is
+ * going away. A pixel still held by another system keeps its
+ * space, a pixel reached by a system removed in the meanwhile
+ * is skipped. Only the windows and the pixels taken by the
+ * systems are labeled again.
+ */
+void influence_map::reflood()
+{
+    std::vector<uint32_t> held_pixels(system_pixels);
+    std::sort(held_pixels.begin(),held_pixels.end());
+    auto held = [&held_pixels](uint32_t pixel){
+        return std::binary_search(held_pixels.begin(),held_pixels.end(),pixel);
+    };
+    std::vector<cell_box> windows,
+                          relabeled;
+    for(const auto& vacated : vacated_pixels){
+        const cell_box& box = vacated.box;
+        if(box.empty())
+            continue;
+        if(held(vacated.pixel)){
+            relabeled.push_back(box);
+            continue;
+        }
+        for(uint32_t row = box.row_from;row <= box.row_to;++row){
+            uint32_t* nearest_row = nearest.data() + std::size_t(row) * columns;
+            std::replace(nearest_row + box.column_from,nearest_row + box.column_to + 1,
+                         vacated.pixel,no_pixel);
+        }
+        windows.push_back(box);
+    }
+    //Windows touching each other are flooded as one, or one might be filled from the other
+    for(std::size_t window{0};window < windows.size();){
+        cell_box& box = windows[window];
+        auto touching = std::find_if(windows.begin() + window + 1,windows.end(),[&box](const cell_box& other){
+            return other.column_from <= box.column_to + 1 && box.column_from <= other.column_to + 1 &&
+                   other.row_from <= box.row_to + 1 && box.row_from <= other.row_to + 1;
+        });
+        if(touching == windows.end()){
+            ++window;
+            continue;
+        }
+        box.extend(touching->column_from,touching->column_to,touching->row_from);
+        box.extend(touching->column_from,touching->column_to,touching->row_to);
+        windows.erase(touching);
+        window = 0;
+    }
+    for(const auto& window : windows){
+        flood_window(window);
+        relabeled.push_back(window);
+    }
+    for(uint32_t pixel : reached_pixels){
+        if(held(pixel)){
+            relabeled.push_back(grow_from(pixel));
+        }
+    }
+    vacated_pixels.clear();
+    reached_pixels.clear();
+    map_systems();
+    //The first system of a shared pixel may have changed, the space of all of them is relabeled
+    std::vector<uint32_t> shared_pixels;
+    for(std::size_t pixel{1};pixel < held_pixels.size();++pixel){
+        if(held_pixels[pixel] == held_pixels[pixel - 1])
+            shared_pixels.push_back(held_pixels[pixel]);
+    }
+    if(!shared_pixels.empty()){
+        for(uint32_t system{0};system < system_pixels.size();++system){
+            if(std::binary_search(shared_pixels.begin(),shared_pixels.end(),system_pixels[system]))
+                relabeled.push_back(system_boxes[system]);
+        }
+    }
+    for(const auto& window : relabeled){
+        label_window(window);
+    }
+}
+
+//The flood scratch holds the first system of each system pixel, nothing else is read from it
+void influence_map::map_systems()
+{
+    for(uint32_t pixel : system_pixels){
+        flood_scratch[std::size_t(pixel_row(pixel)) * columns + pixel_column(pixel)] = no_system;
+    }
+    for(uint32_t system{0};system < system_pixels.size();++system){
+        uint32_t& pixel_system = flood_scratch[std::size_t(pixel_row(system_pixels[system])) * columns +
+                                               pixel_column(system_pixels[system])];
+        if(pixel_system == no_system){
+            pixel_system = system;
+        }
+    }
+}
+
+//Squared distance in pixels up to which a system holds space
+int64_t influence_map::claimed_distance() const
+{
+    double radius_pixels = influence_radius / pixel_side;
+    return influence_radius == 0 ? INT64_MAX : int64_t(radius_pixels * radius_pixels);
+}
+
+/*
+ * The flood scratch becomes the system of each system pixel.
+ * The rows are split in bands, one for each worker, and each
+ * band collects the extent of the systems in its own boxes.
+ * The boxes are updated once for each run of pixels with the
+ * same system.
+ */
+void influence_map::label()
+{
+    std::size_t pixels = std::size_t(columns) * rows;
+    map_systems();
+    owners.resize(pixels);
+    const cell_box no_box;
+    std::size_t bands = workers ? workers->size() + 1 : 1;
+    std::vector<std::vector<cell_box>> band_boxes(bands);
+    int64_t max_distance = claimed_distance();
+    auto label_bands = [&](std::size_t first_band,std::size_t last_band){
+        for(std::size_t band{first_band};band < last_band;++band){
+            std::vector<cell_box>& boxes = band_boxes[band];
+            boxes.assign(system_pixels.size(),no_box);
+            for(uint32_t row = band * rows / bands;row < (band + 1) * rows / bands;++row){
+                const uint32_t* nearest_row = nearest.data() + std::size_t(row) * columns;
+                uint16_t* owners_row = owners.data() + std::size_t(row) * columns;
+                uint32_t run_start{0},
+                         run_system{no_system};
+                for(uint32_t column{0};column < columns;++column){
+                    uint32_t system_pixel = nearest_row[column];
+                    if(system_pixel == no_pixel){
+                        owners_row[column] = no_owner;
+                        continue;
+                    }
+                    uint32_t system = flood_scratch[std::size_t(pixel_row(system_pixel)) * columns +
+                                                    pixel_column(system_pixel)];
+                    if(system != run_system){
+                        if(run_system != no_system)
+                            boxes[run_system].extend(run_start,column - 1,row);
+                        run_system = system;
+                        run_start = column;
+                    }
+                    owners_row[column] = pixel_distance(system_pixel,pack_pixel(column,row)) > max_distance ?
+                                         no_owner : system_owners[system];
+                }
+                if(run_system != no_system)
+                    boxes[run_system].extend(run_start,columns - 1,row);
+            }
+        }
+    };
+    if(workers){
+        workers->parallel_for(bands,label_bands,1);
+    }else{
+        label_bands(0,bands);
+    }
+    std::fill(system_boxes.begin(),system_boxes.end(),no_box);
+    for(const auto& boxes : band_boxes){
+        for(uint32_t system{0};system < boxes.size();++system){
+            const cell_box& box = boxes[system];
+            if(!box.empty()){
+                system_boxes[system].extend(box.column_from,box.column_to,box.row_from);
+                system_boxes[system].extend(box.column_from,box.column_to,box.row_to);
+            }
+        }
+    }
+}
+
+/*
+ * The systems holding pixels of the window extend their boxes,
+ * the boxes of the systems which lost pixels are left larger
+ * than needed.
+ */
+void influence_map::label_window(const cell_box& window)
+{
+    int64_t max_distance = claimed_distance();
+    for(uint32_t row = window.row_from;row <= window.row_to;++row){
+        const uint32_t* nearest_row = nearest.data() + std::size_t(row) * columns;
+        uint16_t* owners_row = owners.data() + std::size_t(row) * columns;
+        for(uint32_t column = window.column_from;column <= window.column_to;++column){
+            uint32_t system_pixel = nearest_row[column];
+            if(system_pixel == no_pixel){
+                owners_row[column] = no_owner;
+                continue;
+            }
+            uint32_t system = flood_scratch[std::size_t(pixel_row(system_pixel)) * columns +
+                                            pixel_column(system_pixel)];
+            system_boxes[system].extend(column,column,row);
+            owners_row[column] = pixel_distance(system_pixel,pack_pixel(column,row)) > max_distance ?
+                                 no_owner : system_owners[system];
+        }
+    }
+}
+
+/*
+ * Only the pixels within the extent of the system are checked,
+ * the flood scratch still holds the system of each system pixel.
+ */
+void influence_map::relabel(uint32_t system)
+{
+    uint32_t system_pixel = system_pixels[system];
+    const cell_box& box = system_boxes[system];
+    //A system sharing its pixel with a previous one holds no space
+    if(box.empty() ||
+       flood_scratch[std::size_t(pixel_row(system_pixel)) * columns + pixel_column(system_pixel)] != system)
+        return;
+    int64_t max_distance = claimed_distance();
+    for(uint32_t row = box.row_from;row <= box.row_to;++row){
+        const uint32_t* nearest_row = nearest.data() + std::size_t(row) * columns;
+        uint16_t* owners_row = owners.data() + std::size_t(row) * columns;
+        for(uint32_t column = box.column_from;column <= box.column_to;++column){
+            if(nearest_row[column] == system_pixel){
+                owners_row[column] = pixel_distance(system_pixel,pack_pixel(column,row)) > max_distance ?
+                                     no_owner : system_owners[system];
+            }
+        }
+    }
+}
+
+bool influence_map::update()
+{
+    bool reflooded{false};
+    if(!vacated_pixels.empty() || !reached_pixels.empty()){
+        if(!flood_needed && (vacated_pixels.size() + reached_pixels.size()) *
+                            systems_per_reflood_change <= system_pixels.size()){
+            reflood();
+            reflooded = true;
+        }else{
+            flood_needed = true;
+        }
+    }
+    if(flood_needed){
+        flood();
+        flood_needed = false;
+        labels_needed = true;
+    }
+    if(labels_needed){
+        label();
+        labels_needed = false;
+        changed_owners.clear();
+        return true;
+    }
+    for(uint32_t system : changed_owners){
+        relabel(system);
+    }
+    changed_owners.clear();
+    return reflooded;
+}
+
+const std::vector<uint16_t>& influence_map::get_owners() const
+{
+    return owners;
+}
+
+uint16_t influence_map::owner_at(uint32_t column,
+                                 uint32_t row) const
+{
+    if(column >= columns || row >= rows || owners.empty())
+        return no_owner;
+    return owners[std::size_t(row) * columns + column];
+}
+
+uint16_t influence_map::owner_at(const object_coordinates& position) const
+{
+    uint32_t pixel = pixel_of(position);
+    return owner_at(pixel_column(pixel),pixel_row(pixel));
+}
+
+}
@@ -0,0 +1,146 @@
+#ifndef INFLUENCE_HPP
+#define INFLUENCE_HPP
+
+#include "maps.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+namespace game_maps
+{
+
+using namespace coordinates;
+
+//Side of the ownership raster, unless configured otherwise
+static const uint32_t default_influence_grid_size = 1024;
+//The pixel coordinates and their differences shall fit 16 bits
+static const uint32_t max_influence_grid_size = 16384;
+static const uint16_t no_owner = UINT16_MAX;
+
+/*
+ * Ownership raster of the universe: each pixel belongs to the
+ * owner of the nearest system, the unowned systems hold neutral
+ * space. The nearest system of each pixel is found by jump
+ * flooding: each pass looks at the 8 pixels 'step' away and
+ * keeps the closest of their systems, the step halves at each
+ * pass. The pixels store the packed coordinates of the pixel of
+ * their system, so the distances need no lookup and the rows
+ * are processed 8 pixels at once. The pixels are square, so
+ * the distances in pixels follow those in the universe. The
+ * systems sharing a pixel
+ * are represented by the first of them.
+ * A change of owner does not move the borders between the
+ * systems, only the pixels of the system are relabeled. A system
+ * which leaves its pixel frees the extent of the pixels it held,
+ * only that window is flooded again. A system reaching a pixel
+ * takes the pixels closer to it, growing from its own pixel.
+ * Past a few changes, or on a resize, all the raster is flooded.
+ */
+class influence_map
+{
+    //Empty until extended
+    struct cell_box
+    {
+        uint16_t column_from{UINT16_MAX},
+                 column_to{0},
+                 row_from{UINT16_MAX},
+                 row_to{0};
+        bool empty() const{
+            return column_from > column_to;
+        }
+        void extend(uint32_t first_column,uint32_t last_column,uint32_t row){
+            column_from = std::min<uint32_t>(column_from,first_column);
+            column_to = std::max<uint32_t>(column_to,last_column);
+            row_from = std::min<uint32_t>(row_from,row);
+            row_to = std::max<uint32_t>(row_to,row);
+        }
+    };
+
+    //Pixel left by a system and the extent of the pixels it held
+    struct vacated_pixel
+    {
+        uint32_t pixel;
+        cell_box box;
+    };
+
+    uint32_t universe_width,
+             universe_height,
+             requested_columns,
+             requested_rows,
+             columns,
+             rows,
+             influence_radius;
+    //Side of the square pixels, in universe units
+    double   pixel_side;
+    //Position, packed pixel, owner and extent of the pixels of each system
+    std::vector<object_coordinates> system_positions;
+    std::vector<uint32_t> system_pixels;
+    std::vector<uint16_t> system_owners;
+    std::vector<uint64_t> system_ids;
+    std::vector<cell_box> system_boxes;
+    std::unordered_map<uint64_t,uint32_t> system_of;
+    //Nearest system pixel of each pixel, then the system of each system pixel
+    std::vector<uint32_t> nearest,
+                          flood_scratch,
+                          window_scratch;
+    std::vector<uint16_t> owners;
+    std::vector<uint32_t> changed_owners;
+    //Changes since the last flood
+    std::vector<vacated_pixel> vacated_pixels;
+    std::vector<uint32_t> reached_pixels;
+    bool                  flood_needed,
+                          labels_needed;
+    simd_kernel           kernel;
+    game_workers::worker_pool_ptr workers;
+
+    void fit_grid();
+    uint32_t pixel_of(const object_coordinates& position) const;
+    void place_systems();
+    void flood();
+    void vacate(uint32_t system);
+    void flood_window(const cell_box& window);
+    cell_box grow_from(uint32_t system_pixel);
+    void reflood();
+    void map_systems();
+    int64_t claimed_distance() const;
+    void label();
+    void label_window(const cell_box& window);
+    void relabel(uint32_t system);
+public:
+    influence_map();
+    void configure(game_configuration::game_config_ptr game_conf);
+    void set_worker_pool(game_workers::worker_pool_ptr worker_pool);
+    void set_kernel(simd_kernel new_kernel);
+    void set_universe_size(uint32_t width,
+                           uint32_t height);
+    //Most pixels of the grid, the pixels are square and the grid is cut to the universe
+    void set_grid_size(uint32_t grid_columns,
+                       uint32_t grid_rows);
+    //Farthest a system holds space, in universe units, 0 for no limit
+    void set_influence_radius(uint32_t radius);
+    uint32_t get_columns() const;
+    uint32_t get_rows() const;
+
+    //Add a system or move it, the systems are identified by the caller
+    bool set_system(uint64_t system_id,
+                    const object_coordinates& position,
+                    uint16_t owner = no_owner);
+    bool set_owner(uint64_t system_id,
+                   uint16_t owner);
+    bool remove_system(uint64_t system_id);
+    uint32_t get_systems_count() const;
+
+    /*
+     * Bring the raster up to date, return false if only the
+     * pixels of the systems whose owner changed were relabeled
+     */
+    bool update();
+    //Owners as of the last update, one row after the other
+    const std::vector<uint16_t>& get_owners() const;
+    uint16_t owner_at(uint32_t column,
+                      uint32_t row) const;
+    uint16_t owner_at(const object_coordinates& position) const;
+};
+
+}
+
+#endif
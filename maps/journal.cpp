@@ -0,0 +1,308 @@
+#include "../logger/logger.hpp"
+#include "journal.hpp"
+#include "maps.hpp"
+#include <iterator>
+
+namespace game_maps
+{
+
+namespace
+{
+
+const std::size_t journal_header_size = sizeof(uint64_t) + sizeof(uint32_t);
+
+void put_value(std::vector<char>& buffer,uint64_t value,std::size_t bytes)
+{
+    for(std::size_t byte{0};byte < bytes;++byte){
+        buffer.push_back(char(value >> (8 * byte)));
+    }
+}
+
+std::vector<char> journal_header()
+{
+    std::vector<char> header;
+    put_value(header,journal_magic,sizeof(uint64_t));
+    put_value(header,journal_version,sizeof(uint32_t));
+    return header;
+}
+
+//Sequential reader of the records, it fails instead of reading past the end
+class record_reader
+{
+    const std::vector<char>& data;
+    std::size_t              offset;
+public:
+    record_reader(const std::vector<char>& journal_data,
+                  std::size_t first_offset) :
+        data{journal_data},
+        offset{first_offset}
+    {}
+
+    bool at_end() const{
+        return offset == data.size();
+    }
+    bool get(uint64_t& value,std::size_t bytes){
+        if(data.size() - offset < bytes)
+            return false;
+        value = 0;
+        for(std::size_t byte{0};byte < bytes;++byte){
+            value |= uint64_t(uint8_t(data[offset++])) << (8 * byte);
+        }
+        return true;
+    }
+    bool get(std::string& text,std::size_t length){
+        if(data.size() - offset < length)
+            return false;
+        text.assign(data.data() + offset,length);
+        offset += length;
+        return true;
+    }
+};
+
+}
+
+void universe_journal::journal_writer::write_queued()
+{
+    std::unique_lock<std::mutex> lock(writer_mtx);
+    if(writing)
+        return;
+    writing = true;
+    while(!queued.empty()){
+        std::vector<char> records = std::move(queued.front());
+        queued.pop_front();
+        lock.unlock();
+        out.write(records.data(),records.size());
+        out.flush();
+        lock.lock();
+        failed = failed || !out;
+    }
+    writing = false;
+    writes_done.notify_all();
+}
+
+universe_journal::universe_journal() :
+    records{0},
+    writer{std::make_shared<journal_writer>()}
+{}
+
+universe_journal::~universe_journal()
+{
+    flush();
+    wait();
+}
+
+bool universe_journal::open(const std::string& journal_file)
+{
+    wait();
+    LOG3("Opening the journal ",journal_file.c_str());
+    std::vector<char> header = journal_header();
+    std::ifstream in(journal_file,std::ios::binary);
+    std::vector<char> existing_header(header.size());
+    bool existing = in && in.read(existing_header.data(),existing_header.size());
+    if(existing && existing_header != header){
+        WARN1("The journal ",journal_file.c_str()," is not valid");
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(writer->writer_mtx);
+    writer->out.close();
+    writer->out.clear();
+    writer->out.open(journal_file,std::ios::binary | (existing ? std::ios::app : std::ios::trunc));
+    if(!existing){
+        writer->out.write(header.data(),header.size());
+        writer->out.flush();
+    }
+    writer->failed = !writer->out;
+    file_name = journal_file;
+    return !writer->failed;
+}
+
+/*
+ * The journal writes in background only with
+ * a worker pool with at least one thread
+ */
+void universe_journal::set_worker_pool(game_workers::worker_pool_ptr worker_pool)
+{
+    workers = worker_pool;
+}
+
+void universe_journal::begin_record(journal_operation operation,
+                                    const body_handle& handle)
+{
+    put_value(buffer,uint8_t(operation),sizeof(uint8_t));
+    put_value(buffer,handle.id(),sizeof(uint64_t));
+    ++records;
+}
+
+void universe_journal::record_add(const body_handle& handle,
+                                  const object_hot_info& hot_info,
+                                  std::string_view name,
+                                  const celestial_body_spec& specifics)
+{
+    begin_record(journal_operation::add_body,handle);
+    put_value(buffer,hot_info.body_position.x,sizeof(uint32_t));
+    put_value(buffer,hot_info.body_position.y,sizeof(uint32_t));
+    put_value(buffer,uint8_t(hot_info.body_type),sizeof(uint8_t));
+    put_value(buffer,specifics.diameter,sizeof(uint32_t));
+    put_value(buffer,name.size(),sizeof(uint32_t));
+    buffer.insert(buffer.end(),name.begin(),name.end());
+}
+
+void universe_journal::record_move(const body_handle& handle,
+                                   const object_coordinates& new_position)
+{
+    begin_record(journal_operation::move_body,handle);
+    put_value(buffer,new_position.x,sizeof(uint32_t));
+    put_value(buffer,new_position.y,sizeof(uint32_t));
+}
+
+void universe_journal::record_remove(const body_handle& handle)
+{
+    begin_record(journal_operation::remove_body,handle);
+}
+
+void universe_journal::record_update(const body_handle& handle,
+                                     const celestial_body_spec& specifics)
+{
+    begin_record(journal_operation::update_specifics,handle);
+    put_value(buffer,specifics.diameter,sizeof(uint32_t));
+}
+
+std::size_t universe_journal::get_buffered_bytes() const
+{
+    return buffer.size();
+}
+
+uint64_t universe_journal::get_records_count() const
+{
+    return records;
+}
+
+void universe_journal::flush()
+{
+    if(buffer.empty())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(writer->writer_mtx);
+        writer->queued.push_back(std::move(buffer));
+    }
+    buffer.clear();
+    if(!workers || workers->size() == 0){
+        writer->write_queued();
+        return;
+    }
+    //The disk write never holds up a thread waiting in parallel_for
+    auto journal_writer = writer;
+    workers->submit_background([journal_writer](){
+        journal_writer->write_queued();
+    });
+}
+
+bool universe_journal::wait()
+{
+    std::unique_lock<std::mutex> lock(writer->writer_mtx);
+    writer->writes_done.wait(lock,[this](){
+        return writer->queued.empty() && !writer->writing;
+    });
+    if(writer->failed){
+        WARN1("Unable to write the journal ",file_name.c_str());
+    }
+    return !writer->failed;
+}
+
+/*
+ * The journal restarts only once the snapshot is
+ * written, if the snapshot fails the records are kept
+ */
+bool universe_journal::compact(const universe_map& star_chart,
+                               const std::string& snapshot_file)
+{
+    flush();
+    if(!wait() || !star_chart.save_snapshot(snapshot_file))
+        return false;
+    LOG3("Compacted ",records," journal records in ",snapshot_file.c_str());
+    std::vector<char> header = journal_header();
+    std::lock_guard<std::mutex> lock(writer->writer_mtx);
+    writer->out.close();
+    writer->out.clear();
+    writer->out.open(file_name,std::ios::binary | std::ios::trunc);
+    writer->out.write(header.data(),header.size());
+    writer->out.flush();
+    writer->failed = !writer->out;
+    records = 0;
+    return !writer->failed;
+}
+
+/*
+ * The journal of the map itself, if any, is detached
+ * during the replay: the records are already on file.
+ */
+uint64_t universe_journal::replay(const std::string& journal_file,
+                                  universe_map& star_chart)
+{
+    std::ifstream in(journal_file,std::ios::binary);
+    std::vector<char> data{std::istreambuf_iterator<char>(in),
+                           std::istreambuf_iterator<char>()};
+    std::vector<char> header = journal_header();
+    if(data.size() < journal_header_size ||
+       !std::equal(header.begin(),header.end(),data.begin())){
+        WARN1("Unable to replay the journal ",journal_file.c_str());
+        return 0;
+    }
+    auto attached_journal = star_chart.get_journal();
+    star_chart.set_journal(nullptr);
+    record_reader reader(data,journal_header_size);
+    uint64_t applied{0};
+    while(!reader.at_end()){
+        uint64_t operation,body_id,x,y,type,diameter,name_length;
+        std::string name;
+        if(!reader.get(operation,sizeof(uint8_t)) ||
+           !reader.get(body_id,sizeof(uint64_t)))
+            break;
+        body_handle handle = body_handle::from_id(body_id);
+        bool applied_record{false};
+        switch(journal_operation(operation)){
+        case journal_operation::add_body:
+            if(reader.get(x,sizeof(uint32_t)) && reader.get(y,sizeof(uint32_t)) &&
+               reader.get(type,sizeof(uint8_t)) && reader.get(diameter,sizeof(uint32_t)) &&
+               reader.get(name_length,sizeof(uint32_t)) && reader.get(name,name_length)){
+                celestial_body_spec specifics;
+                specifics.diameter = diameter;
+                body_handle added = star_chart.add_celestial_body(
+                            celestial_body(name,specifics,object_coordinates(x,y),
+                                           celestial_body_types(type)));
+                applied_record = added == handle;
+                //The replay stops here, the map shall not keep a body the journal never had
+                if(!applied_record && !added.is_null()){
+                    star_chart.remove_celestial_body(added);
+                }
+            }
+            break;
+        case journal_operation::move_body:
+            if(reader.get(x,sizeof(uint32_t)) && reader.get(y,sizeof(uint32_t))){
+                applied_record = star_chart.move_celestial_body(handle,object_coordinates(x,y));
+            }
+            break;
+        case journal_operation::remove_body:
+            applied_record = star_chart.remove_celestial_body(handle);
+            break;
+        case journal_operation::update_specifics:
+            if(reader.get(diameter,sizeof(uint32_t))){
+                celestial_body_spec specifics;
+                specifics.diameter = diameter;
+                applied_record = star_chart.update_body_specifics(handle,specifics);
+            }
+            break;
+        }
+        if(!applied_record){
+            WARN1("The journal ",journal_file.c_str()," does not match the map after ",
+                  applied," records");
+            break;
+        }
+        ++applied;
+    }
+    star_chart.set_journal(attached_journal);
+    LOG3("Replayed ",applied," journal records");
+    return applied;
+}
+
+}
@@ -0,0 +1,117 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include "objects.hpp"
+#include "slot_map.hpp"
+#include "../workers/workers.hpp"
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <condition_variable>
+
+namespace game_maps
+{
+
+using namespace objects;
+
+class universe_map;
+
+//"UGJRNLv1" read as a little endian 64 bit integer
+static const uint64_t journal_magic = 0x3176'4c4e'524a'4755ULL;
+static const uint32_t journal_version = 1;
+
+enum class journal_operation : uint8_t
+{
+    add_body = 1,
+    move_body,
+    remove_body,
+    update_specifics
+};
+
+/*
+ * Append only log of the changes of a universe map since
+ * its last snapshot. The map records each change in a
+ * memory buffer, flush() hands the buffer to a worker which
+ * appends it to the file: an autosave costs as much as the
+ * changes since the previous one, whatever the universe size.
+ *
+ * Each record is the operation, the id of the body handle
+ * and the data of the operation, little endian. Replaying
+ * the records on the snapshot they follow gives back the
+ * same bodies with the same handles, since the slot map is
+ * part of the snapshot. A record cut by a crash is dropped.
+ */
+class universe_journal
+{
+    //Shared with the write jobs, which may outlive the journal
+    struct journal_writer
+    {
+        std::mutex                     writer_mtx;
+        std::condition_variable        writes_done;
+        std::ofstream                  out;
+        std::deque<std::vector<char>>  queued;
+        //A single job writes at a time, the others leave it the queue
+        bool                           writing{false},
+                                       failed{false};
+
+        void write_queued();
+    };
+
+    std::string                      file_name;
+    std::vector<char>                buffer;
+    uint64_t                         records;
+    game_workers::worker_pool_ptr    workers;
+    std::shared_ptr<journal_writer>  writer;
+
+    void begin_record(journal_operation operation,
+                      const body_handle& handle);
+public:
+    universe_journal();
+    universe_journal(const universe_journal&) = delete;
+    universe_journal& operator=(const universe_journal&) = delete;
+    ~universe_journal();
+
+    //Append to the journal file, or start it if missing
+    bool open(const std::string& journal_file);
+    void set_worker_pool(game_workers::worker_pool_ptr worker_pool);
+
+    void record_add(const body_handle& handle,
+                    const object_hot_info& hot_info,
+                    std::string_view name,
+                    const celestial_body_spec& specifics);
+    void record_move(const body_handle& handle,
+                     const object_coordinates& new_position);
+    void record_remove(const body_handle& handle);
+    void record_update(const body_handle& handle,
+                       const celestial_body_spec& specifics);
+
+    //Records not yet handed to the writer
+    std::size_t get_buffered_bytes() const;
+    uint64_t get_records_count() const;
+
+    //Never waits for the disk, the buffer is written in background
+    void flush();
+    //Wait for the flushed records to be on the file
+    bool wait();
+    /*
+     * Save the map in a new snapshot and restart the journal
+     * from empty, the map shall be the one being journaled.
+     */
+    bool compact(const universe_map& star_chart,
+                 const std::string& snapshot_file);
+
+    /*
+     * Apply the records of a journal to the map loaded from
+     * the snapshot the journal follows, return the amount of
+     * records applied. The replay stops at the first record
+     * which does not match the map.
+     */
+    static uint64_t replay(const std::string& journal_file,
+                           universe_map& star_chart);
+};
+
+}
+
+#endif
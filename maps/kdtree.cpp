@@ -0,0 +1,159 @@
+#include "../logger/logger.hpp"
+#include "kdtree.hpp"
+#include <algorithm>
+
+namespace game_maps
+{
+
+namespace
+{
+
+template<typename ENTRY>
+uint32_t axis_coordinate(const ENTRY& entry,uint32_t depth)
+{
+    return depth % 2 ? entry.y : entry.x;
+}
+
+template<typename ENTRY>
+double squared_distance(const ENTRY& entry,
+                        const object_coordinates& point)
+{
+    double dx = double(entry.x) - point.x,
+           dy = double(entry.y) - point.y;
+    return dx * dx + dy * dy;
+}
+
+}
+
+void kd_tree::rebuild(const body_storage& bodies)
+{
+    entries.resize(bodies.size());
+    for(uint32_t body_index{0};body_index < bodies.size();++body_index){
+        auto position = bodies.position(body_index);
+        entries[body_index] = {position.x,position.y,body_index,
+                               bodies.body_type(body_index)};
+    }
+    build(0,entries.size(),0);
+    LOG1("kd-tree rebuilt with ",entries.size()," bodies");
+}
+
+void kd_tree::clear()
+{
+    entries.clear();
+}
+
+std::size_t kd_tree::size() const
+{
+    return entries.size();
+}
+
+/*
+ * Place the median of the range in the middle, with the
+ * smaller entries on its left and the bigger on its right
+ */
+void kd_tree::build(std::size_t from,std::size_t to,uint32_t depth)
+{
+    if(to - from <= 1)
+        return;
+    std::size_t middle = from + (to - from) / 2;
+    std::nth_element(entries.begin() + from,
+                     entries.begin() + middle,
+                     entries.begin() + to,
+                     [depth](const kd_entry& first,const kd_entry& second){
+        return axis_coordinate(first,depth) < axis_coordinate(second,depth);
+    });
+    build(from,middle,depth + 1);
+    build(middle + 1,to,depth + 1);
+}
+
+/*
+ * The heap keeps the best k candidates with the farthest
+ * on top, the far side of a split is visited only if
+ * it may contain something closer than that.
+ */
+void kd_tree::nearest(std::size_t from,std::size_t to,uint32_t depth,
+                      const object_coordinates& point,
+                      std::size_t k,
+                      celestial_body_types type,
+                      std::vector<kd_candidate>& heap) const
+{
+    if(from >= to)
+        return;
+    std::size_t middle = from + (to - from) / 2;
+    const auto& entry = entries[middle];
+    if(type == celestial_body_types::celestial_body_none ||
+       type == entry.body_type){
+        double distance = squared_distance(entry,point);
+        if(heap.size() < k){
+            heap.push_back({distance,entry.body_index});
+            std::push_heap(heap.begin(),heap.end());
+        }else if(distance < heap.front().distance){
+            std::pop_heap(heap.begin(),heap.end());
+            heap.back() = {distance,entry.body_index};
+            std::push_heap(heap.begin(),heap.end());
+        }
+    }
+    double split_distance = double(axis_coordinate(point,depth)) -
+                            axis_coordinate(entry,depth);
+    if(split_distance < 0){
+        nearest(from,middle,depth + 1,point,k,type,heap);
+    }else{
+        nearest(middle + 1,to,depth + 1,point,k,type,heap);
+    }
+    if(heap.size() < k ||
+       split_distance * split_distance < heap.front().distance){
+        if(split_distance < 0){
+            nearest(middle + 1,to,depth + 1,point,k,type,heap);
+        }else{
+            nearest(from,middle,depth + 1,point,k,type,heap);
+        }
+    }
+}
+
+void kd_tree::nearest(const object_coordinates& point,
+                      std::size_t k,
+                      std::vector<uint32_t>& found_bodies,
+                      celestial_body_types type) const
+{
+    if(k == 0)
+        return;
+    std::vector<kd_candidate> heap;
+    heap.reserve(std::min(k,entries.size()));
+    nearest(0,entries.size(),0,point,k,type,heap);
+    std::sort_heap(heap.begin(),heap.end());
+    for(const auto& candidate : heap){
+        found_bodies.push_back(candidate.body_index);
+    }
+}
+
+void kd_tree::within_radius(std::size_t from,std::size_t to,uint32_t depth,
+                            const object_coordinates& point,
+                            double squared_radius,
+                            body_visitor& visitor) const
+{
+    if(from >= to)
+        return;
+    std::size_t middle = from + (to - from) / 2;
+    const auto& entry = entries[middle];
+    if(squared_distance(entry,point) <= squared_radius){
+        visitor(entry.body_index);
+    }
+    double split_distance = double(axis_coordinate(point,depth)) -
+                            axis_coordinate(entry,depth);
+    if(split_distance <= 0 || split_distance * split_distance <= squared_radius){
+        within_radius(from,middle,depth + 1,point,squared_radius,visitor);
+    }
+    if(split_distance >= 0 || split_distance * split_distance <= squared_radius){
+        within_radius(middle + 1,to,depth + 1,point,squared_radius,visitor);
+    }
+}
+
+void kd_tree::within_radius(const object_coordinates& point,
+                            uint32_t radius,
+                            body_visitor visitor) const
+{
+    within_radius(0,entries.size(),0,point,
+                  double(radius) * radius,visitor);
+}
+
+}
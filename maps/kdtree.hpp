@@ -0,0 +1,70 @@
+#ifndef KDTREE_HPP
+#define KDTREE_HPP
+
+#include "spatial_index.hpp"
+#include "bodies.hpp"
+
+namespace game_maps
+{
+
+using namespace coordinates;
+using namespace objects;
+
+/*
+ * Static 2d tree of the body positions, it is built in bulk
+ * from the body storage and shall be rebuilt after any change.
+ * The tree is implicit: the node of each range of entries is
+ * its median, the split axis alternates at each level.
+ */
+class kd_tree
+{
+    struct kd_entry
+    {
+        uint32_t             x,
+                             y,
+                             body_index;
+        celestial_body_types body_type;
+    };
+
+    struct kd_candidate
+    {
+        double   distance;
+        uint32_t body_index;
+        bool operator<(const kd_candidate& other) const{
+            return distance < other.distance;
+        }
+    };
+
+    std::vector<kd_entry> entries;
+
+    void build(std::size_t from,std::size_t to,uint32_t depth);
+    void nearest(std::size_t from,std::size_t to,uint32_t depth,
+                 const object_coordinates& point,
+                 std::size_t k,
+                 celestial_body_types type,
+                 std::vector<kd_candidate>& heap) const;
+    void within_radius(std::size_t from,std::size_t to,uint32_t depth,
+                       const object_coordinates& point,
+                       double squared_radius,
+                       body_visitor& visitor) const;
+public:
+    void rebuild(const body_storage& bodies);
+    void clear();
+    std::size_t size() const;
+
+    /*
+     * Index of the k bodies closest to the point ordered by
+     * distance, celestial_body_none accepts any body type.
+     */
+    void nearest(const object_coordinates& point,
+                 std::size_t k,
+                 std::vector<uint32_t>& found_bodies,
+                 celestial_body_types type = celestial_body_types::celestial_body_none) const;
+    void within_radius(const object_coordinates& point,
+                       uint32_t radius,
+                       body_visitor visitor) const;
+};
+
+}
+
+#endif
@@ -1,12 +1,151 @@
 #include "../logger/logger.hpp"
 #include "maps.hpp"
+#include <algorithm>
 
 namespace game_maps
 {
 
-universe_map::universe_map()
+namespace
+{
+
+//Amount of positions filtered at once by the full scan
+const std::size_t scan_block_size = 256;
+//The storage is sorted again when this share of the bodies is out of Z-order
+const uint32_t morton_disorder_ratio = 8;
+
+}
+
+universe_map::universe_map() :
+    unordered_bodies{0}
 {
     LOG3("Creating the universe map");
+    rebuild_index();
+}
+
+/*
+ * Read from the game configuration the
+ * settings related to the universe map
+ */
+void universe_map::configure(game_configuration::game_config_ptr game_conf)
+{
+    std::string index_type = game_conf->get_option("universe_spatial_index");
+    if(index_type == "grid"){
+        universe_specification.index_type = spatial_index_type::uniform_grid;
+    }else if(index_type == "quadtree"){
+        universe_specification.index_type = spatial_index_type::loose_quadtree;
+    }else if(index_type == "morton"){
+        universe_specification.index_type = spatial_index_type::morton_order;
+    }else if(!index_type.empty()){
+        WARN2("Unknown spatial index type: ",index_type.c_str());
+    }
+    std::string node_capacity = game_conf->get_option("universe_quadtree_node_capacity");
+    if(!node_capacity.empty()){
+        universe_specification.quadtree_node_capacity = std::stoul(node_capacity);
+    }
+    std::string cell_size = game_conf->get_option("universe_grid_cell_size");
+    if(!cell_size.empty()){
+        universe_specification.grid_cell_size = std::stoul(cell_size);
+    }
+    std::string width = game_conf->get_option("universe_width"),
+                height = game_conf->get_option("universe_height");
+    if(!width.empty() && !height.empty()){
+        universe_specification.universe_width = std::stoul(width);
+        universe_specification.universe_height = std::stoul(height);
+    }
+    rebuild_index();
+}
+
+/*
+ * Create a new spatial index according to the
+ * universe specification and fill it with the
+ * bodies already in the map.
+ */
+void universe_map::rebuild_index()
+{
+    if(universe_specification.index_type == spatial_index_type::uniform_grid){
+        bodies_index = std::make_unique<uniform_grid>(universe_specification.universe_width,
+                                                      universe_specification.universe_height,
+                                                      universe_specification.grid_cell_size);
+    }else if(universe_specification.index_type == spatial_index_type::morton_order){
+        bodies_index = std::make_unique<morton_index>();
+    }else{
+        bodies_index = std::make_unique<loose_quadtree>(universe_specification.universe_width,
+                                                        universe_specification.universe_height,
+                                                        universe_specification.quadtree_node_capacity);
+    }
+    bodies_index->build(celestial_bodies.x_data(),
+                        celestial_bodies.y_data(),
+                        celestial_bodies.size(),
+                        workers.get());
+}
+
+/*
+ * Few new bodies are inserted one by one, when they are
+ * a considerable part of the map the index is rebuilt.
+ */
+void universe_map::index_new_bodies(uint32_t first_new_body)
+{
+    uint32_t new_bodies = celestial_bodies.size() - first_new_body;
+    LOG3("Indexing ",new_bodies," new bodies");
+    if(new_bodies >= first_new_body / 8){
+        //The index is rebuilt by the sort
+        sort_bodies_by_morton_code();
+        return;
+    }
+    for(uint32_t body_index{first_new_body};body_index < celestial_bodies.size();++body_index){
+        bodies_index->insert(body_index,celestial_bodies.position(body_index));
+    }
+    nearest_index_status.stale = true;
+    unordered_bodies += new_bodies;
+    keep_morton_order();
+}
+
+/*
+ * The bodies appended or swapped in place of a removed one are
+ * out of Z-order, when they are too many the storage is sorted
+ * again. The moves are not counted, they are mostly short.
+ */
+void universe_map::keep_morton_order()
+{
+    if(unordered_bodies > celestial_bodies.size() / morton_disorder_ratio){
+        sort_bodies_by_morton_code();
+    }
+}
+
+bool universe_map::within_universe(const object_coordinates& position) const
+{
+    return position.x < universe_specification.universe_width &&
+           position.y < universe_specification.universe_height;
+}
+
+bool universe_map::prefer_full_scan(const object_area& area) const
+{
+    if(area.x_from > area.x_to || area.y_from > area.y_to)
+        return false;
+    double universe_area = double(universe_specification.universe_width) *
+                           universe_specification.universe_height;
+    double query_area = (double(area.x_to) - area.x_from + 1) *
+                        (double(area.y_to) - area.y_from + 1);
+    return query_area >= universe_area * full_scan_area_ratio;
+}
+
+/*
+ * The workers are used for the bulk operations,
+ * without them everything runs on the calling thread
+ */
+void universe_map::set_worker_pool(game_workers::worker_pool_ptr worker_pool)
+{
+    workers = worker_pool;
+}
+
+void universe_map::set_journal(std::shared_ptr<universe_journal> universe_changes)
+{
+    journal = universe_changes;
+}
+
+std::shared_ptr<universe_journal> universe_map::get_journal() const
+{
+    return journal;
 }
 
 void universe_map::set_universe_size(uint32_t width,
@@ -17,37 +156,600 @@ void universe_map::set_universe_size(uint32_t width,
 
     universe_specification.universe_height = height;
     universe_specification.universe_width = width;
+    rebuild_index();
+}
+
+void universe_map::set_grid_cell_size(uint32_t cell_size)
+{
+    LOG3("Setting the universe grid cell size to ",cell_size);
+
+    universe_specification.grid_cell_size = cell_size;
+    rebuild_index();
+}
+
+void universe_map::set_spatial_index(spatial_index_type index_type)
+{
+    universe_specification.index_type = index_type;
+    rebuild_index();
+}
+
+/*
+ * Reorder the storage following the Z-order curve, bodies
+ * close in the universe become close in memory and the
+ * queries read the storage almost sequentially.
+ * All the body indexes change. The map sorts itself on bulk
+ * loads and when too many bodies are out of order.
+ */
+void universe_map::sort_bodies_by_morton_code()
+{
+    LOG3("Sorting ",celestial_bodies.size()," bodies by morton code");
+    std::vector<std::pair<morton_code,uint32_t>> codes(celestial_bodies.size());
+    for(uint32_t body_index{0};body_index < celestial_bodies.size();++body_index){
+        codes[body_index] = {morton_encode(celestial_bodies.position(body_index)),
+                             body_index};
+    }
+    std::sort(codes.begin(),codes.end());
+    std::vector<uint32_t> order(codes.size());
+    for(std::size_t idx{0};idx < codes.size();++idx){
+        order[idx] = codes[idx].second;
+    }
+    celestial_bodies.reorder(order);
+    for(uint32_t body_index{0};body_index < celestial_bodies.size();++body_index){
+        body_slots.relocate(celestial_bodies.handle_of(body_index),body_index);
+    }
+    rebuild_index();
+    nearest_index_status.stale = true;
+    unordered_bodies = 0;
+}
+
+bool universe_map::save_snapshot(const std::string& file_name) const
+{
+    return universe_snapshot::write(file_name,celestial_bodies,body_slots,
+                                    universe_specification.universe_width,
+                                    universe_specification.universe_height);
+}
+
+/*
+ * Replace the content of the map with the bodies of the
+ * snapshot, the handles saved with the bodies stay valid.
+ * The positions are copied as they are, only the names
+ * need to be interned: once for each distinct name.
+ */
+bool universe_map::load_snapshot(const universe_snapshot& snapshot)
+{
+    if(!snapshot.is_open()){
+        WARN1("Unable to load the universe, the snapshot is not open");
+        return false;
+    }
+    LOG3("Loading ",snapshot.get_bodies_count()," bodies from the snapshot");
+    std::vector<name_id> names(snapshot.get_names_count());
+    for(uint32_t name_index{0};name_index < names.size();++name_index){
+        names[name_index] = name_pool::shared().intern(snapshot.get_name(name_index));
+    }
+    std::vector<object_cold_info> cold(snapshot.get_bodies_count());
+    for(uint32_t body_index{0};body_index < cold.size();++body_index){
+        uint32_t name_index = snapshot.get_body_name_index(body_index);
+        cold[body_index].body_name = name_index < names.size() ? names[name_index] : empty_name;
+        cold[body_index].body_specifics.diameter = snapshot.get_body_diameter(body_index);
+    }
+    celestial_bodies.assign(snapshot.x_data(),snapshot.y_data(),snapshot.type_data(),
+                            snapshot.handle_data(),std::move(cold));
+    body_slots.assign(snapshot.slot_data(),snapshot.get_slots_count(),
+                      snapshot.get_first_free_slot());
+    universe_specification.universe_width = snapshot.get_universe_width();
+    universe_specification.universe_height = snapshot.get_universe_height();
+    rebuild_index();
+    nearest_index_status.stale = true;
+    //The snapshots are written from maps kept in Z-order
+    unordered_bodies = 0;
+    return true;
+}
+
+/*
+ * Assign a slot to the body and copy it in the
+ * storage, the index is not updated.
+ */
+uint32_t universe_map::store_body(const celestial_body& new_body)
+{
+    body_handle handle = body_slots.allocate(celestial_bodies.size());
+    if(journal){
+        journal->record_add(handle,new_body.get_hot_info(),
+                            new_body.get_body_name(),new_body.get_body_specifics());
+    }
+    return celestial_bodies.add(handle,new_body);
+}
+
+/*
+ * The body data are copied in the map storage,
+ * the body object itself is not referenced anymore.
+ * Return the null handle if the body is outside
+ * the universe.
+ */
+body_handle universe_map::add_celestial_body(const celestial_body& new_body)
+{
+    const auto& body_position = new_body.get_body_coordinates();
+    if(!within_universe(body_position))
+        return body_handle();
+    uint32_t body_index = store_body(new_body);
+    bodies_index->insert(body_index,body_position);
+    nearest_index_status.stale = true;
+    body_handle handle = celestial_bodies.handle_of(body_index);
+    ++unordered_bodies;
+    keep_morton_order();
+    return handle;
+}
+
+body_handle universe_map::add_celestial_body(celestial_body_ptr new_body)
+{
+    return add_celestial_body(*new_body);
+}
+
+/*
+ * The last body is moved in the place of the
+ * removed one to keep the storage compact,
+ * its slot follows it.
+ */
+bool universe_map::remove_celestial_body(uint32_t body_index)
+{
+    if(body_index >= celestial_bodies.size()){
+        WARN1("Unable to remove the body ",body_index,", no such body");
+        return false;
+    }
+    uint32_t last_index = celestial_bodies.size() - 1;
+    bodies_index->erase(body_index,
+                        celestial_bodies.position(body_index));
+    if(body_index != last_index){
+        auto last_position = celestial_bodies.position(last_index);
+        bodies_index->erase(last_index,last_position);
+        bodies_index->insert(body_index,last_position);
+    }
+    if(journal){
+        journal->record_remove(celestial_bodies.handle_of(body_index));
+    }
+    body_slots.release(celestial_bodies.handle_of(body_index));
+    celestial_bodies.remove(body_index);
+    if(body_index != last_index){
+        body_slots.relocate(celestial_bodies.handle_of(body_index),body_index);
+        ++unordered_bodies;
+        keep_morton_order();
+    }
+    nearest_index_status.stale = true;
+    return true;
+}
+
+bool universe_map::remove_celestial_body(const body_handle& handle)
+{
+    uint32_t body_index = body_slots.find(handle);
+    if(body_index == no_body){
+        WARN1("Unable to remove the body ",handle.id(),", stale handle");
+        return false;
+    }
+    return remove_celestial_body(body_index);
+}
+
+bool universe_map::move_celestial_body(uint32_t body_index,
+                                       const object_coordinates& new_position)
+{
+    if(body_index >= celestial_bodies.size() ||
+       !within_universe(new_position)){
+        WARN1("Unable to move the body ",body_index," to ",
+              new_position.x,",",new_position.y);
+        return false;
+    }
+    bodies_index->relocate(body_index,
+                           celestial_bodies.position(body_index),
+                           new_position);
+    celestial_bodies.set_position(body_index,new_position);
+    if(journal){
+        journal->record_move(celestial_bodies.handle_of(body_index),new_position);
+    }
+    nearest_index_status.stale = true;
+    return true;
+}
+
+bool universe_map::move_celestial_body(const body_handle& handle,
+                                       const object_coordinates& new_position)
+{
+    uint32_t body_index = body_slots.find(handle);
+    if(body_index == no_body){
+        WARN1("Unable to move the body ",handle.id(),", stale handle");
+        return false;
+    }
+    return move_celestial_body(body_index,new_position);
+}
+
+/*
+ * Move many bodies at once, the stale handles and the positions
+ * outside the universe are skipped. When a considerable part of
+ * the map moves the index is rebuilt instead of updated body by
+ * body. Return the amount of bodies moved.
+ */
+uint32_t universe_map::move_celestial_bodies(const std::vector<body_handle>& handles,
+                                             const std::vector<object_coordinates>& new_positions)
+{
+    bool rebuild = handles.size() >= celestial_bodies.size() / 8;
+    uint32_t moved{0};
+    for(std::size_t body{0};body < handles.size() && body < new_positions.size();++body){
+        uint32_t body_index = body_slots.find(handles[body]);
+        const auto& new_position = new_positions[body];
+        if(body_index == no_body || !within_universe(new_position))
+            continue;
+        auto old_position = celestial_bodies.position(body_index);
+        if(old_position.x == new_position.x && old_position.y == new_position.y)
+            continue;
+        if(!rebuild){
+            bodies_index->relocate(body_index,old_position,new_position);
+        }
+        celestial_bodies.set_position(body_index,new_position);
+        if(journal){
+            journal->record_move(handles[body],new_position);
+        }
+        ++moved;
+    }
+    if(moved > 0){
+        if(rebuild){
+            bodies_index->build(celestial_bodies.x_data(),
+                                celestial_bodies.y_data(),
+                                celestial_bodies.size(),
+                                workers.get());
+        }
+        nearest_index_status.stale = true;
+    }
+    return moved;
 }
 
-uint32_t universe_map::add_celestial_body(celestial_body_ptr new_body)
+//The specifics are cold data, the indexes are not involved
+bool universe_map::update_body_specifics(const body_handle& handle,
+                                         const celestial_body_spec& specifics)
 {
-    auto body_position = new_body->get_body_coordinates();
-    if(body_position.x < universe_specification.universe_width &&
-       body_position.y < universe_specification.universe_height)
-    {
-        celestial_bodies.push_back(new_body);
+    uint32_t body_index = body_slots.find(handle);
+    if(body_index == no_body){
+        WARN1("Unable to update the body ",handle.id(),", stale handle");
+        return false;
     }
+    celestial_bodies.set_specifics(body_index,specifics);
+    if(journal){
+        journal->record_update(handle,specifics);
+    }
+    return true;
+}
+
+uint32_t universe_map::get_universe_width() const
+{
+    return universe_specification.universe_width;
+}
+
+uint32_t universe_map::get_universe_height() const
+{
+    return universe_specification.universe_height;
+}
+
+uint32_t universe_map::get_bodies_count() const
+{
     return celestial_bodies.size();
 }
 
-std::vector<celestial_body_cptr> universe_map::find_bodies_within(uint32_t top_left_y,
+celestial_body_view universe_map::get_body(uint32_t body_index) const
+{
+    return celestial_body_view(celestial_bodies,body_index);
+}
+
+bool universe_map::contains_body(const body_handle& handle) const
+{
+    return body_slots.contains(handle);
+}
+
+/*
+ * O(1) translation of the handle to the current
+ * index of the body, no_body if the handle is stale
+ */
+uint32_t universe_map::find_body(const body_handle& handle) const
+{
+    return body_slots.find(handle);
+}
+
+std::vector<celestial_body_view> universe_map::find_bodies_within(uint32_t top_left_y,
                                                                   uint32_t top_left_x,
                                                                   uint32_t bottom_right_x,
-                                                                  uint32_t bottom_right_y)
+                                                                  uint32_t bottom_right_y) const
+{
+    return find_bodies_within(object_area(top_left_x,bottom_right_x,
+                                          top_left_y,bottom_right_y));
+}
+
+/*
+ * For small areas the spatial index provides the index of
+ * the bodies within the area, only those bodies are touched.
+ * Big areas are served by the vectorized scan of the positions,
+ * one block at time so that no buffer has to be allocated.
+ */
+void universe_map::visit_bodies_within(const object_area& area,
+                                       body_visitor visitor) const
+{
+    if(!prefer_full_scan(area)){
+        bodies_index->query(area,visitor);
+        return;
+    }
+    scan_bodies_within(area,0,celestial_bodies.size(),visitor);
+}
+
+/*
+ * The small areas are queried one by one in Z-order of their
+ * centre, the nodes and cells shared by close areas are still
+ * in the cache for the next query. The big areas share a single
+ * scan of the positions, each block is filtered for all of them
+ * while it is in the cache.
+ */
+void universe_map::visit_bodies_within(const std::vector<object_area>& areas,
+                                       area_body_visitor visitor) const
 {
-    std::vector<celestial_body_cptr> bodies;
-    for(auto element:celestial_bodies)
-    {
-        auto body_coord = element->get_body_coordinates();
-        if(body_coord.x>=top_left_x && body_coord.x<=bottom_right_x &&
-           body_coord.y>=top_left_y && body_coord.y<=bottom_right_y)
-        {
-            bodies.push_back(element);
+    std::vector<uint32_t> scan_areas;
+    std::vector<std::pair<morton_code,uint32_t>> index_areas;
+    index_areas.reserve(areas.size());
+    for(uint32_t area_index{0};area_index < areas.size();++area_index){
+        const auto& area = areas[area_index];
+        if(prefer_full_scan(area)){
+            scan_areas.push_back(area_index);
+        }else if(area.x_from <= area.x_to && area.y_from <= area.y_to){
+            object_coordinates center(area.x_from + (area.x_to - area.x_from) / 2,
+                                      area.y_from + (area.y_to - area.y_from) / 2);
+            index_areas.emplace_back(morton_encode(center),area_index);
         }
     }
+    std::sort(index_areas.begin(),index_areas.end());
+    for(const auto& index_area : index_areas){
+        uint32_t area_index = index_area.second;
+        auto visit = [&visitor,area_index](uint32_t body_index){
+            visitor(area_index,body_index);
+        };
+        bodies_index->query(areas[area_index],body_visitor(visit));
+    }
+    if(scan_areas.empty())
+        return;
+    uint32_t found_indexes[scan_block_size];
+    for(std::size_t first{0};first < celestial_bodies.size();first += scan_block_size){
+        std::size_t count = std::min<std::size_t>(scan_block_size,
+                                                  celestial_bodies.size() - first);
+        for(auto area_index : scan_areas){
+            std::size_t found = filter_within_area(celestial_bodies.x_data() + first,
+                                                   celestial_bodies.y_data() + first,
+                                                   count,areas[area_index],first,
+                                                   found_indexes);
+            for(std::size_t i{0};i<found;i++){
+                visitor(area_index,found_indexes[i]);
+            }
+        }
+    }
+}
+
+/*
+ * Vectorized scan of the positions of the bodies
+ * from first_body to last_body (excluded)
+ */
+void universe_map::scan_bodies_within(const object_area& area,
+                                      std::size_t first_body,
+                                      std::size_t last_body,
+                                      body_visitor visitor) const
+{
+    uint32_t found_indexes[scan_block_size];
+    for(std::size_t first{first_body};first < last_body;first += scan_block_size){
+        std::size_t count = std::min<std::size_t>(scan_block_size,
+                                                  last_body - first);
+        std::size_t found = filter_within_area(celestial_bodies.x_data() + first,
+                                               celestial_bodies.y_data() + first,
+                                               count,area,first,
+                                               found_indexes);
+        for(std::size_t i{0};i<found;i++){
+            visitor(found_indexes[i]);
+        }
+    }
+}
+
+std::vector<celestial_body_view> universe_map::find_bodies_within(const object_area& area) const
+{
+    std::vector<celestial_body_view> bodies;
+    for_each_body_within(area,[&bodies](const celestial_body_view& body){
+        bodies.push_back(body);
+    });
     return bodies;
 }
 
+/*
+ * Write in found_indexes the index of the bodies within
+ * the area, up to 'capacity' bodies. Return the total amount
+ * of bodies within the area, which may exceed the capacity.
+ */
+std::size_t universe_map::find_bodies_within(const object_area& area,
+                                             uint32_t* found_indexes,
+                                             std::size_t capacity) const
+{
+    std::size_t found{0};
+    auto collect = [&found,found_indexes,capacity](uint32_t body_index){
+        if(found < capacity){
+            found_indexes[found] = body_index;
+        }
+        ++found;
+    };
+    visit_bodies_within(area,body_visitor(collect));
+    return found;
+}
+
+std::vector<std::vector<celestial_body_view>> universe_map::find_bodies_within(const std::vector<object_area>& areas) const
+{
+    std::vector<std::vector<celestial_body_view>> bodies(areas.size());
+    for_each_body_within(areas,[&bodies](uint32_t area_index,const celestial_body_view& body){
+        bodies[area_index].push_back(body);
+    });
+    return bodies;
 }
 
+/*
+ * The visible bit of each body within the area is tested while
+ * the spatial index is walked. The sets of many players can be
+ * combined before the query with the word operations of the
+ * body_bitset, i.e. the vision shared by an alliance.
+ */
+std::vector<celestial_body_view> universe_map::find_bodies_within(const object_area& area,
+                                                                  const body_bitset& visible) const
+{
+    std::vector<celestial_body_view> bodies;
+    const uint64_t* visible_words = visible.data();
+    std::size_t words_count = visible.get_words_count();
+    auto collect = [this,&bodies,visible_words,words_count](uint32_t body_index){
+        uint32_t slot = celestial_bodies.handle_of(body_index).slot,
+                 word = slot / body_bitset::word_bits;
+        if(word < words_count && ((visible_words[word] >> (slot % body_bitset::word_bits)) & 1)){
+            bodies.emplace_back(celestial_bodies,body_index);
+        }
+    };
+    visit_bodies_within(area,body_visitor(collect));
+    return bodies;
+}
+
+/*
+ * Split the query in tiles scanned by the worker pool. Big areas
+ * are scanned splitting the storage in ranges of bodies, whose
+ * results are already ordered by body index. Small areas are
+ * split in horizontal strips, each served by the spatial index.
+ * The tile results are then copied in place in parallel.
+ */
+std::vector<celestial_body_view> universe_map::find_bodies_within_parallel(const object_area& area,
+                                                                           query_order order) const
+{
+    if(!workers || area.x_from > area.x_to || area.y_from > area.y_to){
+        auto bodies = find_bodies_within(area);
+        if(order == query_order::by_body_index && !prefer_full_scan(area)){
+            std::sort(bodies.begin(),bodies.end(),[](const celestial_body_view& first,
+                                                     const celestial_body_view& second){
+                return first.get_body_index() < second.get_body_index();
+            });
+        }
+        return bodies;
+    }
+    bool full_scan = prefer_full_scan(area);
+    uint64_t area_height = uint64_t(area.y_to) - area.y_from + 1,
+             tile_units = full_scan ? celestial_bodies.size() : area_height,
+             tile_count = std::min<uint64_t>(tile_units,
+                                             (workers->size() + 1) * parallel_query_tiles_per_thread);
+    std::vector<std::vector<uint32_t>> tile_bodies(std::max<uint64_t>(1,tile_count));
+    workers->parallel_for(tile_count,[&](std::size_t first_tile,std::size_t last_tile){
+        for(std::size_t tile{first_tile};tile < last_tile;++tile){
+            auto& found = tile_bodies[tile];
+            auto collect = [&found](uint32_t body_index){
+                found.push_back(body_index);
+            };
+            uint64_t tile_from = tile_units * tile / tile_count,
+                     tile_to = tile_units * (tile + 1) / tile_count;
+            if(full_scan){
+                scan_bodies_within(area,tile_from,tile_to,body_visitor(collect));
+            }else{
+                object_area strip(area.x_from,area.x_to,
+                                  area.y_from + tile_from,
+                                  area.y_from + tile_to - 1);
+                bodies_index->query(strip,body_visitor(collect));
+            }
+        }
+    },1);
+
+    std::vector<std::size_t> tile_offsets(tile_bodies.size() + 1,0);
+    for(std::size_t tile{0};tile < tile_bodies.size();++tile){
+        tile_offsets[tile + 1] = tile_offsets[tile] + tile_bodies[tile].size();
+    }
+    std::vector<celestial_body_view> bodies(tile_offsets.back(),
+                                            celestial_body_view(celestial_bodies,0));
+    workers->parallel_for(tile_bodies.size(),[&](std::size_t first_tile,std::size_t last_tile){
+        for(std::size_t tile{first_tile};tile < last_tile;++tile){
+            std::size_t offset = tile_offsets[tile];
+            for(auto body_index : tile_bodies[tile]){
+                bodies[offset++] = celestial_body_view(celestial_bodies,body_index);
+            }
+        }
+    },1);
+    if(order == query_order::by_body_index && !full_scan){
+        game_workers::parallel_sort(workers.get(),bodies.begin(),bodies.end(),
+                                    [](const celestial_body_view& first,
+                                       const celestial_body_view& second){
+            return first.get_body_index() < second.get_body_index();
+        });
+    }
+    return bodies;
+}
+
+/*
+ * The kd-tree is rebuilt in bulk, this may be called after
+ * a batch of changes to avoid paying the rebuild at the
+ * first nearest body query. Nothing is done if it is fresh.
+ */
+void universe_map::rebuild_nearest_index() const
+{
+    get_nearest_index();
+}
+
+/*
+ * The nearest queries are const and may run concurrently,
+ * only the first of them rebuilds a stale kd-tree and the
+ * others wait for it.
+ */
+const kd_tree& universe_map::get_nearest_index() const
+{
+    if(nearest_index_status.stale.load(std::memory_order_acquire)){
+        std::lock_guard<std::mutex> lock(nearest_index_status.rebuild_mtx);
+        if(nearest_index_status.stale.load(std::memory_order_relaxed)){
+            nearest_index.rebuild(celestial_bodies);
+            nearest_index_status.stale.store(false,std::memory_order_release);
+        }
+    }
+    return nearest_index;
+}
+
+std::vector<celestial_body_view> universe_map::find_nearest_bodies(const object_coordinates& point,
+                                                                   std::size_t k,
+                                                                   celestial_body_types type) const
+{
+    std::vector<uint32_t> found_bodies;
+    get_nearest_index().nearest(point,k,found_bodies,type);
+    std::vector<celestial_body_view> bodies;
+    bodies.reserve(found_bodies.size());
+    for(auto body_index : found_bodies){
+        bodies.emplace_back(celestial_bodies,body_index);
+    }
+    return bodies;
+}
+
+std::vector<celestial_body_view> universe_map::find_bodies_in_radius(const object_coordinates& point,
+                                                                     uint32_t radius) const
+{
+    std::vector<celestial_body_view> bodies;
+    for_each_body_in_radius(point,radius,[&bodies](const celestial_body_view& body){
+        bodies.push_back(body);
+    });
+    return bodies;
+}
+
+/*
+ * Return the body under the point, that is the closest body
+ * if the point is within its diameter or no farther than
+ * 'tolerance' from its center. no_body otherwise.
+ */
+uint32_t universe_map::pick_body(const object_coordinates& point,
+                                 uint32_t tolerance) const
+{
+    std::vector<uint32_t> found_bodies;
+    get_nearest_index().nearest(point,1,found_bodies);
+    if(found_bodies.empty())
+        return no_body;
+    uint32_t body_index = found_bodies.front();
+    auto position = celestial_bodies.position(body_index);
+    double dx = double(position.x) - point.x,
+           dy = double(position.y) - point.y,
+           max_distance = std::max(celestial_bodies.body_diameter(body_index) / 2,
+                                   tolerance);
+    if(dx * dx + dy * dy > max_distance * max_distance)
+        return no_body;
+    return body_index;
+}
+
+}
+
+
 
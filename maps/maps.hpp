@@ -3,7 +3,20 @@
 
 #include "position.hpp"
 #include "objects.hpp"
+#include "bodies.hpp"
+#include "grid.hpp"
+#include "quadtree.hpp"
+#include "simd_filter.hpp"
+#include "kdtree.hpp"
+#include "morton.hpp"
+#include "snapshot.hpp"
+#include "journal.hpp"
+#include "body_bitset.hpp"
+#include "../configuration/configuration.hpp"
+#include "../workers/workers.hpp"
 #include <vector>
+#include <mutex>
+#include <atomic>
 
 namespace game_maps
 {
@@ -11,39 +24,245 @@ namespace game_maps
 using namespace coordinates;
 using namespace objects;
 
+/*
+ * Queries covering more than this fraction of the universe
+ * are faster with a vectorized scan of all the positions
+ * than with a walk of the spatial index.
+ */
+static const double full_scan_area_ratio = 1.0 / 128;
+
+//Tiles scanned by each thread in the parallel queries, for load balancing
+static const uint32_t parallel_query_tiles_per_thread = 4;
+
+/*
+ * Order of the results of the parallel queries, ordering
+ * by body index gives the same result of a sequential query
+ * with full scan, at the cost of a sort for the small areas.
+ */
+enum class query_order
+{
+    unordered,
+    by_body_index
+};
+
 struct uni_map_specifics
 {
     uint32_t universe_width,
-             universe_height;
+             universe_height,
+             grid_cell_size,
+             quadtree_node_capacity;
+    spatial_index_type index_type;
 
     uni_map_specifics() :
         universe_height{0},
-        universe_width{0}
+        universe_width{0},
+        grid_cell_size{default_grid_cell_size},
+        quadtree_node_capacity{default_quadtree_node_capacity},
+        index_type{spatial_index_type::loose_quadtree}
     {}
     uni_map_specifics(uint32_t width,
                       uint32_t height):
         universe_width{width},
-        universe_height{height}
+        universe_height{height},
+        grid_cell_size{default_grid_cell_size},
+        quadtree_node_capacity{default_quadtree_node_capacity},
+        index_type{spatial_index_type::loose_quadtree}
     {}
 };
 
+/*
+ * Bodies are identified by their index in the map,
+ * when a body is removed the last body takes its index.
+ * The storage is kept in Z-order, so the indexes may also
+ * change when bodies are added or removed.
+ * Each body also receives a handle which never changes,
+ * the slot map translates the handles to the current index.
+ */
 class universe_map
 {
-    std::vector<celestial_body_ptr> celestial_bodies;
-    uni_map_specifics               universe_specification;
+    /*
+     * Staleness of the kd-tree, the first query after a change
+     * rebuilds it under the lock. A moved map gets a new lock.
+     */
+    struct nearest_index_state
+    {
+        std::mutex        rebuild_mtx;
+        std::atomic<bool> stale{true};
+
+        nearest_index_state() = default;
+        nearest_index_state(const nearest_index_state& other) :
+            stale{other.stale.load()}
+        {}
+        nearest_index_state& operator=(const nearest_index_state& other){
+            stale = other.stale.load();
+            return *this;
+        }
+    };
+
+    body_storage      celestial_bodies;
+    body_slot_map     body_slots;
+    uni_map_specifics universe_specification;
+    spatial_index_ptr bodies_index;
+    game_workers::worker_pool_ptr workers;
+    std::shared_ptr<universe_journal> journal;
+    //Rebuilt on demand after the bodies change
+    mutable kd_tree   nearest_index;
+    mutable nearest_index_state nearest_index_status;
+    //Bodies out of Z-order since the last sort
+    uint32_t          unordered_bodies;
+
+    void rebuild_index();
+    bool within_universe(const object_coordinates& position) const;
+    bool prefer_full_scan(const object_area& area) const;
+    void index_new_bodies(uint32_t first_new_body);
+    void keep_morton_order();
+    uint32_t store_body(const celestial_body& new_body);
+    void visit_bodies_within(const object_area& area,
+                             body_visitor visitor) const;
+    void visit_bodies_within(const std::vector<object_area>& areas,
+                             area_body_visitor visitor) const;
+    void scan_bodies_within(const object_area& area,
+                            std::size_t first_body,
+                            std::size_t last_body,
+                            body_visitor visitor) const;
+    const kd_tree& get_nearest_index() const;
 public:
     universe_map();
+    void configure(game_configuration::game_config_ptr game_conf);
+    void set_worker_pool(game_workers::worker_pool_ptr worker_pool);
+    //The changes of the bodies are recorded in the journal, if any
+    void set_journal(std::shared_ptr<universe_journal> universe_changes);
+    std::shared_ptr<universe_journal> get_journal() const;
     void set_universe_size(uint32_t width,
                            uint32_t height);
+    void set_grid_cell_size(uint32_t cell_size);
+    void set_spatial_index(spatial_index_type index_type);
+    void sort_bodies_by_morton_code();
+    bool save_snapshot(const std::string& file_name) const;
+    bool load_snapshot(const universe_snapshot& snapshot);
+
+    body_handle add_celestial_body(const celestial_body& new_body);
+    body_handle add_celestial_body(celestial_body_ptr new_body);
+    template<typename ITERATOR>
+    uint32_t add_celestial_bodies(ITERATOR first,ITERATOR last);
+    bool remove_celestial_body(uint32_t body_index);
+    bool remove_celestial_body(const body_handle& handle);
+    bool move_celestial_body(uint32_t body_index,
+                             const object_coordinates& new_position);
+    bool move_celestial_body(const body_handle& handle,
+                             const object_coordinates& new_position);
+    uint32_t move_celestial_bodies(const std::vector<body_handle>& handles,
+                                   const std::vector<object_coordinates>& new_positions);
+    bool update_body_specifics(const body_handle& handle,
+                               const celestial_body_spec& specifics);
 
-    uint32_t add_celestial_body(celestial_body_ptr new_body);
+    uint32_t get_universe_width() const;
+    uint32_t get_universe_height() const;
+    uint32_t get_bodies_count() const;
+    celestial_body_view get_body(uint32_t body_index) const;
+    bool contains_body(const body_handle& handle) const;
+    uint32_t find_body(const body_handle& handle) const;
 
-    std::vector<celestial_body_cptr> find_bodies_within(uint32_t top_left_y,
+    std::vector<celestial_body_view> find_bodies_within(uint32_t top_left_y,
                                                         uint32_t top_left_x,
                                                         uint32_t bottom_right_x,
-                                                        uint32_t bottom_right_y);
+                                                        uint32_t bottom_right_y) const;
+    std::vector<celestial_body_view> find_bodies_within(const object_area& area) const;
+    std::size_t find_bodies_within(const object_area& area,
+                                   uint32_t* found_indexes,
+                                   std::size_t capacity) const;
+    std::vector<std::vector<celestial_body_view>> find_bodies_within(const std::vector<object_area>& areas) const;
+    //Only the bodies whose slot is set in 'visible'
+    std::vector<celestial_body_view> find_bodies_within(const object_area& area,
+                                                        const body_bitset& visible) const;
+    std::vector<celestial_body_view> find_bodies_within_parallel(const object_area& area,
+                                                                 query_order order) const;
+
+    template<typename FUNC>
+    void for_each_body_within(const object_area& area,
+                              FUNC&& func) const;
+    template<typename FUNC>
+    void for_each_body_within(const std::vector<object_area>& areas,
+                              FUNC&& func) const;
+
+    //Like the other const queries the nearest ones may run concurrently
+    void rebuild_nearest_index() const;
+    std::vector<celestial_body_view> find_nearest_bodies(const object_coordinates& point,
+                                                         std::size_t k,
+                                                         celestial_body_types type =
+                                                            celestial_body_types::celestial_body_none) const;
+    std::vector<celestial_body_view> find_bodies_in_radius(const object_coordinates& point,
+                                                           uint32_t radius) const;
+    template<typename FUNC>
+    void for_each_body_in_radius(const object_coordinates& point,
+                                 uint32_t radius,
+                                 FUNC&& func) const;
+    uint32_t pick_body(const object_coordinates& point,
+                       uint32_t tolerance) const;
 };
 
+/*
+ * Add all the bodies of the range, the bodies outside the
+ * universe are skipped. The storage grows only once and big
+ * batches rebuild the spatial index in bulk.
+ */
+template<typename ITERATOR>
+uint32_t universe_map::add_celestial_bodies(ITERATOR first,ITERATOR last)
+{
+    uint32_t first_new_body = celestial_bodies.size();
+    std::size_t new_bodies = std::distance(first,last);
+    celestial_bodies.reserve(first_new_body + new_bodies);
+    body_slots.reserve(first_new_body + new_bodies);
+    for(;first != last;++first){
+        const celestial_body& new_body = *first;
+        if(within_universe(new_body.get_body_coordinates())){
+            store_body(new_body);
+        }
+    }
+    index_new_bodies(first_new_body);
+    return celestial_bodies.size();
+}
+
+/*
+ * Call func with the celestial_body_view of each body
+ * within the area, neither allocations nor reference
+ * counting are involved.
+ */
+template<typename FUNC>
+void universe_map::for_each_body_within(const object_area& area,
+                                        FUNC&& func) const
+{
+    auto visit = [this,&func](uint32_t body_index){
+        func(celestial_body_view(celestial_bodies,body_index));
+    };
+    visit_bodies_within(area,body_visitor(visit));
+}
+
+/*
+ * Batched version, func receives the index of the
+ * area together with each body within that area.
+ */
+template<typename FUNC>
+void universe_map::for_each_body_within(const std::vector<object_area>& areas,
+                                        FUNC&& func) const
+{
+    auto visit = [this,&func](uint32_t area_index,uint32_t body_index){
+        func(area_index,celestial_body_view(celestial_bodies,body_index));
+    };
+    visit_bodies_within(areas,area_body_visitor(visit));
+}
+
+template<typename FUNC>
+void universe_map::for_each_body_in_radius(const object_coordinates& point,
+                                           uint32_t radius,
+                                           FUNC&& func) const
+{
+    auto visit = [this,&func](uint32_t body_index){
+        func(celestial_body_view(celestial_bodies,body_index));
+    };
+    get_nearest_index().within_radius(point,radius,body_visitor(visit));
+}
+
 }
 
 #endif
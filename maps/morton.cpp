@@ -0,0 +1,266 @@
+#include "../logger/logger.hpp"
+#include "morton.hpp"
+#include <algorithm>
+
+namespace game_maps
+{
+
+namespace
+{
+
+const morton_code even_bits = 0x5555555555555555ULL;
+const uint32_t erased_body = UINT32_MAX;
+
+morton_code spread_bits(uint32_t value)
+{
+    morton_code code = value;
+    code = (code | (code << 16)) & 0x0000FFFF0000FFFFULL;
+    code = (code | (code << 8))  & 0x00FF00FF00FF00FFULL;
+    code = (code | (code << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+    code = (code | (code << 2))  & 0x3333333333333333ULL;
+    code = (code | (code << 1))  & 0x5555555555555555ULL;
+    return code;
+}
+
+uint32_t compact_bits(morton_code code)
+{
+    code &= even_bits;
+    code = (code | (code >> 1))  & 0x3333333333333333ULL;
+    code = (code | (code >> 2))  & 0x0F0F0F0F0F0F0F0FULL;
+    code = (code | (code >> 4))  & 0x00FF00FF00FF00FFULL;
+    code = (code | (code >> 8))  & 0x0000FFFF0000FFFFULL;
+    code = (code | (code >> 16)) & 0x00000000FFFFFFFFULL;
+    return code;
+}
+
+//Bits of the same dimension of 'bit' which are less significant
+morton_code lower_dimension_bits(uint32_t bit)
+{
+    return ((morton_code(1) << bit) - 1) & (even_bits << (bit & 1));
+}
+
+//Set 'bit' and clear the lower bits of the same dimension
+morton_code load_1000(morton_code code,uint32_t bit)
+{
+    return (code | (morton_code(1) << bit)) & ~lower_dimension_bits(bit);
+}
+
+//Clear 'bit' and set the lower bits of the same dimension
+morton_code load_0111(morton_code code,uint32_t bit)
+{
+    return (code & ~(morton_code(1) << bit)) | lower_dimension_bits(bit);
+}
+
+}
+
+morton_code morton_encode(const object_coordinates& position)
+{
+    return spread_bits(position.x) | (spread_bits(position.y) << 1);
+}
+
+object_coordinates morton_decode(morton_code code)
+{
+    return object_coordinates(compact_bits(code),
+                              compact_bits(code >> 1));
+}
+
+morton_code morton_bigmin(morton_code code,
+                          morton_code zmin,
+                          morton_code zmax)
+{
+    morton_code bigmin{zmax};
+    for(int32_t bit{63};bit >= 0;--bit){
+        morton_code mask = morton_code(1) << bit;
+        bool code_bit = code & mask,
+             min_bit = zmin & mask,
+             max_bit = zmax & mask;
+        if(!code_bit && !min_bit && max_bit){
+            bigmin = load_1000(zmin,bit);
+            zmax = load_0111(zmax,bit);
+        }else if(!code_bit && min_bit && max_bit){
+            return zmin;
+        }else if(code_bit && !min_bit && !max_bit){
+            return bigmin;
+        }else if(code_bit && !min_bit && max_bit){
+            zmin = load_1000(zmin,bit);
+        }
+    }
+    return bigmin;
+}
+
+morton_index::morton_index() :
+    erased_count{0}
+{   }
+
+bool morton_index::merge_needed() const
+{
+    return pending.size() > std::max<std::size_t>(default_morton_pending_limit,
+                                                  sorted_codes.size() / 16) ||
+           erased_count > std::max<std::size_t>(default_morton_pending_limit,
+                                                sorted_codes.size() / 4);
+}
+
+/*
+ * Merge the sorted pending bodies with the sorted run,
+ * dropping the erased entries
+ */
+void morton_index::merge_pending()
+{
+    std::sort(pending.begin(),pending.end());
+    std::vector<morton_code> merged_codes;
+    std::vector<uint32_t> merged_bodies;
+    merged_codes.reserve(sorted_codes.size() - erased_count + pending.size());
+    merged_bodies.reserve(merged_codes.capacity());
+    std::size_t sorted_idx{0},pending_idx{0};
+    while(sorted_idx < sorted_codes.size() || pending_idx < pending.size()){
+        if(pending_idx == pending.size() ||
+           (sorted_idx < sorted_codes.size() &&
+            sorted_codes[sorted_idx] <= pending[pending_idx].code)){
+            if(sorted_bodies[sorted_idx] != erased_body){
+                merged_codes.push_back(sorted_codes[sorted_idx]);
+                merged_bodies.push_back(sorted_bodies[sorted_idx]);
+            }
+            ++sorted_idx;
+        }else{
+            merged_codes.push_back(pending[pending_idx].code);
+            merged_bodies.push_back(pending[pending_idx].body_index);
+            ++pending_idx;
+        }
+    }
+    sorted_codes.swap(merged_codes);
+    sorted_bodies.swap(merged_bodies);
+    pending.clear();
+    erased_count = 0;
+}
+
+void morton_index::insert(uint32_t body_index,
+                          const object_coordinates& position)
+{
+    pending.push_back({morton_encode(position),body_index});
+    if(merge_needed()){
+        merge_pending();
+    }
+}
+
+void morton_index::erase(uint32_t body_index,
+                         const object_coordinates& position)
+{
+    morton_code code = morton_encode(position);
+    for(auto& entry : pending){
+        if(entry.body_index == body_index){
+            entry = pending.back();
+            pending.pop_back();
+            return;
+        }
+    }
+    auto code_it = std::lower_bound(sorted_codes.begin(),sorted_codes.end(),code);
+    for(std::size_t idx = code_it - sorted_codes.begin();
+        idx < sorted_codes.size() && sorted_codes[idx] == code;++idx){
+        if(sorted_bodies[idx] == body_index){
+            sorted_bodies[idx] = erased_body;
+            ++erased_count;
+            if(merge_needed()){
+                merge_pending();
+            }
+            return;
+        }
+    }
+    WARN1("Body ",body_index," not found in the morton index!");
+}
+
+void morton_index::relocate(uint32_t body_index,
+                            const object_coordinates& old_position,
+                            const object_coordinates& new_position)
+{
+    if(morton_encode(old_position) == morton_encode(new_position))
+        return;
+    erase(body_index,old_position);
+    insert(body_index,new_position);
+}
+
+void morton_index::clear()
+{
+    sorted_codes.clear();
+    sorted_bodies.clear();
+    pending.clear();
+    erased_count = 0;
+}
+
+/*
+ * Sort all the bodies at once, when the storage is
+ * in Z-order the body indexes are sorted too.
+ */
+void morton_index::build(const uint32_t* x,
+                         const uint32_t* y,
+                         uint32_t count,
+                         game_workers::worker_pool* workers)
+{
+    clear();
+    std::vector<morton_entry> entries(count);
+    auto encode = [&entries,x,y](std::size_t first,std::size_t last){
+        for(std::size_t body_index{first};body_index < last;++body_index){
+            entries[body_index] = {morton_encode(object_coordinates(x[body_index],
+                                                                    y[body_index])),
+                                   uint32_t(body_index)};
+        }
+    };
+    if(workers){
+        workers->parallel_for(count,encode);
+    }else{
+        encode(0,count);
+    }
+    game_workers::parallel_sort(workers,entries.begin(),entries.end(),
+                                std::less<morton_entry>());
+    sorted_codes.resize(count);
+    sorted_bodies.resize(count);
+    for(uint32_t idx{0};idx < count;++idx){
+        sorted_codes[idx] = entries[idx].code;
+        sorted_bodies[idx] = entries[idx].body_index;
+    }
+}
+
+/*
+ * Walk the sorted codes between the codes of the area corners,
+ * when a code outside the area is found BIGMIN gives the next
+ * code in the area and the walk jumps there.
+ */
+void morton_query(const morton_code* codes,
+                  std::size_t count,
+                  const object_area& area,
+                  body_visitor visitor)
+{
+    if(area.x_from > area.x_to || area.y_from > area.y_to)
+        return;
+    morton_code zmin = morton_encode(object_coordinates(area.x_from,area.y_from)),
+                zmax = morton_encode(object_coordinates(area.x_to,area.y_to));
+    const morton_code* last = codes + count;
+    const morton_code* code_it = std::lower_bound(codes,last,zmin);
+    while(code_it != last && *code_it <= zmax){
+        if(area.contains(morton_decode(*code_it))){
+            visitor(code_it - codes);
+            ++code_it;
+        }else{
+            code_it = std::lower_bound(code_it,last,
+                                       morton_bigmin(*code_it,zmin,zmax));
+        }
+    }
+}
+
+void morton_index::query(const object_area& area,
+                         body_visitor visitor) const
+{
+    auto visit = [this,&visitor](uint32_t position){
+        uint32_t body_index = sorted_bodies[position];
+        if(body_index != erased_body){
+            visitor(body_index);
+        }
+    };
+    morton_query(sorted_codes.data(),sorted_codes.size(),area,body_visitor(visit));
+    for(const auto& entry : pending){
+        if(area.contains(morton_decode(entry.code))){
+            visitor(entry.body_index);
+        }
+    }
+}
+
+}
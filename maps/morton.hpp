@@ -0,0 +1,89 @@
+#ifndef MORTON_HPP
+#define MORTON_HPP
+
+#include "spatial_index.hpp"
+#include <utility>
+
+namespace game_maps
+{
+
+using namespace coordinates;
+
+using morton_code = uint64_t;
+
+/*
+ * Z-order code of the coordinates, the bits of x
+ * are in the even positions and those of y in the odd.
+ */
+morton_code morton_encode(const object_coordinates& position);
+object_coordinates morton_decode(morton_code code);
+
+/*
+ * Given the Z-order box with corners zmin and zmax (the codes
+ * of the top left and bottom right corners of an area) return
+ * the smallest code in the box bigger than 'code' (BIGMIN).
+ */
+morton_code morton_bigmin(morton_code code,
+                          morton_code zmin,
+                          morton_code zmax);
+
+/*
+ * Call visitor with the position in 'codes' of each code within
+ * the area, the codes shall be sorted. Used by the morton index
+ * and by the universe snapshots, whose bodies are in Z-order.
+ */
+void morton_query(const morton_code* codes,
+                  std::size_t count,
+                  const object_area& area,
+                  body_visitor visitor);
+
+static const uint32_t default_morton_pending_limit = 1024;
+
+/*
+ * Bodies ordered by the Z-order code of their position, the
+ * queries walk the sorted codes and use BIGMIN to skip the
+ * codes outside the area. New bodies are collected in a small
+ * unsorted pending list and merged in the sorted run when it
+ * grows, erased bodies are marked and dropped at the next merge.
+ */
+class morton_index : public spatial_index
+{
+    struct morton_entry
+    {
+        morton_code code;
+        uint32_t    body_index;
+        bool operator<(const morton_entry& other) const{
+            return code < other.code ||
+                   (code == other.code && body_index < other.body_index);
+        }
+    };
+
+    std::vector<morton_code>  sorted_codes;
+    std::vector<uint32_t>     sorted_bodies;
+    std::vector<morton_entry> pending;
+    uint32_t                  erased_count;
+
+    bool merge_needed() const;
+    void merge_pending();
+public:
+    morton_index();
+    void insert(uint32_t body_index,
+                const object_coordinates& position);
+    void erase(uint32_t body_index,
+               const object_coordinates& position);
+    void relocate(uint32_t body_index,
+                  const object_coordinates& old_position,
+                  const object_coordinates& new_position);
+    void clear();
+    void build(const uint32_t* x,
+               const uint32_t* y,
+               uint32_t count,
+               game_workers::worker_pool* workers);
+
+    void query(const object_area& area,
+               body_visitor visitor) const;
+};
+
+}
+
+#endif
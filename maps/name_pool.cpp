@@ -0,0 +1,166 @@
+#include "name_pool.hpp"
+#include <cstring>
+#include <algorithm>
+#include <mutex>
+
+namespace game_maps
+{
+
+namespace
+{
+
+//FNV-1a
+uint32_t hash_name(std::string_view name)
+{
+    uint32_t hash{2166136261u};
+    for(char c : name){
+        hash = (hash ^ uint8_t(c)) * 16777619u;
+    }
+    return hash;
+}
+
+}
+
+name_pool::name_pool() :
+    block_used{0},
+    block_capacity{0},
+    arena_size{0},
+    buckets(1024,no_name)
+{
+    intern(std::string_view());
+}
+
+name_pool& name_pool::shared()
+{
+    static name_pool pool;
+    return pool;
+}
+
+/*
+ * Linear probing, the table is kept at most half full
+ * so the probe sequences stay short.
+ */
+name_id name_pool::lookup(std::string_view name,uint32_t hash) const
+{
+    std::size_t mask = buckets.size() - 1;
+    for(std::size_t bucket{hash & mask};buckets[bucket] != no_name;bucket = (bucket + 1) & mask){
+        const auto& entry = entries[buckets[bucket]];
+        //An empty view may have no data, memcmp shall not see it
+        if(entry.hash == hash && entry.length == name.size() &&
+           (name.empty() || std::memcmp(entry.text,name.data(),name.size()) == 0)){
+            return buckets[bucket];
+        }
+    }
+    return no_name;
+}
+
+/*
+ * Copy the name in the current arena block, names which
+ * do not fit a block receive a block of their own.
+ */
+const char* name_pool::store(std::string_view name)
+{
+    std::size_t required = name.size() + 1;
+    if(block_used + required > block_capacity){
+        block_capacity = std::max(required,name_arena_block_size);
+        arena_blocks.push_back(std::make_unique<char[]>(block_capacity));
+        arena_size += block_capacity;
+        block_used = 0;
+    }
+    char* text = arena_blocks.back().get() + block_used;
+    if(!name.empty()){
+        std::memcpy(text,name.data(),name.size());
+    }
+    text[name.size()] = '\0';
+    block_used += required;
+    return text;
+}
+
+void name_pool::grow_buckets()
+{
+    std::vector<name_id> new_buckets(buckets.size() * 2,no_name);
+    std::size_t mask = new_buckets.size() - 1;
+    for(name_id id{0};id < entries.size();++id){
+        std::size_t bucket = entries[id].hash & mask;
+        while(new_buckets[bucket] != no_name){
+            bucket = (bucket + 1) & mask;
+        }
+        new_buckets[bucket] = id;
+    }
+    buckets.swap(new_buckets);
+}
+
+/*
+ * Return the id of the name, adding it to
+ * the pool if it is not there yet
+ */
+name_id name_pool::intern(std::string_view name)
+{
+    uint32_t hash = hash_name(name);
+    {
+        std::shared_lock<std::shared_mutex> lock(pool_mtx);
+        name_id id = lookup(name,hash);
+        if(id != no_name)
+            return id;
+    }
+    std::unique_lock<std::shared_mutex> lock(pool_mtx);
+    //Another thread may have added it in the meanwhile
+    name_id id = lookup(name,hash);
+    if(id != no_name)
+        return id;
+    id = entries.size();
+    entries.push_back({store(name),uint32_t(name.size()),hash});
+    if(entries.size() * 2 > buckets.size()){
+        grow_buckets();
+    }else{
+        std::size_t mask = buckets.size() - 1,
+                    bucket = hash & mask;
+        while(buckets[bucket] != no_name){
+            bucket = (bucket + 1) & mask;
+        }
+        buckets[bucket] = id;
+    }
+    return id;
+}
+
+name_id name_pool::find(std::string_view name) const
+{
+    std::shared_lock<std::shared_mutex> lock(pool_mtx);
+    return lookup(name,hash_name(name));
+}
+
+std::string_view name_pool::name(name_id id) const
+{
+    std::shared_lock<std::shared_mutex> lock(pool_mtx);
+    if(id >= entries.size())
+        return std::string_view();
+    return std::string_view(entries[id].text,entries[id].length);
+}
+
+const char* name_pool::c_str(name_id id) const
+{
+    std::shared_lock<std::shared_mutex> lock(pool_mtx);
+    if(id >= entries.size())
+        return entries[empty_name].text;
+    return entries[id].text;
+}
+
+uint32_t name_pool::size() const
+{
+    std::shared_lock<std::shared_mutex> lock(pool_mtx);
+    return entries.size();
+}
+
+/*
+ * Bytes used by the arena, the entries
+ * and the hash table
+ */
+std::size_t name_pool::memory_usage() const
+{
+    std::shared_lock<std::shared_mutex> lock(pool_mtx);
+    return arena_size +
+           entries.capacity() * sizeof(name_entry) +
+           buckets.capacity() * sizeof(name_id);
+}
+
+}
@@ -0,0 +1,72 @@
+#ifndef NAME_POOL_HPP
+#define NAME_POOL_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <memory>
+#include <string_view>
+#include <shared_mutex>
+
+namespace game_maps
+{
+
+using name_id = uint32_t;
+
+//Id of the empty name, always in the pool
+static const name_id empty_name = 0;
+//Returned by name_pool::find when the name was never interned
+static const name_id no_name = UINT32_MAX;
+
+//Size of the arena blocks holding the characters of the names
+static const std::size_t name_arena_block_size = 64 * 1024;
+
+/*
+ * Deduplicated storage for the names of the bodies and
+ * the labels of the UI. Each distinct string is stored
+ * once, null terminated, in large arena blocks which never
+ * move; the names are then referred by a 32 bit id and two
+ * names are equal only if their ids are equal.
+ * Interning and reading the names is thread safe.
+ */
+class name_pool
+{
+    struct name_entry
+    {
+        const char* text;
+        uint32_t    length,
+                    hash;
+    };
+
+    std::vector<std::unique_ptr<char[]>> arena_blocks;
+    std::size_t                          block_used,
+                                         block_capacity,
+                                         arena_size;
+    std::vector<name_entry>              entries;
+    //Open addressing table of the name ids, no_name marks a free bucket
+    std::vector<name_id>                 buckets;
+    mutable std::shared_mutex            pool_mtx;
+
+    name_id lookup(std::string_view name,uint32_t hash) const;
+    const char* store(std::string_view name);
+    void grow_buckets();
+public:
+    name_pool();
+    name_pool(const name_pool&) = delete;
+    name_pool& operator=(const name_pool&) = delete;
+
+    name_id intern(std::string_view name);
+    name_id find(std::string_view name) const;
+    std::string_view name(name_id id) const;
+    //Names are null terminated, this is valid as long as the pool
+    const char* c_str(name_id id) const;
+
+    uint32_t size() const;
+    std::size_t memory_usage() const;
+
+    //Pool shared by the celestial bodies and the UI
+    static name_pool& shared();
+};
+
+}
+
+#endif
@@ -7,20 +7,67 @@ namespace objects
 
 celestial_body::celestial_body(const std::string &name,
                              const celestial_body_spec &specifics,
-                             const object_coordinates &position)
+                             const object_coordinates &position,
+                             celestial_body_types type)
 {
-    body_info.body_specifics = specifics;
-    body_info.body_position = position;
+    hot_info.body_position = position;
+    hot_info.body_type = type;
+    cold_info.body_name = game_maps::name_pool::shared().intern(name);
+    cold_info.body_specifics = specifics;
 }
 
-const object_coordinates &celestial_body::get_body_coordinates()
+celestial_body::celestial_body(const object_hot_info &hot,
+                               const object_cold_info &cold) :
+    hot_info{hot},
+    cold_info{cold}
+{   }
+
+const object_coordinates &celestial_body::get_body_coordinates() const
 {
-    return body_info.body_position;
+    return hot_info.body_position;
 }
 
-object_info::object_info():
-    body_type{celestial_body_types::celestial_body_none},
-    body_unique_id{0}
+void celestial_body::set_body_coordinates(const object_coordinates &position)
+{
+    hot_info.body_position = position;
+}
+
+std::string_view celestial_body::get_body_name() const
+{
+    return game_maps::name_pool::shared().name(cold_info.body_name);
+}
+
+game_maps::name_id celestial_body::get_body_name_id() const
+{
+    return cold_info.body_name;
+}
+
+celestial_body_types celestial_body::get_body_type() const
+{
+    return hot_info.body_type;
+}
+
+const celestial_body_spec &celestial_body::get_body_specifics() const
+{
+    return cold_info.body_specifics;
+}
+
+const object_hot_info &celestial_body::get_hot_info() const
+{
+    return hot_info;
+}
+
+const object_cold_info &celestial_body::get_cold_info() const
+{
+    return cold_info;
+}
+
+object_hot_info::object_hot_info():
+    body_type{celestial_body_types::celestial_body_none}
+{   }
+
+object_cold_info::object_cold_info():
+    body_name{game_maps::empty_name}
 {   }
 
 }
@@ -2,6 +2,7 @@
 #define OBJECTS_HPP
 
 #include "position.hpp"
+#include "name_pool.hpp"
 #include <string>
 #include <memory>
 
@@ -14,7 +15,7 @@ struct celestial_body;
 using celestial_body_ptr = std::shared_ptr<celestial_body>;
 using celestial_body_cptr = std::shared_ptr<const celestial_body>;
 
-enum class celestial_body_types
+enum class celestial_body_types : uint8_t
 {
     celestial_body_none,
     celestial_body_planet,
@@ -30,26 +31,48 @@ struct celestial_body_spec
     {}
 };
 
-struct object_info
+/*
+ * Data of a body touched at each tick of
+ * the simulation, kept as small as possible
+ */
+struct object_hot_info
 {
-    celestial_body_types body_type;
-    std::string          body_name;
-    uint32_t             body_unique_id;
     object_coordinates   body_position;
+    celestial_body_types body_type;
+
+    object_hot_info();
+};
+
+//Data read only when the body is inspected
+struct object_cold_info
+{
+    game_maps::name_id   body_name;
     celestial_body_spec  body_specifics;
 
-    object_info();
+    object_cold_info();
 };
 
 class celestial_body
 {
-    object_info body_info;
+    object_hot_info  hot_info;
+    object_cold_info cold_info;
 public:
+    celestial_body() = default;
     explicit celestial_body(const std::string& name,
                   const celestial_body_spec& specifics,
-                  const object_coordinates& position);
-
-    const object_coordinates& get_body_coordinates();
+                  const object_coordinates& position,
+                  celestial_body_types type = celestial_body_types::celestial_body_none);
+    celestial_body(const object_hot_info& hot,
+                   const object_cold_info& cold);
+
+    const object_coordinates& get_body_coordinates() const;
+    void set_body_coordinates(const object_coordinates& position);
+    std::string_view get_body_name() const;
+    game_maps::name_id get_body_name_id() const;
+    celestial_body_types get_body_type() const;
+    const celestial_body_spec& get_body_specifics() const;
+    const object_hot_info& get_hot_info() const;
+    const object_cold_info& get_cold_info() const;
 
     template<typename...ARGS>
     static celestial_body_ptr create(ARGS...args);
@@ -0,0 +1,386 @@
+#include "../logger/logger.hpp"
+#include "orbits.hpp"
+#include <cmath>
+
+namespace game_maps
+{
+
+namespace
+{
+
+const double pi = 3.141592653589793,
+             half_pi = pi / 2,
+             two_pi = 2 * pi,
+             inverse_two_pi = 1 / two_pi;
+
+//Orbits solved by each job of the parallel solve
+const std::size_t orbits_per_chunk = 16384;
+
+/*
+ * Taylor coefficients of sine and cosine, the angles are
+ * reduced to [-pi/2,pi/2] where the error is below 1e-9
+ */
+const double sin_3 = -1.0 / 6,
+             sin_5 = 1.0 / 120,
+             sin_7 = -1.0 / 5040,
+             sin_9 = 1.0 / 362880,
+             sin_11 = -1.0 / 39916800,
+             sin_13 = 1.0 / 6227020800,
+             cos_2 = -1.0 / 2,
+             cos_4 = 1.0 / 24,
+             cos_6 = -1.0 / 720,
+             cos_8 = 1.0 / 40320,
+             cos_10 = -1.0 / 3628800,
+             cos_12 = 1.0 / 479001600,
+             cos_14 = -1.0 / 87178291200;
+
+/*
+ * The scalar kernel follows the same steps of the vector
+ * one, so the two give the same positions to the unit.
+ */
+inline void fast_sincos(double angle,double& sine,double& cosine)
+{
+    double reduced = angle - std::nearbyint(angle * inverse_two_pi) * two_pi,
+           folded = reduced,
+           sign = 1;
+    if(reduced > half_pi){
+        folded = pi - reduced;
+        sign = -1;
+    }else if(reduced < -half_pi){
+        folded = -pi - reduced;
+        sign = -1;
+    }
+    double square = folded * folded;
+    sine = folded * (1 + square * (sin_3 + square * (sin_5 + square * (sin_7 + square *
+                    (sin_9 + square * (sin_11 + square * sin_13))))));
+    cosine = sign * (1 + square * (cos_2 + square * (cos_4 + square * (cos_6 + square *
+                     (cos_8 + square * (cos_10 + square * (cos_12 + square * cos_14)))))));
+}
+
+void solve_scalar(std::size_t count,
+                  double time,
+                  const double* semi_major,
+                  const double* semi_minor,
+                  const double* eccentricity,
+                  const double* cos_periapsis,
+                  const double* sin_periapsis,
+                  const double* mean_anomaly,
+                  const double* mean_motion,
+                  double* offset_x,
+                  double* offset_y)
+{
+    for(std::size_t orbit{0};orbit < count;++orbit){
+        double anomaly = mean_anomaly[orbit] + mean_motion[orbit] * time,
+               sine,cosine;
+        anomaly -= std::nearbyint(anomaly * inverse_two_pi) * two_pi;
+        fast_sincos(anomaly,sine,cosine);
+        double eccentric_anomaly = anomaly + eccentricity[orbit] * sine;
+        for(uint32_t step{0};step < kepler_iterations;++step){
+            fast_sincos(eccentric_anomaly,sine,cosine);
+            eccentric_anomaly -= (eccentric_anomaly - eccentricity[orbit] * sine - anomaly) /
+                                 (1 - eccentricity[orbit] * cosine);
+        }
+        fast_sincos(eccentric_anomaly,sine,cosine);
+        double x = semi_major[orbit] * (cosine - eccentricity[orbit]),
+               y = semi_minor[orbit] * sine;
+        offset_x[orbit] = x * cos_periapsis[orbit] - y * sin_periapsis[orbit];
+        offset_y[orbit] = x * sin_periapsis[orbit] + y * cos_periapsis[orbit];
+    }
+}
+
+#ifdef MAPS_X86_KERNELS
+
+__attribute__((target("avx2")))
+inline __m256d reduce_angle(__m256d angle)
+{
+    __m256d turns = _mm256_round_pd(_mm256_mul_pd(angle,_mm256_set1_pd(inverse_two_pi)),
+                                    _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    return _mm256_sub_pd(angle,_mm256_mul_pd(turns,_mm256_set1_pd(two_pi)));
+}
+
+//Horner evaluation of c0 + x * (c1 + x * (...))
+__attribute__((target("avx2")))
+inline __m256d polynomial(__m256d x,const double* coefficients,uint32_t count)
+{
+    __m256d result = _mm256_set1_pd(coefficients[count - 1]);
+    for(uint32_t term = count - 1;term > 0;--term){
+        result = _mm256_add_pd(_mm256_set1_pd(coefficients[term - 1]),
+                               _mm256_mul_pd(x,result));
+    }
+    return result;
+}
+
+__attribute__((target("avx2")))
+inline void sincos_avx2(__m256d angle,__m256d& sine,__m256d& cosine)
+{
+    static const double sin_terms[] = {1,sin_3,sin_5,sin_7,sin_9,sin_11,sin_13},
+                        cos_terms[] = {1,cos_2,cos_4,cos_6,cos_8,cos_10,cos_12,cos_14};
+    __m256d reduced = reduce_angle(angle),
+            above = _mm256_cmp_pd(reduced,_mm256_set1_pd(half_pi),_CMP_GT_OQ),
+            below = _mm256_cmp_pd(reduced,_mm256_set1_pd(-half_pi),_CMP_LT_OQ),
+            folded = _mm256_blendv_pd(reduced,_mm256_sub_pd(_mm256_set1_pd(pi),reduced),above);
+    folded = _mm256_blendv_pd(folded,_mm256_sub_pd(_mm256_set1_pd(-pi),reduced),below);
+    __m256d sign = _mm256_blendv_pd(_mm256_set1_pd(1),_mm256_set1_pd(-1),
+                                    _mm256_or_pd(above,below)),
+            square = _mm256_mul_pd(folded,folded);
+    sine = _mm256_mul_pd(folded,polynomial(square,sin_terms,7));
+    cosine = _mm256_mul_pd(sign,polynomial(square,cos_terms,8));
+}
+
+__attribute__((target("avx2")))
+void solve_avx2(std::size_t count,
+                double time,
+                const double* semi_major,
+                const double* semi_minor,
+                const double* eccentricity,
+                const double* cos_periapsis,
+                const double* sin_periapsis,
+                const double* mean_anomaly,
+                const double* mean_motion,
+                double* offset_x,
+                double* offset_y)
+{
+    const __m256d elapsed = _mm256_set1_pd(time),
+                  one = _mm256_set1_pd(1);
+    std::size_t orbit{0};
+    for(;orbit + 4 <= count;orbit += 4){
+        __m256d anomaly = _mm256_add_pd(_mm256_loadu_pd(mean_anomaly + orbit),
+                                        _mm256_mul_pd(_mm256_loadu_pd(mean_motion + orbit),elapsed)),
+                orbit_eccentricity = _mm256_loadu_pd(eccentricity + orbit),
+                sine,cosine;
+        anomaly = reduce_angle(anomaly);
+        sincos_avx2(anomaly,sine,cosine);
+        __m256d eccentric_anomaly = _mm256_add_pd(anomaly,_mm256_mul_pd(orbit_eccentricity,sine));
+        for(uint32_t step{0};step < kepler_iterations;++step){
+            sincos_avx2(eccentric_anomaly,sine,cosine);
+            __m256d error = _mm256_sub_pd(_mm256_sub_pd(eccentric_anomaly,
+                                                        _mm256_mul_pd(orbit_eccentricity,sine)),
+                                          anomaly),
+                    slope = _mm256_sub_pd(one,_mm256_mul_pd(orbit_eccentricity,cosine));
+            eccentric_anomaly = _mm256_sub_pd(eccentric_anomaly,_mm256_div_pd(error,slope));
+        }
+        sincos_avx2(eccentric_anomaly,sine,cosine);
+        __m256d x = _mm256_mul_pd(_mm256_loadu_pd(semi_major + orbit),
+                                  _mm256_sub_pd(cosine,orbit_eccentricity)),
+                y = _mm256_mul_pd(_mm256_loadu_pd(semi_minor + orbit),sine),
+                periapsis_cos = _mm256_loadu_pd(cos_periapsis + orbit),
+                periapsis_sin = _mm256_loadu_pd(sin_periapsis + orbit);
+        _mm256_storeu_pd(offset_x + orbit,_mm256_sub_pd(_mm256_mul_pd(x,periapsis_cos),
+                                                        _mm256_mul_pd(y,periapsis_sin)));
+        _mm256_storeu_pd(offset_y + orbit,_mm256_add_pd(_mm256_mul_pd(x,periapsis_sin),
+                                                        _mm256_mul_pd(y,periapsis_cos)));
+    }
+    solve_scalar(count - orbit,time,semi_major + orbit,semi_minor + orbit,
+                 eccentricity + orbit,cos_periapsis + orbit,sin_periapsis + orbit,
+                 mean_anomaly + orbit,mean_motion + orbit,offset_x + orbit,offset_y + orbit);
+}
+
+#endif
+
+uint32_t clamp_coordinate(double coordinate,uint32_t side)
+{
+    if(coordinate < 0 || side == 0)
+        return 0;
+    if(coordinate > double(side) - 1)
+        return side - 1;
+    return uint32_t(coordinate);
+}
+
+}
+
+void solve_orbits(simd_kernel kernel,
+                  std::size_t count,
+                  double time,
+                  const double* semi_major,
+                  const double* semi_minor,
+                  const double* eccentricity,
+                  const double* cos_periapsis,
+                  const double* sin_periapsis,
+                  const double* mean_anomaly,
+                  const double* mean_motion,
+                  double* offset_x,
+                  double* offset_y)
+{
+    switch(kernel){
+#ifdef MAPS_X86_KERNELS
+    case simd_kernel::avx2:
+        solve_avx2(count,time,semi_major,semi_minor,eccentricity,cos_periapsis,
+                   sin_periapsis,mean_anomaly,mean_motion,offset_x,offset_y);
+        break;
+#endif
+    default:
+        solve_scalar(count,time,semi_major,semi_minor,eccentricity,cos_periapsis,
+                     sin_periapsis,mean_anomaly,mean_motion,offset_x,offset_y);
+    }
+}
+
+orbit_system::orbit_system() :
+    kernel{available_simd_kernel()}
+{}
+
+void orbit_system::set_worker_pool(game_workers::worker_pool_ptr worker_pool)
+{
+    workers = worker_pool;
+}
+
+void orbit_system::set_kernel(simd_kernel new_kernel)
+{
+    kernel = new_kernel;
+}
+
+bool orbit_system::add_orbit(const body_handle& body,
+                             const orbital_elements& elements)
+{
+    if(body.is_null() || elements.semi_major_axis < 0 ||
+       elements.eccentricity < 0 || elements.eccentricity > max_orbit_eccentricity){
+        WARN1("Unable to add the orbit of the body ",body.id());
+        return false;
+    }
+    auto found = orbit_of.find(body.id());
+    uint32_t orbit = found != orbit_of.end() ? found->second : bodies.size();
+    if(orbit == bodies.size()){
+        orbit_of.emplace(body.id(),orbit);
+        bodies.push_back(body);
+        parents.emplace_back();
+        for(auto element : {&semi_major,&semi_minor,&eccentricity,&cos_periapsis,
+                            &sin_periapsis,&mean_anomaly,&mean_motion}){
+            element->push_back(0);
+        }
+    }
+    parents[orbit] = elements.parent;
+    semi_major[orbit] = elements.semi_major_axis;
+    semi_minor[orbit] = elements.semi_major_axis *
+                        std::sqrt(1 - elements.eccentricity * elements.eccentricity);
+    eccentricity[orbit] = elements.eccentricity;
+    cos_periapsis[orbit] = std::cos(elements.argument_of_periapsis);
+    sin_periapsis[orbit] = std::sin(elements.argument_of_periapsis);
+    mean_anomaly[orbit] = elements.mean_anomaly;
+    mean_motion[orbit] = elements.mean_motion;
+    return true;
+}
+
+//The last orbit takes the place of the removed one
+bool orbit_system::remove_orbit(const body_handle& body)
+{
+    auto found = orbit_of.find(body.id());
+    if(found == orbit_of.end())
+        return false;
+    uint32_t orbit = found->second,
+             last_orbit = bodies.size() - 1;
+    orbit_of.erase(found);
+    if(orbit != last_orbit){
+        orbit_of[bodies[last_orbit].id()] = orbit;
+        bodies[orbit] = bodies[last_orbit];
+        parents[orbit] = parents[last_orbit];
+        for(auto element : {&semi_major,&semi_minor,&eccentricity,&cos_periapsis,
+                            &sin_periapsis,&mean_anomaly,&mean_motion}){
+            (*element)[orbit] = (*element)[last_orbit];
+        }
+    }
+    bodies.pop_back();
+    parents.pop_back();
+    for(auto element : {&semi_major,&semi_minor,&eccentricity,&cos_periapsis,
+                        &sin_periapsis,&mean_anomaly,&mean_motion}){
+        element->pop_back();
+    }
+    return true;
+}
+
+uint32_t orbit_system::get_orbits_count() const
+{
+    return bodies.size();
+}
+
+/*
+ * The period grows with the radius to the power of 1.5,
+ * as in the third law of Kepler.
+ */
+uint32_t orbit_system::add_planet_orbits(const universe_map& star_chart,
+                                         long long tick)
+{
+    uint32_t added{0};
+    for(uint32_t body_index{0};body_index < star_chart.get_bodies_count();++body_index){
+        auto planet = star_chart.get_body(body_index);
+        if(planet.get_body_type() != celestial_body_types::celestial_body_planet)
+            continue;
+        auto position = planet.get_body_coordinates();
+        auto stars = star_chart.find_nearest_bodies(position,1,
+                                                    celestial_body_types::celestial_body_star);
+        if(stars.empty())
+            break;
+        auto center = stars.front().get_body_coordinates();
+        double dx = double(position.x) - center.x,
+               dy = double(position.y) - center.y,
+               radius = std::sqrt(dx * dx + dy * dy);
+        if(radius == 0)
+            continue;
+        orbital_elements elements;
+        elements.parent = stars.front().get_body_handle();
+        elements.semi_major_axis = radius;
+        elements.mean_motion = reference_mean_motion *
+                               std::pow(reference_orbit_radius / radius,1.5);
+        elements.mean_anomaly = std::atan2(dy,dx) - elements.mean_motion * double(tick);
+        if(add_orbit(planet.get_body_handle(),elements)){
+            ++added;
+        }
+    }
+    LOG3("Added the orbits of ",added," planets");
+    return added;
+}
+
+void orbit_system::solve(double time)
+{
+    offset_x.resize(bodies.size());
+    offset_y.resize(bodies.size());
+    auto solve_range = [this,time](std::size_t first,std::size_t last){
+        solve_orbits(kernel,last - first,time,
+                     semi_major.data() + first,semi_minor.data() + first,
+                     eccentricity.data() + first,cos_periapsis.data() + first,
+                     sin_periapsis.data() + first,mean_anomaly.data() + first,
+                     mean_motion.data() + first,offset_x.data() + first,
+                     offset_y.data() + first);
+    };
+    if(workers){
+        workers->parallel_for(bodies.size(),solve_range,orbits_per_chunk);
+    }else{
+        solve_range(0,bodies.size());
+    }
+}
+
+/*
+ * The orbital positions follow from the tick,
+ * the moves are not recorded in the journal.
+ */
+uint32_t orbit_system::advance(universe_map& star_chart,
+                               long long tick)
+{
+    for(uint32_t orbit{0};orbit < bodies.size();){
+        if(!star_chart.contains_body(bodies[orbit])){
+            remove_orbit(bodies[orbit]);
+        }else{
+            ++orbit;
+        }
+    }
+    solve(double(tick));
+    new_positions.resize(bodies.size());
+    uint32_t width = star_chart.get_universe_width(),
+             height = star_chart.get_universe_height();
+    for(uint32_t orbit{0};orbit < bodies.size();++orbit){
+        uint32_t parent_index = star_chart.find_body(parents[orbit]);
+        if(parent_index == no_body){
+            //Without its parent the body stays where it is
+            new_positions[orbit] = star_chart.get_body(star_chart.find_body(bodies[orbit])).get_body_coordinates();
+            continue;
+        }
+        auto center = star_chart.get_body(parent_index).get_body_coordinates();
+        new_positions[orbit] = object_coordinates(clamp_coordinate(center.x + offset_x[orbit],width),
+                                                  clamp_coordinate(center.y + offset_y[orbit],height));
+    }
+    auto journal = star_chart.get_journal();
+    star_chart.set_journal(nullptr);
+    uint32_t moved = star_chart.move_celestial_bodies(bodies,new_positions);
+    star_chart.set_journal(journal);
+    return moved;
+}
+
+}
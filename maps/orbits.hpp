@@ -0,0 +1,119 @@
+#ifndef ORBITS_HPP
+#define ORBITS_HPP
+
+#include "maps.hpp"
+#include <unordered_map>
+
+namespace game_maps
+{
+
+using namespace coordinates;
+
+//Newton steps solving the Kepler equation, enough up to eccentricity 0.9
+static const uint32_t kepler_iterations = 6;
+static const double max_orbit_eccentricity = 0.9;
+//A planet this far from its star turns by this many radians each tick
+static const double reference_orbit_radius = 1000;
+static const double reference_mean_motion = 0.01;
+
+/*
+ * Keplerian orbit of a body around its parent, the
+ * angles are in radians and the time unit is the tick.
+ */
+struct orbital_elements
+{
+    body_handle parent;
+    double      semi_major_axis,
+                eccentricity,
+    //Angle of the periapsis from the x axis
+                argument_of_periapsis,
+    //Mean anomaly at tick 0
+                mean_anomaly,
+    //Radians per tick
+                mean_motion;
+
+    orbital_elements() :
+        semi_major_axis{0},
+        eccentricity{0},
+        argument_of_periapsis{0},
+        mean_anomaly{0},
+        mean_motion{0}
+    {}
+};
+
+/*
+ * Offsets from the parent of 'count' orbits at the given
+ * time, the elements are in separate arrays. The semi minor
+ * axis and the periapsis rotation are precomputed. There is
+ * an avx2 kernel, the other instruction sets use the scalar.
+ */
+void solve_orbits(simd_kernel kernel,
+                  std::size_t count,
+                  double time,
+                  const double* semi_major,
+                  const double* semi_minor,
+                  const double* eccentricity,
+                  const double* cos_periapsis,
+                  const double* sin_periapsis,
+                  const double* mean_anomaly,
+                  const double* mean_motion,
+                  double* offset_x,
+                  double* offset_y);
+
+/*
+ * The orbiting bodies of a universe map, each tick all the
+ * orbits are solved in one batch over the arrays of the
+ * elements and the bodies are moved in the map at once.
+ * The parents are read at the beginning of the tick: a body
+ * orbiting an orbiting body follows it one tick late.
+ */
+class orbit_system
+{
+    std::vector<body_handle> bodies,
+                             parents;
+    std::vector<double>      semi_major,
+                             semi_minor,
+                             eccentricity,
+                             cos_periapsis,
+                             sin_periapsis,
+                             mean_anomaly,
+                             mean_motion;
+    //Scratch arrays of the tick
+    std::vector<double>      offset_x,
+                             offset_y;
+    std::vector<object_coordinates> new_positions;
+    //From the body handle id to its orbit
+    std::unordered_map<uint64_t,uint32_t> orbit_of;
+    simd_kernel                   kernel;
+    game_workers::worker_pool_ptr workers;
+public:
+    orbit_system();
+    void set_worker_pool(game_workers::worker_pool_ptr worker_pool);
+    void set_kernel(simd_kernel new_kernel);
+
+    //An orbiting body receives new elements
+    bool add_orbit(const body_handle& body,
+                   const orbital_elements& elements);
+    bool remove_orbit(const body_handle& body);
+    uint32_t get_orbits_count() const;
+    /*
+     * Put each planet of the chart on a circular orbit around
+     * its nearest star, passing where the planet is at the tick.
+     * Return the amount of orbits added.
+     */
+    uint32_t add_planet_orbits(const universe_map& star_chart,
+                               long long tick);
+
+    void solve(double time);
+    /*
+     * Move the bodies to their position at the tick, the orbits
+     * of the bodies removed from the map are dropped. Return
+     * the amount of bodies moved.
+     */
+    uint32_t advance(universe_map& star_chart,
+                     long long tick);
+};
+
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef PATH_SEARCH_HPP
+#define PATH_SEARCH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace game_maps
+{
+
+//Previous node of the node a search starts from
+static const uint32_t search_start = UINT32_MAX;
+
+struct open_node
+{
+    double   estimate,
+             cost;
+    uint32_t node;
+    bool operator<(const open_node& other) const{
+        return estimate > other.estimate;
+    }
+};
+
+/*
+ * State of the searches of a thread, a node belongs
+ * to the current search only if its stamp matches
+ */
+struct search_state
+{
+    std::vector<double>    cost;
+    std::vector<uint32_t>  previous,
+                           stamps;
+    std::vector<open_node> open;
+    uint32_t               stamp{0};
+
+    void prepare(std::size_t nodes_count){
+        if(stamps.size() < nodes_count){
+            cost.resize(nodes_count);
+            previous.resize(nodes_count);
+            stamps.assign(nodes_count,0);
+            stamp = 0;
+        }
+        if(++stamp == 0){
+            std::fill(stamps.begin(),stamps.end(),0);
+            stamp = 1;
+        }
+        open.clear();
+    }
+    bool reached(uint32_t node) const{
+        return stamps[node] == stamp;
+    }
+    //Nodes from the start of the search to 'last'
+    void path_to(uint32_t last,std::vector<uint32_t>& path) const{
+        path.clear();
+        for(uint32_t node{last};node != search_start;node = previous[node]){
+            path.push_back(node);
+        }
+        std::reverse(path.begin(),path.end());
+    }
+};
+
+//The searches of a thread share its state, the results stay there until the next one
+inline search_state& thread_search_state()
+{
+    thread_local search_state state;
+    return state;
+}
+
+/*
+ * Dijkstra, or A* when the estimate is not zero. expand(node,relax)
+ * calls relax(next,length) for the neighbors of the node to follow,
+ * the search stops when settle(node) returns true. The costs and the
+ * previous nodes are left in the search state of the thread.
+ */
+template<typename EXPAND,typename ESTIMATE,typename SETTLE>
+void best_first(std::size_t nodes_count,
+                uint32_t from,
+                EXPAND&& expand,
+                ESTIMATE&& estimate,
+                SETTLE&& settle)
+{
+    //The thread local is looked up once
+    search_state& state = thread_search_state();
+    state.prepare(nodes_count);
+    state.cost[from] = 0;
+    state.previous[from] = search_start;
+    state.stamps[from] = state.stamp;
+    state.open.push_back({estimate(from),0,from});
+    while(!state.open.empty()){
+        std::pop_heap(state.open.begin(),state.open.end());
+        open_node current = state.open.back();
+        state.open.pop_back();
+        if(current.cost > state.cost[current.node])
+            continue;
+        if(settle(current.node))
+            return;
+        expand(current.node,[&state,&current,&estimate](uint32_t next,double length){
+            double cost = current.cost + length;
+            if(state.reached(next) && state.cost[next] <= cost)
+                return;
+            state.stamps[next] = state.stamp;
+            state.cost[next] = cost;
+            state.previous[next] = current.node;
+            state.open.push_back({cost + estimate(next),cost,next});
+            std::push_heap(state.open.begin(),state.open.end());
+        });
+    }
+}
+
+}
+
+#endif
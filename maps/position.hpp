@@ -17,6 +17,117 @@ struct object_coordinates
     {}
 };
 
+/*
+ * Rectangular portion of the universe,
+ * both the boundaries are inclusive.
+ */
+struct object_area
+{
+    uint32_t x_from,
+             x_to,
+             y_from,
+             y_to;
+    object_area(uint32_t x_from_coord = 0,
+                uint32_t x_to_coord = 0,
+                uint32_t y_from_coord = 0,
+                uint32_t y_to_coord = 0) :
+        x_from{x_from_coord},
+        x_to{x_to_coord},
+        y_from{y_from_coord},
+        y_to{y_to_coord}
+    {}
+
+    bool contains(const object_coordinates& point) const{
+        return point.x >= x_from && point.x <= x_to &&
+               point.y >= y_from && point.y <= y_to;
+    }
+};
+
+/*
+ * Universes wider than 2^32 units are split in square
+ * sectors of 2^sector_bits units per side. A body is placed
+ * by its sector and by its offset within the sector, so the
+ * math on the bodies of a sector stays on 32 bit integers.
+ */
+struct sector_id
+{
+    uint32_t x,
+             y;
+    sector_id(uint32_t sector_x = 0,
+              uint32_t sector_y = 0) :
+        x{sector_x},
+        y{sector_y}
+    {}
+
+    uint64_t key() const{
+        return (uint64_t(y) << 32) | x;
+    }
+    bool operator==(const sector_id& other) const{
+        return x == other.x && y == other.y;
+    }
+    bool operator!=(const sector_id& other) const{
+        return !(*this == other);
+    }
+};
+
+struct sector_coordinates
+{
+    sector_id          sector;
+    object_coordinates offset;
+    sector_coordinates(const sector_id& body_sector = sector_id(),
+                       const object_coordinates& sector_offset = object_coordinates()) :
+        sector{body_sector},
+        offset{sector_offset}
+    {}
+};
+
+//Absolute position in a universe made of sectors
+struct world_coordinates
+{
+    uint64_t x,
+             y;
+    world_coordinates(uint64_t x_coord = 0,
+                      uint64_t y_coord = 0) :
+        x{x_coord},
+        y{y_coord}
+    {}
+};
+
+//Both the boundaries are inclusive
+struct world_area
+{
+    uint64_t x_from,
+             x_to,
+             y_from,
+             y_to;
+    world_area(uint64_t x_from_coord = 0,
+               uint64_t x_to_coord = 0,
+               uint64_t y_from_coord = 0,
+               uint64_t y_to_coord = 0) :
+        x_from{x_from_coord},
+        x_to{x_to_coord},
+        y_from{y_from_coord},
+        y_to{y_to_coord}
+    {}
+};
+
+inline sector_coordinates to_sector_coordinates(const world_coordinates& position,
+                                                uint32_t sector_bits)
+{
+    uint64_t offset_mask = (uint64_t(1) << sector_bits) - 1;
+    return sector_coordinates(sector_id(uint32_t(position.x >> sector_bits),
+                                        uint32_t(position.y >> sector_bits)),
+                              object_coordinates(uint32_t(position.x & offset_mask),
+                                                 uint32_t(position.y & offset_mask)));
+}
+
+inline world_coordinates to_world_coordinates(const sector_coordinates& position,
+                                              uint32_t sector_bits)
+{
+    return world_coordinates((uint64_t(position.sector.x) << sector_bits) | position.offset.x,
+                             (uint64_t(position.sector.y) << sector_bits) | position.offset.y);
+}
+
 }
 
 #endif
@@ -0,0 +1,391 @@
+#include "../logger/logger.hpp"
+#include "quadtree.hpp"
+#include "morton.hpp"
+#include <algorithm>
+
+namespace game_maps
+{
+
+/*
+ * The root is the smallest power of two square
+ * containing the whole universe, the deepest leaves
+ * have size 1
+ */
+loose_quadtree::loose_quadtree(uint32_t universe_width,
+                               uint32_t universe_height,
+                               uint32_t capacity) :
+    node_capacity{std::max<uint32_t>(1,capacity)},
+    max_depth{0}
+{
+    uint64_t root_size{1};
+    while(root_size < std::max(universe_width,universe_height)){
+        root_size *= 2;
+        ++max_depth;
+    }
+    nodes.push_back({0,0,root_size,0,no_node,no_node,0,{}});
+    LOG3("Loose quadtree ready, root size ",root_size,
+         ", max depth ",max_depth,", node capacity ",node_capacity);
+}
+
+bool loose_quadtree::is_leaf(uint32_t node) const
+{
+    return nodes[node].first_child == no_node;
+}
+
+uint32_t loose_quadtree::child_for(uint32_t node,
+                                   const object_coordinates& position) const
+{
+    const auto& parent = nodes[node];
+    uint64_t half = parent.size / 2;
+    uint32_t quadrant = (position.x >= parent.x_from + half ? 1 : 0) +
+                        (position.y >= parent.y_from + half ? 2 : 0);
+    return parent.first_child + quadrant;
+}
+
+bool loose_quadtree::within_loose_bounds(uint32_t node,
+                                         const object_coordinates& position) const
+{
+    const auto& current = nodes[node];
+    int64_t half = current.size / 2;
+    return int64_t(position.x) >= int64_t(current.x_from) - half &&
+           int64_t(position.x) < int64_t(current.x_from + current.size) + half &&
+           int64_t(position.y) >= int64_t(current.y_from) - half &&
+           int64_t(position.y) < int64_t(current.y_from + current.size) + half;
+}
+
+void loose_quadtree::update_subtree_count(uint32_t node,int32_t change)
+{
+    while(node != no_node){
+        nodes[node].subtree_bodies += change;
+        node = nodes[node].parent;
+    }
+}
+
+void loose_quadtree::insert_entry(const quadtree_entry& entry)
+{
+    object_coordinates position(entry.x,entry.y);
+    uint32_t node{0};
+    while(!is_leaf(node)){
+        node = child_for(node,position);
+    }
+    add_to_leaf(node,entry);
+}
+
+void loose_quadtree::add_to_leaf(uint32_t leaf,const quadtree_entry& entry)
+{
+    nodes[leaf].entries.push_back(entry);
+    body_node[entry.body_index] = leaf;
+    update_subtree_count(leaf,1);
+    if(nodes[leaf].entries.size() > node_capacity &&
+       nodes[leaf].depth < max_depth){
+        split(leaf);
+    }
+}
+
+/*
+ * Children are always allocated in groups of four,
+ * released groups are reused before growing the pool.
+ */
+uint32_t loose_quadtree::allocate_children(uint32_t parent)
+{
+    uint32_t first_child;
+    if(!free_nodes.empty()){
+        first_child = free_nodes.back();
+        free_nodes.pop_back();
+    }else{
+        first_child = nodes.size();
+        nodes.resize(nodes.size() + 4);
+    }
+    const auto& parent_node = nodes[parent];
+    uint64_t half = parent_node.size / 2;
+    for(uint32_t quadrant{0};quadrant < 4;++quadrant){
+        auto& child = nodes[first_child + quadrant];
+        child.x_from = parent_node.x_from + (quadrant & 1) * half;
+        child.y_from = parent_node.y_from + (quadrant >> 1) * half;
+        child.size = half;
+        child.depth = parent_node.depth + 1;
+        child.parent = parent;
+        child.first_child = no_node;
+        child.subtree_bodies = 0;
+        child.entries.clear();
+    }
+    return first_child;
+}
+
+/*
+ * Move the entries of the leaf to its new children,
+ * the entries which moved outside the tight bounds of the
+ * leaf may not fit the loose bounds of any child and are
+ * inserted again from the root.
+ */
+void loose_quadtree::split(uint32_t node)
+{
+    uint32_t first_child = allocate_children(node);
+    nodes[node].first_child = first_child;
+    std::vector<quadtree_entry> entries;
+    entries.swap(nodes[node].entries);
+
+    std::vector<quadtree_entry> strays;
+    const uint64_t x_from = nodes[node].x_from,
+                   y_from = nodes[node].y_from,
+                   size = nodes[node].size;
+    for(const auto& entry : entries){
+        if(entry.x < x_from || entry.x >= x_from + size ||
+           entry.y < y_from || entry.y >= y_from + size){
+            strays.push_back(entry);
+            continue;
+        }
+        uint32_t child = child_for(node,object_coordinates(entry.x,entry.y));
+        nodes[child].entries.push_back(entry);
+        ++nodes[child].subtree_bodies;
+        body_node[entry.body_index] = child;
+    }
+    for(uint32_t child{first_child};child < first_child + 4;++child){
+        if(nodes[child].entries.size() > node_capacity &&
+           nodes[child].depth < max_depth){
+            split(child);
+        }
+    }
+    if(!strays.empty()){
+        update_subtree_count(node,-int32_t(strays.size()));
+        for(const auto& entry : strays){
+            insert_entry(entry);
+        }
+    }
+}
+
+template<typename FUNC>
+void loose_quadtree::visit_subtree(uint32_t node,FUNC&& func) const
+{
+    uint32_t pending[max_pending_nodes],
+             pending_count{0};
+    pending[pending_count++] = node;
+    while(pending_count > 0){
+        uint32_t current = pending[--pending_count];
+        if(is_leaf(current)){
+            for(const auto& entry : nodes[current].entries){
+                func(entry);
+            }
+        }else{
+            for(uint32_t child{0};child < 4;++child){
+                pending[pending_count++] = nodes[current].first_child + child;
+            }
+        }
+    }
+}
+
+/*
+ * Turn the node back into a leaf holding all
+ * the entries of its subtree
+ */
+void loose_quadtree::collapse(uint32_t node)
+{
+    std::vector<quadtree_entry> entries;
+    visit_subtree(node,[&entries](const quadtree_entry& entry){
+        entries.push_back(entry);
+    });
+
+    std::vector<uint32_t> pending{node};
+    while(!pending.empty()){
+        uint32_t current = pending.back();
+        pending.pop_back();
+        uint32_t first_child = nodes[current].first_child;
+        if(first_child == no_node)
+            continue;
+        for(uint32_t child{first_child};child < first_child + 4;++child){
+            pending.push_back(child);
+        }
+        nodes[current].first_child = no_node;
+        nodes[current].entries.clear();
+        free_nodes.push_back(first_child);
+    }
+
+    for(const auto& entry : entries){
+        body_node[entry.body_index] = node;
+    }
+    nodes[node].entries = std::move(entries);
+}
+
+void loose_quadtree::insert(uint32_t body_index,
+                            const object_coordinates& position)
+{
+    if(body_node.size() <= body_index){
+        body_node.resize(body_index + 1,no_node);
+    }
+    insert_entry({position.x,position.y,body_index});
+}
+
+/*
+ * After the removal the highest ancestor whose subtree
+ * contains no more than half of the node capacity
+ * is collapsed into a leaf.
+ */
+void loose_quadtree::erase(uint32_t body_index,
+                           const object_coordinates& /*position*/)
+{
+    if(body_index >= body_node.size() || body_node[body_index] == no_node){
+        WARN1("Body ",body_index," not found in the quadtree!");
+        return;
+    }
+    uint32_t leaf = body_node[body_index];
+    auto& entries = nodes[leaf].entries;
+    auto entry_it = std::find_if(entries.begin(),entries.end(),
+                                 [body_index](const quadtree_entry& entry){
+        return entry.body_index == body_index;
+    });
+    if(entry_it == entries.end()){
+        WARN1("Body ",body_index," not found in its quadtree node!");
+        return;
+    }
+    *entry_it = entries.back();
+    entries.pop_back();
+    body_node[body_index] = no_node;
+    update_subtree_count(leaf,-1);
+
+    uint32_t merge_node{no_node};
+    for(uint32_t node{nodes[leaf].parent};node != no_node;node = nodes[node].parent){
+        if(nodes[node].subtree_bodies > node_capacity / 2)
+            break;
+        merge_node = node;
+    }
+    if(merge_node != no_node){
+        collapse(merge_node);
+    }
+}
+
+void loose_quadtree::relocate(uint32_t body_index,
+                              const object_coordinates& old_position,
+                              const object_coordinates& new_position)
+{
+    if(body_index < body_node.size() && body_node[body_index] != no_node &&
+       within_loose_bounds(body_node[body_index],new_position)){
+        for(auto& entry : nodes[body_node[body_index]].entries){
+            if(entry.body_index == body_index){
+                entry.x = new_position.x;
+                entry.y = new_position.y;
+                return;
+            }
+        }
+    }
+    erase(body_index,old_position);
+    insert(body_index,new_position);
+}
+
+void loose_quadtree::clear()
+{
+    nodes.resize(1);
+    nodes[0].first_child = no_node;
+    nodes[0].subtree_bodies = 0;
+    nodes[0].entries.clear();
+    free_nodes.clear();
+    body_node.clear();
+}
+
+/*
+ * Bottom up construction, the bodies sorted by Z-order code are
+ * packed in the leaves: the bodies of each node are a contiguous
+ * range of the sorted entries and the quadrant of a child is
+ * given by two bits of the code.
+ */
+void loose_quadtree::build(const uint32_t* x,
+                           const uint32_t* y,
+                           uint32_t count,
+                           game_workers::worker_pool* workers)
+{
+    clear();
+    body_node.assign(count,no_node);
+    std::vector<coded_entry> sorted_entries(count);
+    auto encode = [&sorted_entries,x,y](std::size_t first,std::size_t last){
+        for(std::size_t body_index{first};body_index < last;++body_index){
+            object_coordinates position(x[body_index],y[body_index]);
+            sorted_entries[body_index] = {morton_encode(position),
+                                          {position.x,position.y,uint32_t(body_index)}};
+        }
+    };
+    if(workers){
+        workers->parallel_for(count,encode);
+    }else{
+        encode(0,count);
+    }
+    game_workers::parallel_sort(workers,sorted_entries.begin(),sorted_entries.end(),
+                                [](const coded_entry& first,const coded_entry& second){
+        return first.code < second.code;
+    });
+    build_subtree(0,sorted_entries,0,count);
+}
+
+void loose_quadtree::build_subtree(uint32_t node,
+                                   const std::vector<coded_entry>& sorted_entries,
+                                   std::size_t from,
+                                   std::size_t to)
+{
+    nodes[node].subtree_bodies = to - from;
+    if(to - from <= node_capacity || nodes[node].depth == max_depth){
+        for(std::size_t idx{from};idx < to;++idx){
+            nodes[node].entries.push_back(sorted_entries[idx].entry);
+            body_node[sorted_entries[idx].entry.body_index] = node;
+        }
+        return;
+    }
+    uint32_t first_child = allocate_children(node);
+    nodes[node].first_child = first_child;
+    uint32_t quadrant_shift = 2 * (max_depth - nodes[node].depth - 1);
+    std::size_t child_from{from};
+    for(uint32_t quadrant{0};quadrant < 4;++quadrant){
+        auto child_to = std::partition_point(sorted_entries.begin() + child_from,
+                                             sorted_entries.begin() + to,
+                                             [quadrant_shift,quadrant](const coded_entry& entry){
+            return ((entry.code >> quadrant_shift) & 3) <= quadrant;
+        }) - sorted_entries.begin();
+        build_subtree(first_child + quadrant,sorted_entries,child_from,child_to);
+        child_from = child_to;
+    }
+}
+
+/*
+ * Nodes are visited if their loose bounds intersect the
+ * area, subtrees whose loose bounds are completely within
+ * the area are reported without checking each body.
+ */
+void loose_quadtree::query(const object_area& area,
+                           body_visitor visitor) const
+{
+    if(area.x_from > area.x_to || area.y_from > area.y_to)
+        return;
+    uint32_t pending[max_pending_nodes],
+             pending_count{0};
+    pending[pending_count++] = 0;
+    while(pending_count > 0){
+        uint32_t node = pending[--pending_count];
+        const auto& current = nodes[node];
+        if(current.subtree_bodies == 0)
+            continue;
+        int64_t half = current.size / 2,
+                loose_x_from = int64_t(current.x_from) - half,
+                loose_x_to = int64_t(current.x_from + current.size) + half - 1,
+                loose_y_from = int64_t(current.y_from) - half,
+                loose_y_to = int64_t(current.y_from + current.size) + half - 1;
+        if(loose_x_to < area.x_from || loose_x_from > area.x_to ||
+           loose_y_to < area.y_from || loose_y_from > area.y_to)
+            continue;
+        if(loose_x_from >= area.x_from && loose_x_to <= area.x_to &&
+           loose_y_from >= area.y_from && loose_y_to <= area.y_to){
+            visit_subtree(node,[&visitor](const quadtree_entry& entry){
+                visitor(entry.body_index);
+            });
+        }else if(is_leaf(node)){
+            for(const auto& entry : current.entries){
+                if(entry.x >= area.x_from && entry.x <= area.x_to &&
+                   entry.y >= area.y_from && entry.y <= area.y_to){
+                    visitor(entry.body_index);
+                }
+            }
+        }else{
+            for(uint32_t child{0};child < 4;++child){
+                pending[pending_count++] = current.first_child + child;
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,109 @@
+#ifndef QUADTREE_HPP
+#define QUADTREE_HPP
+
+#include "spatial_index.hpp"
+
+namespace game_maps
+{
+
+using namespace coordinates;
+
+static const uint32_t default_quadtree_node_capacity = 16;
+
+/*
+ * Loose quadtree over the universe, the bodies are stored
+ * in the leaves and each node accepts bodies whose position
+ * is within its loose bounds (the node square enlarged by
+ * half of its size in each direction). A body moving
+ * inside those bounds is updated in place, only bigger
+ * movements need an erase and an insert.
+ *
+ * Leaves holding more than node_capacity bodies are split,
+ * nodes whose subtree shrinks below half of the capacity are
+ * merged back, this keeps the depth proportional to log N
+ * also in very dense clusters.
+ */
+class loose_quadtree : public spatial_index
+{
+    struct quadtree_entry
+    {
+        uint32_t x,
+                 y,
+                 body_index;
+    };
+
+    //Entry with the Z-order code of its position, used by the bulk build
+    struct coded_entry
+    {
+        uint64_t       code;
+        quadtree_entry entry;
+    };
+
+    struct quadtree_node
+    {
+        //Tight bounds of the node
+        uint64_t x_from,
+                 y_from,
+                 size;
+        uint32_t depth,
+                 parent,
+                 first_child,
+                 subtree_bodies;
+        std::vector<quadtree_entry> entries;
+    };
+
+    static constexpr uint32_t no_node = UINT32_MAX;
+    //The depth never exceed 32, a depth first walk
+    //never has more than this amount of pending nodes.
+    static constexpr uint32_t max_pending_nodes = 3 * 32 + 4;
+
+    uint32_t node_capacity,
+             max_depth;
+    std::vector<quadtree_node> nodes;
+    //Index of the first node of the released groups of children
+    std::vector<uint32_t> free_nodes;
+    //Leaf containing each body
+    std::vector<uint32_t> body_node;
+
+    bool is_leaf(uint32_t node) const;
+    uint32_t child_for(uint32_t node,
+                       const object_coordinates& position) const;
+    bool within_loose_bounds(uint32_t node,
+                             const object_coordinates& position) const;
+    void update_subtree_count(uint32_t node,int32_t change);
+    void insert_entry(const quadtree_entry& entry);
+    void add_to_leaf(uint32_t leaf,const quadtree_entry& entry);
+    uint32_t allocate_children(uint32_t parent);
+    void split(uint32_t node);
+    void collapse(uint32_t node);
+    void build_subtree(uint32_t node,
+                       const std::vector<coded_entry>& sorted_entries,
+                       std::size_t from,
+                       std::size_t to);
+    template<typename FUNC>
+    void visit_subtree(uint32_t node,FUNC&& func) const;
+public:
+    loose_quadtree(uint32_t universe_width,
+                   uint32_t universe_height,
+                   uint32_t capacity = default_quadtree_node_capacity);
+    void insert(uint32_t body_index,
+                const object_coordinates& position);
+    void erase(uint32_t body_index,
+               const object_coordinates& position);
+    void relocate(uint32_t body_index,
+                  const object_coordinates& old_position,
+                  const object_coordinates& new_position);
+    void clear();
+    void build(const uint32_t* x,
+               const uint32_t* y,
+               uint32_t count,
+               game_workers::worker_pool* workers);
+
+    //The queries do not allocate
+    void query(const object_area& area,
+               body_visitor visitor) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,471 @@
+#include "../logger/logger.hpp"
+#include "route_hierarchy.hpp"
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <tuple>
+#include <unordered_map>
+
+namespace game_maps
+{
+
+namespace
+{
+
+//Clusters linked by each job of the build
+const std::size_t clusters_per_chunk = 8;
+//Deeper clusters would be smaller than a universe unit
+const uint32_t cluster_max_depth = 32;
+const double unreachable = std::numeric_limits<double>::infinity();
+
+}
+
+hierarchical_route::hierarchical_route() :
+    refined_segments{0},
+    length{0}
+{}
+
+bool hierarchical_route::found() const
+{
+    return !waypoints.empty();
+}
+
+double hierarchical_route::get_length() const
+{
+    return length;
+}
+
+std::size_t hierarchical_route::get_segments_count() const
+{
+    return waypoints.empty() ? 0 : waypoints.size() - 1;
+}
+
+std::size_t hierarchical_route::get_refined_segments() const
+{
+    return refined_segments;
+}
+
+const std::vector<uint32_t>& hierarchical_route::get_waypoints() const
+{
+    return waypoints;
+}
+
+const std::vector<body_handle>& hierarchical_route::refine(std::size_t segments)
+{
+    std::size_t last_segment = std::min(get_segments_count(),refined_segments + segments);
+    std::vector<uint32_t> path;
+    for(;refined_segments < last_segment;++refined_segments){
+        if(hierarchy->refine_segment(waypoints[refined_segments],
+                                     waypoints[refined_segments + 1],path) < 0){
+            WARN1("Unable to refine the segment ",refined_segments," of a route");
+            break;
+        }
+        auto graph = hierarchy->get_graph();
+        for(std::size_t star{1};star < path.size();++star){
+            refined_stars.push_back(graph->get_star_handle(path[star]));
+        }
+    }
+    return refined_stars;
+}
+
+const std::vector<body_handle>& hierarchical_route::refine_all()
+{
+    return refine(get_segments_count());
+}
+
+const std::vector<body_handle>& hierarchical_route::get_refined_stars() const
+{
+    return refined_stars;
+}
+
+route_hierarchy::route_hierarchy() :
+    cluster_capacity{default_route_cluster_stars}
+{}
+
+void route_hierarchy::configure(game_configuration::game_config_ptr game_conf)
+{
+    std::string option = game_conf->get_option("route_cluster_stars");
+    if(!option.empty()){
+        set_cluster_capacity(std::stoul(option));
+    }
+}
+
+void route_hierarchy::set_worker_pool(game_workers::worker_pool_ptr worker_pool)
+{
+    workers = worker_pool;
+}
+
+void route_hierarchy::set_cluster_capacity(uint32_t max_stars)
+{
+    if(max_stars == 0){
+        WARN1("The route clusters shall hold at least one star");
+        return;
+    }
+    cluster_capacity = max_stars;
+}
+
+/*
+ * The clusters are appended in the order of their ranges,
+ * so the ordered stars are already grouped by cluster
+ */
+void route_hierarchy::build_clusters()
+{
+    uint32_t stars_count = graph->get_stars_count();
+    star_cluster.resize(stars_count);
+    cluster_stars.resize(stars_count);
+    cluster_offsets.assign(1,0);
+    double min_x{0},max_x{0},min_y{0},max_y{0};
+    for(uint32_t star{0};star < stars_count;++star){
+        cluster_stars[star] = star;
+        double x = graph->get_star_x(star),
+               y = graph->get_star_y(star);
+        min_x = star == 0 ? x : std::min(min_x,x);
+        max_x = star == 0 ? x : std::max(max_x,x);
+        min_y = star == 0 ? y : std::min(min_y,y);
+        max_y = star == 0 ? y : std::max(max_y,y);
+    }
+    double half_size = std::max(max_x - min_x,max_y - min_y) / 2 + 1;
+    split_cluster(cluster_stars.begin(),cluster_stars.end(),
+                  (min_x + max_x) / 2,(min_y + max_y) / 2,half_size,0);
+}
+
+void route_hierarchy::split_cluster(std::vector<uint32_t>::iterator first,
+                                    std::vector<uint32_t>::iterator last,
+                                    double center_x,
+                                    double center_y,
+                                    double half_size,
+                                    uint32_t depth)
+{
+    uint32_t count = last - first;
+    if(count == 0)
+        return;
+    if(count <= cluster_capacity || depth == cluster_max_depth){
+        uint32_t cluster = cluster_offsets.size() - 1;
+        for(auto star = first;star != last;++star){
+            star_cluster[*star] = cluster;
+        }
+        cluster_offsets.push_back(cluster_offsets.back() + count);
+        return;
+    }
+    auto west = [this,center_x](uint32_t star){
+        return graph->get_star_x(star) < center_x;
+    };
+    auto north = [this,center_y](uint32_t star){
+        return graph->get_star_y(star) < center_y;
+    };
+    auto middle = std::partition(first,last,west);
+    std::array<decltype(first),5> bounds{{first,std::partition(first,middle,north),
+                                          middle,std::partition(middle,last,north),last}};
+    double child_size = half_size / 2;
+    for(uint32_t quadrant{0};quadrant < 4;++quadrant){
+        split_cluster(bounds[quadrant],bounds[quadrant + 1],
+                      center_x + (quadrant < 2 ? -child_size : child_size),
+                      center_y + (quadrant % 2 == 0 ? -child_size : child_size),
+                      child_size,depth + 1);
+    }
+}
+
+void route_hierarchy::cluster_distances(uint32_t star,
+                                        std::vector<std::pair<uint32_t,double>>& distances) const
+{
+    distances.clear();
+    uint32_t cluster = star_cluster[star],
+             missing_borders{0};
+    for(uint32_t position{cluster_offsets[cluster]};position < cluster_offsets[cluster + 1];++position){
+        missing_borders += border_of[cluster_stars[position]] != no_star;
+    }
+    auto expand = [this,cluster](uint32_t node,auto&& relax){
+        for(uint32_t lane{graph->get_first_lane(node)};lane < graph->get_last_lane(node);++lane){
+            uint32_t next = graph->get_lane_target(lane);
+            if(star_cluster[next] == cluster)
+                relax(next,graph->get_lane_length(lane));
+        }
+    };
+    auto settle = [this,&distances,&missing_borders](uint32_t node){
+        if(border_of[node] != no_star){
+            distances.emplace_back(node,thread_search_state().cost[node]);
+            --missing_borders;
+        }
+        return missing_borders == 0;
+    };
+    best_first(graph->get_stars_count(),star,expand,[](uint32_t){ return 0.0; },settle);
+}
+
+/*
+ * The links within a cluster are searched from each of
+ * its border stars, the clusters are spread across the workers
+ */
+void route_hierarchy::link_borders()
+{
+    uint32_t stars_count = graph->get_stars_count();
+    border_of.assign(stars_count,no_star);
+    border_stars.clear();
+    for(uint32_t star{0};star < stars_count;++star){
+        for(uint32_t lane{graph->get_first_lane(star)};lane < graph->get_last_lane(star);++lane){
+            if(star_cluster[graph->get_lane_target(lane)] != star_cluster[star]){
+                border_of[star] = border_stars.size();
+                border_stars.push_back(star);
+                break;
+            }
+        }
+    }
+    using border_link = std::tuple<uint32_t,uint32_t,double>;
+    uint32_t clusters_count = get_clusters_count();
+    std::vector<std::vector<border_link>> cluster_links(clusters_count);
+    auto link_clusters = [this,&cluster_links](std::size_t first,std::size_t last){
+        std::vector<std::pair<uint32_t,double>> distances;
+        std::vector<uint32_t> borders;
+        std::vector<double> shortest;
+        std::unordered_map<uint32_t,uint32_t> local_of;
+        for(std::size_t cluster{first};cluster < last;++cluster){
+            borders.clear();
+            local_of.clear();
+            for(uint32_t position{cluster_offsets[cluster]};position < cluster_offsets[cluster + 1];++position){
+                uint32_t star = cluster_stars[position];
+                if(border_of[star] != no_star){
+                    local_of[star] = borders.size();
+                    borders.push_back(star);
+                }
+            }
+            std::size_t count = borders.size();
+            shortest.assign(count * count,-1);
+            for(std::size_t border{0};border < count;++border){
+                cluster_distances(borders[border],distances);
+                for(auto& other : distances){
+                    shortest[border * count + local_of[other.first]] = other.second;
+                }
+                for(uint32_t lane{graph->get_first_lane(borders[border])};
+                    lane < graph->get_last_lane(borders[border]);++lane){
+                    uint32_t next = graph->get_lane_target(lane);
+                    if(star_cluster[next] != cluster)
+                        cluster_links[cluster].emplace_back(border_of[borders[border]],border_of[next],
+                                                            graph->get_lane_length(lane));
+                }
+            }
+            /*
+             * A link is dropped when a third border star is on a path
+             * as short, both parts are shorter links: the routes stay
+             * exact and the abstract search relaxes fewer links
+             */
+            for(std::size_t from{0};from < count;++from){
+                for(std::size_t to{0};to < count;++to){
+                    double length = shortest[from * count + to];
+                    if(from == to || length < 0)
+                        continue;
+                    bool redundant{false};
+                    for(std::size_t middle{0};middle < count && !redundant;++middle){
+                        double first_part = shortest[from * count + middle],
+                               second_part = shortest[middle * count + to];
+                        redundant = first_part > 0 && second_part > 0 &&
+                                    first_part + second_part <= length * (1 + 1e-12);
+                    }
+                    if(!redundant)
+                        cluster_links[cluster].emplace_back(border_of[borders[from]],border_of[borders[to]],length);
+                }
+            }
+        }
+    };
+    if(workers){
+        workers->parallel_for(clusters_count,link_clusters,clusters_per_chunk);
+    }else{
+        link_clusters(0,clusters_count);
+    }
+    border_offsets.assign(border_stars.size() + 1,0);
+    for(auto& links : cluster_links){
+        for(auto& link : links){
+            ++border_offsets[std::get<0>(link) + 1];
+        }
+    }
+    for(std::size_t border{1};border < border_offsets.size();++border){
+        border_offsets[border] += border_offsets[border - 1];
+    }
+    border_targets.resize(border_offsets.back());
+    border_lengths.resize(border_offsets.back());
+    std::vector<uint32_t> next_link(border_offsets.begin(),border_offsets.end() - 1);
+    for(auto& links : cluster_links){
+        for(auto& link : links){
+            uint32_t position = next_link[std::get<0>(link)]++;
+            border_targets[position] = std::get<1>(link);
+            border_lengths[position] = std::get<2>(link);
+        }
+    }
+}
+
+/*
+ * Each landmark is the border star farthest from the landmarks
+ * already selected, the unreachable ones first: the landmarks
+ * end up on the edges of the galaxy and in each component.
+ */
+void route_hierarchy::select_landmarks()
+{
+    uint32_t borders_count = border_stars.size();
+    landmark_distances.assign(std::size_t(borders_count) * route_landmarks,unreachable);
+    if(borders_count == 0)
+        return;
+    std::vector<double> closest_landmark(borders_count,unreachable);
+    auto expand = [this](uint32_t node,auto&& relax){
+        for(uint32_t link{border_offsets[node]};link < border_offsets[node + 1];++link){
+            relax(border_targets[link],border_lengths[link]);
+        }
+    };
+    uint32_t landmark{0};
+    for(uint32_t selected{0};selected < route_landmarks;++selected){
+        best_first(borders_count,landmark,expand,[](uint32_t){ return 0.0; },[](uint32_t){ return false; });
+        const search_state& state = thread_search_state();
+        for(uint32_t border{0};border < borders_count;++border){
+            if(state.reached(border)){
+                landmark_distances[std::size_t(border) * route_landmarks + selected] = state.cost[border];
+                closest_landmark[border] = std::min(closest_landmark[border],state.cost[border]);
+            }
+        }
+        landmark = std::max_element(closest_landmark.begin(),closest_landmark.end()) -
+                   closest_landmark.begin();
+    }
+}
+
+void route_hierarchy::build(hyperlane_graph_ptr hyperlanes)
+{
+    graph = hyperlanes;
+    LOG3("Building the route hierarchy of ",graph->get_stars_count()," stars");
+    build_clusters();
+    link_borders();
+    select_landmarks();
+    LOG3("The route hierarchy has ",get_clusters_count()," clusters, ",
+         border_stars.size()," border stars and ",border_targets.size()," links");
+}
+
+hyperlane_graph_ptr route_hierarchy::get_graph() const
+{
+    return graph;
+}
+
+uint32_t route_hierarchy::get_clusters_count() const
+{
+    return cluster_offsets.empty() ? 0 : cluster_offsets.size() - 1;
+}
+
+uint32_t route_hierarchy::get_border_stars_count() const
+{
+    return border_stars.size();
+}
+
+std::size_t route_hierarchy::get_border_links_count() const
+{
+    return border_targets.size();
+}
+
+/*
+ * The departure and the destination join the abstract graph as
+ * two more nodes, linked to the border stars of their clusters.
+ * In the same cluster they are also linked to each other.
+ */
+hierarchical_route route_hierarchy::find_route(const body_handle& from,
+                                               const body_handle& to) const
+{
+    hierarchical_route route;
+    route.hierarchy = shared_from_this();
+    if(!graph)
+        return route;
+    uint32_t from_star = graph->star_of_body(from),
+             to_star = graph->star_of_body(to);
+    if(from_star == no_star || to_star == no_star)
+        return route;
+    std::vector<std::pair<uint32_t,double>> departure_links,
+                                            destination_links;
+    cluster_distances(from_star,departure_links);
+    cluster_distances(to_star,destination_links);
+    std::unordered_map<uint32_t,double> destination_of_border;
+    for(auto& link : destination_links){
+        destination_of_border[border_of[link.first]] = link.second;
+    }
+    std::vector<uint32_t> path;
+    double direct_length{-1};
+    if(star_cluster[from_star] == star_cluster[to_star]){
+        direct_length = refine_segment(from_star,to_star,path);
+    }
+    const uint32_t departure = border_stars.size(),
+                   destination = departure + 1,
+                   destination_cluster = star_cluster[to_star];
+    auto star_of_node = [this,departure,destination,from_star,to_star](uint32_t node){
+        return node == departure ? from_star :
+               node == destination ? to_star : border_stars[node];
+    };
+    auto expand = [&](uint32_t node,auto&& relax){
+        if(node == departure){
+            for(auto& link : departure_links){
+                relax(border_of[link.first],link.second);
+            }
+            if(direct_length >= 0)
+                relax(destination,direct_length);
+            return;
+        }
+        for(uint32_t link{border_offsets[node]};link < border_offsets[node + 1];++link){
+            relax(border_targets[link],border_lengths[link]);
+        }
+        if(star_cluster[border_stars[node]] == destination_cluster){
+            auto destination_link = destination_of_border.find(node);
+            if(destination_link != destination_of_border.end())
+                relax(destination,destination_link->second);
+        }
+    };
+    std::array<double,route_landmarks> destination_landmarks;
+    destination_landmarks.fill(unreachable);
+    for(auto& link : destination_links){
+        const double* distances = &landmark_distances[std::size_t(border_of[link.first]) * route_landmarks];
+        for(uint32_t landmark{0};landmark < route_landmarks;++landmark){
+            destination_landmarks[landmark] = std::min(destination_landmarks[landmark],
+                                                       distances[landmark] + link.second);
+        }
+    }
+    //Triangle inequality on the distances from the landmarks
+    auto estimate = [&](uint32_t node){
+        if(node == destination)
+            return 0.0;
+        double bound = graph->distance(star_of_node(node),to_star);
+        if(node == departure)
+            return bound;
+        const double* distances = &landmark_distances[std::size_t(node) * route_landmarks];
+        for(uint32_t landmark{0};landmark < route_landmarks;++landmark){
+            if(distances[landmark] != unreachable && destination_landmarks[landmark] != unreachable)
+                bound = std::max(bound,std::abs(destination_landmarks[landmark] - distances[landmark]));
+        }
+        return bound;
+    };
+    best_first(border_stars.size() + 2,departure,expand,estimate,[destination](uint32_t node){
+        return node == destination;
+    });
+    const search_state& state = thread_search_state();
+    if(!state.reached(destination))
+        return route;
+    route.length = state.cost[destination];
+    state.path_to(destination,path);
+    for(uint32_t node : path){
+        uint32_t star = star_of_node(node);
+        if(route.waypoints.empty() || route.waypoints.back() != star)
+            route.waypoints.push_back(star);
+    }
+    route.refined_stars.push_back(graph->get_star_handle(from_star));
+    return route;
+}
+
+double route_hierarchy::refine_segment(uint32_t from_star,
+                                       uint32_t to_star,
+                                       std::vector<uint32_t>& path) const
+{
+    path.clear();
+    uint32_t cluster = star_cluster[from_star];
+    if(star_cluster[to_star] != cluster){
+        for(uint32_t lane{graph->get_first_lane(from_star)};lane < graph->get_last_lane(from_star);++lane){
+            if(graph->get_lane_target(lane) == to_star){
+                path = {from_star,to_star};
+                return graph->get_lane_length(lane);
+            }
+        }
+        return -1;
+    }
+    return graph->find_path(from_star,to_star,path,[this,cluster](uint32_t star){
+        return star_cluster[star] == cluster;
+    });
+}
+
+}
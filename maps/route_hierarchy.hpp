@@ -0,0 +1,118 @@
+#ifndef ROUTE_HIERARCHY_HPP
+#define ROUTE_HIERARCHY_HPP
+
+#include "hyperlanes.hpp"
+
+namespace game_maps
+{
+
+//Most stars in a cluster, unless configured otherwise
+static const uint32_t default_route_cluster_stars = 256;
+//Border stars whose distances bound the remaining length of the routes
+static const uint32_t route_landmarks = 8;
+
+class route_hierarchy;
+using route_hierarchy_ptr = std::shared_ptr<const route_hierarchy>;
+
+/*
+ * A route found on the abstract graph: the waypoints are the
+ * departure, the border stars crossed and the destination.
+ * The stars between the waypoints are searched only when the
+ * route is refined, a fleet needs only the next few of them.
+ */
+class hierarchical_route
+{
+    friend class route_hierarchy;
+
+    route_hierarchy_ptr      hierarchy;
+    std::vector<uint32_t>    waypoints;
+    std::vector<body_handle> refined_stars;
+    std::size_t              refined_segments;
+    double                   length;
+public:
+    hierarchical_route();
+    bool found() const;
+    double get_length() const;
+    std::size_t get_segments_count() const;
+    std::size_t get_refined_segments() const;
+    const std::vector<uint32_t>& get_waypoints() const;
+
+    //Refine the next 'segments' segments, return the stars known so far
+    const std::vector<body_handle>& refine(std::size_t segments = 1);
+    const std::vector<body_handle>& refine_all();
+    const std::vector<body_handle>& get_refined_stars() const;
+};
+
+/*
+ * Two levels abstraction of a hyperlane graph. The stars are
+ * grouped in square clusters, split in four like a quadtree
+ * until they hold few stars: the clusters are smaller where
+ * the stars are dense. A star with a lane to another cluster
+ * is a border star. The abstract graph links the border
+ * stars by the lanes between the clusters and by the shortest
+ * paths within each cluster, computed at build time. A route is
+ * searched on the abstract graph, joined to the departure and
+ * destination through their clusters: its length is exact and
+ * the search visits only the border stars. The distances from
+ * few landmarks give a lower bound of the remaining length much
+ * closer than the straight distance along the galaxy arms.
+ * The hierarchy shall be owned by a shared pointer, the routes
+ * keep it alive while they are refined.
+ */
+class route_hierarchy : public std::enable_shared_from_this<route_hierarchy>
+{
+    hyperlane_graph_ptr   graph;
+    uint32_t              cluster_capacity;
+    //The stars of the cluster c are cluster_stars[cluster_offsets[c]..cluster_offsets[c + 1]]
+    std::vector<uint32_t> star_cluster,
+                          cluster_offsets,
+                          cluster_stars,
+    //Abstract graph of the border stars, as CSR
+                          border_stars,
+                          border_of,
+                          border_offsets,
+                          border_targets;
+    std::vector<double>   border_lengths,
+    //Distance of each border star from each landmark, by border star
+                          landmark_distances;
+    game_workers::worker_pool_ptr workers;
+
+    void build_clusters();
+    void split_cluster(std::vector<uint32_t>::iterator first,
+                       std::vector<uint32_t>::iterator last,
+                       double center_x,
+                       double center_y,
+                       double half_size,
+                       uint32_t depth);
+    void link_borders();
+    void select_landmarks();
+    //Distances within the cluster of 'star' from it to the border stars of the cluster
+    void cluster_distances(uint32_t star,
+                           std::vector<std::pair<uint32_t,double>>& distances) const;
+public:
+    route_hierarchy();
+    void configure(game_configuration::game_config_ptr game_conf);
+    void set_worker_pool(game_workers::worker_pool_ptr worker_pool);
+    void set_cluster_capacity(uint32_t max_stars);
+
+    void build(hyperlane_graph_ptr hyperlanes);
+    hyperlane_graph_ptr get_graph() const;
+    uint32_t get_clusters_count() const;
+    uint32_t get_border_stars_count() const;
+    std::size_t get_border_links_count() const;
+
+    hierarchical_route find_route(const body_handle& from,
+                                  const body_handle& to) const;
+    /*
+     * Path between two consecutive waypoints, within their cluster
+     * or along the lane between the clusters. Return its length,
+     * negative if there is none.
+     */
+    double refine_segment(uint32_t from_star,
+                          uint32_t to_star,
+                          std::vector<uint32_t>& path) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,179 @@
+#include "../logger/logger.hpp"
+#include "simd_filter.hpp"
+
+namespace game_maps
+{
+
+namespace
+{
+
+/*
+ * The branchless loop, the index is always written
+ * but the output position advances only for the matches.
+ */
+std::size_t filter_scalar(const uint32_t* x,
+                          const uint32_t* y,
+                          std::size_t count,
+                          const object_area& area,
+                          uint32_t first_index,
+                          uint32_t* found_indexes)
+{
+    std::size_t found{0};
+    for(std::size_t i{0};i<count;i++){
+        found_indexes[found] = first_index + i;
+        found += (x[i] >= area.x_from) & (x[i] <= area.x_to) &
+                 (y[i] >= area.y_from) & (y[i] <= area.y_to);
+    }
+    return found;
+}
+
+#ifdef MAPS_X86_KERNELS
+
+/*
+ * For each mask of matching lanes those tables provide the
+ * shuffle which moves the matching lanes at the beginning
+ * of the register, this is the compressed store.
+ */
+struct compress_tables
+{
+    alignas(32) uint32_t avx2_lanes[256][8];
+    alignas(16) uint8_t  sse_bytes[16][16];
+
+    compress_tables(){
+        for(uint32_t mask{0};mask<256;mask++){
+            uint32_t position{0};
+            for(uint32_t lane{0};lane<8;lane++){
+                if(mask & (1 << lane))
+                    avx2_lanes[mask][position++] = lane;
+            }
+            while(position<8)
+                avx2_lanes[mask][position++] = 0;
+        }
+        for(uint32_t mask{0};mask<16;mask++){
+            uint32_t position{0};
+            for(uint32_t lane{0};lane<4;lane++){
+                if(mask & (1 << lane)){
+                    for(uint32_t byte{0};byte<4;byte++)
+                        sse_bytes[mask][position * 4 + byte] = lane * 4 + byte;
+                    ++position;
+                }
+            }
+            for(uint32_t byte{position * 4};byte<16;byte++)
+                sse_bytes[mask][byte] = 0x80;
+        }
+    }
+};
+
+const compress_tables tables;
+
+/*
+ * There is no unsigned comparison for packed integers,
+ * a value is within [from,to] if clamping it to that range
+ * does not change it.
+ */
+__attribute__((target("sse4.1")))
+std::size_t filter_sse41(const uint32_t* x,
+                         const uint32_t* y,
+                         std::size_t count,
+                         const object_area& area,
+                         uint32_t first_index,
+                         uint32_t* found_indexes)
+{
+    const __m128i x_from = _mm_set1_epi32(area.x_from),
+                  x_to = _mm_set1_epi32(area.x_to),
+                  y_from = _mm_set1_epi32(area.y_from),
+                  y_to = _mm_set1_epi32(area.y_to),
+                  step = _mm_set1_epi32(4);
+    __m128i lanes = _mm_add_epi32(_mm_setr_epi32(0,1,2,3),
+                                  _mm_set1_epi32(first_index));
+    std::size_t found{0},i{0};
+    for(;i + 4 <= count;i += 4){
+        __m128i x_coord = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i)),
+                y_coord = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i));
+        __m128i x_clamp = _mm_min_epu32(_mm_max_epu32(x_coord,x_from),x_to),
+                y_clamp = _mm_min_epu32(_mm_max_epu32(y_coord,y_from),y_to);
+        __m128i inside = _mm_and_si128(_mm_cmpeq_epi32(x_clamp,x_coord),
+                                       _mm_cmpeq_epi32(y_clamp,y_coord));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(inside));
+        __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(tables.sse_bytes[mask]));
+        //found <= i, the store never goes beyond 'count'
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(found_indexes + found),
+                         _mm_shuffle_epi8(lanes,shuffle));
+        found += __builtin_popcount(mask);
+        lanes = _mm_add_epi32(lanes,step);
+    }
+    return found + filter_scalar(x + i,y + i,count - i,area,
+                                 first_index + i,found_indexes + found);
+}
+
+__attribute__((target("avx2")))
+std::size_t filter_avx2(const uint32_t* x,
+                        const uint32_t* y,
+                        std::size_t count,
+                        const object_area& area,
+                        uint32_t first_index,
+                        uint32_t* found_indexes)
+{
+    const __m256i x_from = _mm256_set1_epi32(area.x_from),
+                  x_to = _mm256_set1_epi32(area.x_to),
+                  y_from = _mm256_set1_epi32(area.y_from),
+                  y_to = _mm256_set1_epi32(area.y_to),
+                  step = _mm256_set1_epi32(8);
+    __m256i lanes = _mm256_add_epi32(_mm256_setr_epi32(0,1,2,3,4,5,6,7),
+                                     _mm256_set1_epi32(first_index));
+    std::size_t found{0},i{0};
+    for(;i + 8 <= count;i += 8){
+        __m256i x_coord = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i)),
+                y_coord = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i));
+        __m256i x_clamp = _mm256_min_epu32(_mm256_max_epu32(x_coord,x_from),x_to),
+                y_clamp = _mm256_min_epu32(_mm256_max_epu32(y_coord,y_from),y_to);
+        __m256i inside = _mm256_and_si256(_mm256_cmpeq_epi32(x_clamp,x_coord),
+                                          _mm256_cmpeq_epi32(y_clamp,y_coord));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(inside));
+        __m256i permutation = _mm256_load_si256(reinterpret_cast<const __m256i*>(tables.avx2_lanes[mask]));
+        //found <= i, the store never goes beyond 'count'
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(found_indexes + found),
+                            _mm256_permutevar8x32_epi32(lanes,permutation));
+        found += __builtin_popcount(mask);
+        lanes = _mm256_add_epi32(lanes,step);
+    }
+    return found + filter_scalar(x + i,y + i,count - i,area,
+                                 first_index + i,found_indexes + found);
+}
+
+#endif
+
+}
+
+std::size_t filter_within_area(const uint32_t* x,
+                               const uint32_t* y,
+                               std::size_t count,
+                               const object_area& area,
+                               uint32_t first_index,
+                               uint32_t* found_indexes)
+{
+    return filter_within_area(available_simd_kernel(),x,y,count,
+                              area,first_index,found_indexes);
+}
+
+std::size_t filter_within_area(simd_kernel kernel,
+                               const uint32_t* x,
+                               const uint32_t* y,
+                               std::size_t count,
+                               const object_area& area,
+                               uint32_t first_index,
+                               uint32_t* found_indexes)
+{
+    switch(kernel){
+#ifdef MAPS_X86_KERNELS
+    case simd_kernel::avx2:
+        return filter_avx2(x,y,count,area,first_index,found_indexes);
+    case simd_kernel::sse41:
+        return filter_sse41(x,y,count,area,first_index,found_indexes);
+#endif
+    default:
+        return filter_scalar(x,y,count,area,first_index,found_indexes);
+    }
+}
+
+}
@@ -0,0 +1,37 @@
+#ifndef SIMD_FILTER_HPP
+#define SIMD_FILTER_HPP
+
+#include "position.hpp"
+#include "cpu_features.hpp"
+#include <cstddef>
+
+namespace game_maps
+{
+
+using namespace coordinates;
+
+/*
+ * Write in found_indexes the index (starting from first_index)
+ * of the coordinates within the area, found_indexes shall
+ * have room for 'count' elements. Return the amount of
+ * coordinates found.
+ */
+std::size_t filter_within_area(const uint32_t* x,
+                               const uint32_t* y,
+                               std::size_t count,
+                               const object_area& area,
+                               uint32_t first_index,
+                               uint32_t* found_indexes);
+
+//Use a specific kernel, shall be supported by the CPU
+std::size_t filter_within_area(simd_kernel kernel,
+                               const uint32_t* x,
+                               const uint32_t* y,
+                               std::size_t count,
+                               const object_area& area,
+                               uint32_t first_index,
+                               uint32_t* found_indexes);
+
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include "slot_map.hpp"
+
+namespace game_maps
+{
+
+body_slot_map::body_slot_map() :
+    first_free_slot{no_body}
+{}
+
+/*
+ * Reuse the first free slot if any, its generation was
+ * already moved forward when it was released.
+ */
+body_handle body_slot_map::allocate(uint32_t body_index)
+{
+    uint32_t slot = first_free_slot;
+    if(slot == no_body){
+        slot = slots.size();
+        slots.push_back({body_index,1});
+    }else{
+        first_free_slot = slots[slot].body_index;
+        slots[slot].body_index = body_index;
+    }
+    return body_handle(slot,slots[slot].generation);
+}
+
+void body_slot_map::release(const body_handle& handle)
+{
+    if(!contains(handle))
+        return;
+    auto& slot = slots[handle.slot];
+    //Generation 0 is reserved for the null handle
+    if(++slot.generation == 0){
+        slot.generation = 1;
+    }
+    slot.body_index = first_free_slot;
+    first_free_slot = handle.slot;
+}
+
+void body_slot_map::relocate(const body_handle& handle,
+                             uint32_t new_body_index)
+{
+    if(contains(handle)){
+        slots[handle.slot].body_index = new_body_index;
+    }
+}
+
+void body_slot_map::reserve(std::size_t capacity)
+{
+    slots.reserve(capacity);
+}
+
+void body_slot_map::clear()
+{
+    slots.clear();
+    first_free_slot = no_body;
+}
+
+void body_slot_map::assign(const body_slot* new_slots,
+                           uint32_t slot_count,
+                           uint32_t free_slot)
+{
+    slots.assign(new_slots,new_slots + slot_count);
+    first_free_slot = free_slot;
+}
+
+uint32_t body_slot_map::find(const body_handle& handle) const
+{
+    if(!contains(handle))
+        return no_body;
+    return slots[handle.slot].body_index;
+}
+
+}
@@ -0,0 +1,101 @@
+#ifndef SLOT_MAP_HPP
+#define SLOT_MAP_HPP
+
+#include <stdint.h>
+#include <vector>
+
+namespace game_maps
+{
+
+//Returned when no body satisfy a request
+static const uint32_t no_body = UINT32_MAX;
+
+/*
+ * Stable reference to a body of the universe map, it stays
+ * valid while the body indexes change. Once the body is
+ * removed the slot is reused with a new generation, so
+ * stale handles are detected and never alias a new body.
+ * Generation 0 is never assigned: the default handle
+ * refers to no body.
+ */
+struct body_handle
+{
+    uint32_t slot,
+             generation;
+
+    body_handle(uint32_t slot_index = 0,
+                uint32_t slot_generation = 0) :
+        slot{slot_index},
+        generation{slot_generation}
+    {}
+
+    //The unique id of the body, for the save games and the events
+    uint64_t id() const{
+        return (uint64_t(generation) << 32) | slot;
+    }
+    static body_handle from_id(uint64_t body_id){
+        return body_handle(uint32_t(body_id),uint32_t(body_id >> 32));
+    }
+
+    bool is_null() const{
+        return generation == 0;
+    }
+    bool operator==(const body_handle& other) const{
+        return slot == other.slot && generation == other.generation;
+    }
+    bool operator!=(const body_handle& other) const{
+        return !(*this == other);
+    }
+};
+
+static_assert(sizeof(body_handle) == 8,"body_handle shall fit 8 bytes");
+
+/*
+ * Map from the body handles to the current index of the
+ * bodies in the storage. The released slots are chained in
+ * a free list through their body_index and reused first.
+ */
+class body_slot_map
+{
+public:
+    struct body_slot
+    {
+        uint32_t body_index,
+                 generation;
+    };
+private:
+    std::vector<body_slot> slots;
+    uint32_t               first_free_slot;
+public:
+    body_slot_map();
+
+    body_handle allocate(uint32_t body_index);
+    void release(const body_handle& handle);
+    void relocate(const body_handle& handle,
+                  uint32_t new_body_index);
+    void reserve(std::size_t capacity);
+    void clear();
+    //Replace all the slots, used to restore the snapshots
+    void assign(const body_slot* new_slots,
+                uint32_t slot_count,
+                uint32_t free_slot);
+
+    const std::vector<body_slot>& get_slots() const{
+        return slots;
+    }
+    uint32_t get_first_free_slot() const{
+        return first_free_slot;
+    }
+
+    bool contains(const body_handle& handle) const{
+        return handle.slot < slots.size() &&
+               slots[handle.slot].generation == handle.generation &&
+               handle.generation != 0;
+    }
+    //no_body if the handle is stale
+    uint32_t find(const body_handle& handle) const;
+};
+
+}
+
+#endif
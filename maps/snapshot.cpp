@@ -0,0 +1,317 @@
+#include "../logger/logger.hpp"
+#include "snapshot.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace game_maps
+{
+
+namespace
+{
+
+//The sections are the arrays in memory, they are written as they are
+bool little_endian_host()
+{
+    const uint16_t probe{1};
+    return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+}
+
+uint64_t align_offset(uint64_t offset)
+{
+    return (offset + snapshot_alignment - 1) / snapshot_alignment * snapshot_alignment;
+}
+
+void write_section(std::ofstream& out,
+                   uint64_t offset,
+                   const void* data,
+                   std::size_t size)
+{
+    static const char padding[snapshot_alignment] = {};
+    out.write(padding,offset - out.tellp());
+    out.write(static_cast<const char*>(data),size);
+}
+
+//The section shall be aligned for its type and within the file
+bool section_fits(uint64_t offset,
+                  uint64_t size,
+                  uint64_t file_size)
+{
+    return offset % 8 == 0 && offset <= file_size && size <= file_size - offset;
+}
+
+}
+
+universe_snapshot::universe_snapshot() :
+    mapping{nullptr},
+    mapping_size{0},
+    header{nullptr}
+{}
+
+universe_snapshot::~universe_snapshot()
+{
+    close();
+}
+
+bool universe_snapshot::open(const std::string& file_name)
+{
+    close();
+    LOG3("Opening the snapshot ",file_name.c_str());
+    if(!little_endian_host()){
+        WARN1("The snapshots can be read only on little endian hosts");
+        return false;
+    }
+    int fd = ::open(file_name.c_str(),O_RDONLY);
+    if(fd < 0){
+        WARN1("Unable to open the snapshot ",file_name.c_str());
+        return false;
+    }
+    struct stat file_stat;
+    if(fstat(fd,&file_stat) != 0 || std::size_t(file_stat.st_size) < sizeof(snapshot_header)){
+        WARN1("The snapshot ",file_name.c_str()," is truncated");
+        ::close(fd);
+        return false;
+    }
+    void* file_mapping = mmap(nullptr,file_stat.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    ::close(fd);
+    if(file_mapping == MAP_FAILED){
+        WARN1("Unable to map the snapshot ",file_name.c_str());
+        return false;
+    }
+    mapping = static_cast<const char*>(file_mapping);
+    mapping_size = file_stat.st_size;
+    if(!map_sections()){
+        WARN1("The snapshot ",file_name.c_str()," is not valid");
+        close();
+        return false;
+    }
+    LOG3("Mapped ",header->body_count," bodies from the snapshot");
+    return true;
+}
+
+/*
+ * Only the header is checked, the size of
+ * each section shall match the body count.
+ */
+bool universe_snapshot::map_sections()
+{
+    header = reinterpret_cast<const snapshot_header*>(mapping);
+    if(header->magic != snapshot_magic ||
+       header->version != snapshot_version ||
+       header->header_size != sizeof(snapshot_header) ||
+       header->file_size != mapping_size){
+        return false;
+    }
+    uint64_t bodies = header->body_count;
+    if(!section_fits(header->codes_offset,bodies * sizeof(morton_code),mapping_size) ||
+       !section_fits(header->x_offset,bodies * sizeof(uint32_t),mapping_size) ||
+       !section_fits(header->y_offset,bodies * sizeof(uint32_t),mapping_size) ||
+       !section_fits(header->type_offset,bodies * sizeof(celestial_body_types),mapping_size) ||
+       !section_fits(header->diameter_offset,bodies * sizeof(uint32_t),mapping_size) ||
+       !section_fits(header->name_offset,bodies * sizeof(uint32_t),mapping_size) ||
+       !section_fits(header->handle_offset,bodies * sizeof(body_handle),mapping_size) ||
+       !section_fits(header->slot_offset,
+                     uint64_t(header->slot_count) * sizeof(body_slot_map::body_slot),mapping_size) ||
+       !section_fits(header->name_table_offset,
+                     (uint64_t(header->name_count) + 1) * sizeof(uint64_t),mapping_size) ||
+       !section_fits(header->name_chars_offset,header->name_chars_size,mapping_size)){
+        return false;
+    }
+    codes = reinterpret_cast<const morton_code*>(mapping + header->codes_offset);
+    x = reinterpret_cast<const uint32_t*>(mapping + header->x_offset);
+    y = reinterpret_cast<const uint32_t*>(mapping + header->y_offset);
+    type = reinterpret_cast<const celestial_body_types*>(mapping + header->type_offset);
+    diameter = reinterpret_cast<const uint32_t*>(mapping + header->diameter_offset);
+    body_names = reinterpret_cast<const uint32_t*>(mapping + header->name_offset);
+    handles = reinterpret_cast<const body_handle*>(mapping + header->handle_offset);
+    slots = reinterpret_cast<const body_slot_map::body_slot*>(mapping + header->slot_offset);
+    name_table = reinterpret_cast<const uint64_t*>(mapping + header->name_table_offset);
+    name_chars = mapping + header->name_chars_offset;
+    return true;
+}
+
+void universe_snapshot::close()
+{
+    if(mapping != nullptr){
+        munmap(const_cast<char*>(mapping),mapping_size);
+    }
+    mapping = nullptr;
+    mapping_size = 0;
+    header = nullptr;
+}
+
+bool universe_snapshot::is_open() const
+{
+    return header != nullptr;
+}
+
+/*
+ * The bodies are written in Z-order, so that the codes
+ * can be used as the index. The names are written once
+ * each, the bodies refer them by their index in the
+ * snapshot: the ids of the name pool change at each run.
+ */
+bool universe_snapshot::write(const std::string& file_name,
+                              const body_storage& bodies,
+                              const body_slot_map& body_slots,
+                              uint32_t universe_width,
+                              uint32_t universe_height)
+{
+    LOG3("Writing ",bodies.size()," bodies in the snapshot ",file_name.c_str());
+    if(!little_endian_host()){
+        WARN1("The snapshots can be written only on little endian hosts");
+        return false;
+    }
+    uint32_t body_count = bodies.size();
+    std::vector<std::pair<morton_code,uint32_t>> order(body_count);
+    for(uint32_t body_index{0};body_index < body_count;++body_index){
+        order[body_index] = {morton_encode(bodies.position(body_index)),body_index};
+    }
+    std::sort(order.begin(),order.end());
+
+    std::vector<morton_code> sorted_codes(body_count);
+    std::vector<uint32_t> sorted_x(body_count),
+                          sorted_y(body_count),
+                          sorted_diameter(body_count),
+                          sorted_names(body_count);
+    std::vector<celestial_body_types> sorted_type(body_count);
+    std::vector<body_handle> sorted_handles(body_count);
+    std::vector<body_slot_map::body_slot> slots = body_slots.get_slots();
+    //The empty name is always the first
+    std::unordered_map<name_id,uint32_t> name_indexes{{empty_name,0}};
+    std::vector<uint64_t> name_table{0};
+    std::string name_chars(1,'\0');
+    for(uint32_t position{0};position < body_count;++position){
+        uint32_t body_index = order[position].second;
+        auto body_position = bodies.position(body_index);
+        sorted_codes[position] = order[position].first;
+        sorted_x[position] = body_position.x;
+        sorted_y[position] = body_position.y;
+        sorted_type[position] = bodies.body_type(body_index);
+        sorted_diameter[position] = bodies.body_diameter(body_index);
+        sorted_handles[position] = bodies.handle_of(body_index);
+        slots[sorted_handles[position].slot].body_index = position;
+        auto name = name_indexes.emplace(bodies.body_name_id(body_index),name_table.size());
+        if(name.second){
+            name_table.push_back(name_chars.size());
+            name_chars.append(bodies.body_name(body_index));
+            name_chars.push_back('\0');
+        }
+        sorted_names[position] = name.first->second;
+    }
+    name_table.push_back(name_chars.size());
+
+    snapshot_header header{};
+    header.magic = snapshot_magic;
+    header.version = snapshot_version;
+    header.header_size = sizeof(snapshot_header);
+    header.universe_width = universe_width;
+    header.universe_height = universe_height;
+    header.body_count = body_count;
+    header.name_count = name_table.size() - 1;
+    header.slot_count = slots.size();
+    header.first_free_slot = body_slots.get_first_free_slot();
+    header.codes_offset = align_offset(sizeof(snapshot_header));
+    header.x_offset = align_offset(header.codes_offset + body_count * sizeof(morton_code));
+    header.y_offset = align_offset(header.x_offset + body_count * sizeof(uint32_t));
+    header.type_offset = align_offset(header.y_offset + body_count * sizeof(uint32_t));
+    header.diameter_offset = align_offset(header.type_offset + body_count * sizeof(celestial_body_types));
+    header.name_offset = align_offset(header.diameter_offset + body_count * sizeof(uint32_t));
+    header.handle_offset = align_offset(header.name_offset + body_count * sizeof(uint32_t));
+    header.slot_offset = align_offset(header.handle_offset + body_count * sizeof(body_handle));
+    header.name_table_offset = align_offset(header.slot_offset +
+                                            slots.size() * sizeof(body_slot_map::body_slot));
+    header.name_chars_offset = align_offset(header.name_table_offset +
+                                            name_table.size() * sizeof(uint64_t));
+    header.name_chars_size = name_chars.size();
+    header.file_size = header.name_chars_offset + header.name_chars_size;
+
+    std::string temporary_name = file_name + ".tmp";
+    std::ofstream out(temporary_name,std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header),sizeof(header));
+    write_section(out,header.codes_offset,sorted_codes.data(),body_count * sizeof(morton_code));
+    write_section(out,header.x_offset,sorted_x.data(),body_count * sizeof(uint32_t));
+    write_section(out,header.y_offset,sorted_y.data(),body_count * sizeof(uint32_t));
+    write_section(out,header.type_offset,sorted_type.data(),body_count * sizeof(celestial_body_types));
+    write_section(out,header.diameter_offset,sorted_diameter.data(),body_count * sizeof(uint32_t));
+    write_section(out,header.name_offset,sorted_names.data(),body_count * sizeof(uint32_t));
+    write_section(out,header.handle_offset,sorted_handles.data(),body_count * sizeof(body_handle));
+    write_section(out,header.slot_offset,slots.data(),slots.size() * sizeof(body_slot_map::body_slot));
+    write_section(out,header.name_table_offset,name_table.data(),name_table.size() * sizeof(uint64_t));
+    write_section(out,header.name_chars_offset,name_chars.data(),name_chars.size());
+    out.close();
+    if(!out || std::rename(temporary_name.c_str(),file_name.c_str()) != 0){
+        WARN1("Unable to write the snapshot ",file_name.c_str());
+        std::remove(temporary_name.c_str());
+        return false;
+    }
+    return true;
+}
+
+uint32_t universe_snapshot::get_universe_width() const
+{
+    return is_open() ? header->universe_width : 0;
+}
+
+uint32_t universe_snapshot::get_universe_height() const
+{
+    return is_open() ? header->universe_height : 0;
+}
+
+uint32_t universe_snapshot::get_bodies_count() const
+{
+    return is_open() ? header->body_count : 0;
+}
+
+uint32_t universe_snapshot::get_names_count() const
+{
+    return is_open() ? header->name_count : 0;
+}
+
+uint32_t universe_snapshot::get_slots_count() const
+{
+    return is_open() ? header->slot_count : 0;
+}
+
+uint32_t universe_snapshot::get_first_free_slot() const
+{
+    return is_open() ? header->first_free_slot : no_body;
+}
+
+//The name table is checked here, when the name is read
+std::string_view universe_snapshot::get_name(uint32_t name_index) const
+{
+    if(name_index >= header->name_count)
+        return std::string_view();
+    uint64_t first = name_table[name_index],
+             last = name_table[name_index + 1];
+    if(first >= last || last > header->name_chars_size)
+        return std::string_view();
+    return std::string_view(name_chars + first,last - first - 1);
+}
+
+uint32_t universe_snapshot::find_body(const body_handle& handle) const
+{
+    if(!is_open() || handle.is_null() || handle.slot >= header->slot_count ||
+       slots[handle.slot].generation != handle.generation)
+        return no_body;
+    uint32_t body_index = slots[handle.slot].body_index;
+    return body_index < header->body_count ? body_index : no_body;
+}
+
+std::vector<uint32_t> universe_snapshot::find_bodies_within(const object_area& area) const
+{
+    std::vector<uint32_t> bodies;
+    for_each_body_within(area,[&bodies](uint32_t body_index){
+        bodies.push_back(body_index);
+    });
+    return bodies;
+}
+
+}
@@ -0,0 +1,160 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include "bodies.hpp"
+#include "morton.hpp"
+#include "slot_map.hpp"
+#include <string>
+#include <string_view>
+
+namespace game_maps
+{
+
+//"UGSNAPv1" read as a little endian 64 bit integer
+static const uint64_t snapshot_magic = 0x3176'5041'4e53'4755ULL;
+static const uint32_t snapshot_version = 1;
+//All the sections start at a multiple of this
+static const uint32_t snapshot_alignment = 64;
+
+/*
+ * First bytes of a snapshot file, the offsets are
+ * from the start of the file. Every field is little
+ * endian and the sections hold one value per body,
+ * the bodies are sorted by morton code.
+ */
+struct snapshot_header
+{
+    uint64_t magic;
+    uint32_t version,
+             header_size,
+             universe_width,
+             universe_height,
+             body_count,
+             name_count,
+             slot_count,
+             first_free_slot;
+    uint64_t file_size,
+             codes_offset,
+             x_offset,
+             y_offset,
+             type_offset,
+             diameter_offset,
+             name_offset,
+             handle_offset,
+             slot_offset,
+    //name_count + 1 offsets in the characters, the last is the end
+             name_table_offset,
+             name_chars_offset,
+             name_chars_size;
+};
+
+static_assert(sizeof(snapshot_header) == 136,"The snapshot header layout shall not change");
+
+/*
+ * Binary image of a universe map mapped read only in memory.
+ * Opening a snapshot only checks the header, the bodies are
+ * read straight from the mapping: the sorted morton codes are
+ * the spatial index and the queries walk them as they are.
+ * Nothing is read from the disk before it is touched.
+ */
+class universe_snapshot
+{
+    const char*                      mapping;
+    std::size_t                      mapping_size;
+    const snapshot_header*           header;
+    const morton_code*               codes;
+    const uint32_t*                  x;
+    const uint32_t*                  y;
+    const celestial_body_types*      type;
+    const uint32_t*                  diameter;
+    const uint32_t*                  body_names;
+    const body_handle*               handles;
+    const body_slot_map::body_slot*  slots;
+    const uint64_t*                  name_table;
+    const char*                      name_chars;
+
+    bool map_sections();
+public:
+    universe_snapshot();
+    universe_snapshot(const universe_snapshot&) = delete;
+    universe_snapshot& operator=(const universe_snapshot&) = delete;
+    ~universe_snapshot();
+
+    bool open(const std::string& file_name);
+    void close();
+    bool is_open() const;
+
+    /*
+     * Write the bodies in a new snapshot file, the file
+     * is replaced only once it is completely written.
+     */
+    static bool write(const std::string& file_name,
+                      const body_storage& bodies,
+                      const body_slot_map& body_slots,
+                      uint32_t universe_width,
+                      uint32_t universe_height);
+
+    uint32_t get_universe_width() const;
+    uint32_t get_universe_height() const;
+    uint32_t get_bodies_count() const;
+    uint32_t get_names_count() const;
+
+    object_coordinates get_body_coordinates(uint32_t body_index) const{
+        return object_coordinates(x[body_index],y[body_index]);
+    }
+    celestial_body_types get_body_type(uint32_t body_index) const{
+        return type[body_index];
+    }
+    uint32_t get_body_diameter(uint32_t body_index) const{
+        return diameter[body_index];
+    }
+    const body_handle& get_body_handle(uint32_t body_index) const{
+        return handles[body_index];
+    }
+    uint32_t get_body_name_index(uint32_t body_index) const{
+        return body_names[body_index];
+    }
+    std::string_view get_name(uint32_t name_index) const;
+    std::string_view get_body_name(uint32_t body_index) const{
+        return get_name(body_names[body_index]);
+    }
+    //no_body if the handle is stale
+    uint32_t find_body(const body_handle& handle) const;
+
+    const uint32_t* x_data() const{
+        return x;
+    }
+    const uint32_t* y_data() const{
+        return y;
+    }
+    const celestial_body_types* type_data() const{
+        return type;
+    }
+    const body_handle* handle_data() const{
+        return handles;
+    }
+    const body_slot_map::body_slot* slot_data() const{
+        return slots;
+    }
+    uint32_t get_slots_count() const;
+    uint32_t get_first_free_slot() const;
+
+    std::vector<uint32_t> find_bodies_within(const object_area& area) const;
+    //Call func with the index of each body within the area
+    template<typename FUNC>
+    void for_each_body_within(const object_area& area,
+                              FUNC&& func) const;
+};
+
+template<typename FUNC>
+void universe_snapshot::for_each_body_within(const object_area& area,
+                                             FUNC&& func) const
+{
+    if(!is_open())
+        return;
+    morton_query(codes,header->body_count,area,body_visitor(func));
+}
+
+}
+
+#endif
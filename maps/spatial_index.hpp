@@ -0,0 +1,110 @@
+#ifndef SPATIAL_INDEX_HPP
+#define SPATIAL_INDEX_HPP
+
+#include "position.hpp"
+#include "../workers/workers.hpp"
+#include <vector>
+#include <memory>
+
+namespace game_maps
+{
+
+using namespace coordinates;
+
+class spatial_index;
+
+using spatial_index_ptr = std::unique_ptr<spatial_index>;
+
+enum class spatial_index_type
+{
+    uniform_grid,
+    loose_quadtree,
+    morton_order
+};
+
+/*
+ * Non owning reference to a callable which receives the
+ * index of each body found by a query, it allows to use
+ * lambdas with the spatial indexes without allocations.
+ * The callable shall outlive the visitor.
+ */
+class body_visitor
+{
+    void* callable;
+    void (*invoke)(void*,uint32_t);
+public:
+    template<typename FUNC>
+    body_visitor(FUNC& func) :
+        callable{&func},
+        invoke{[](void* target,uint32_t body_index){
+            (*static_cast<FUNC*>(target))(body_index);
+        }}
+    {}
+
+    void operator()(uint32_t body_index) const{
+        invoke(callable,body_index);
+    }
+};
+
+/*
+ * Same as body_visitor, for the batched queries: the
+ * callable receives also the index of the area in the batch.
+ */
+class area_body_visitor
+{
+    void* callable;
+    void (*invoke)(void*,uint32_t,uint32_t);
+public:
+    template<typename FUNC>
+    area_body_visitor(FUNC& func) :
+        callable{&func},
+        invoke{[](void* target,uint32_t area_index,uint32_t body_index){
+            (*static_cast<FUNC*>(target))(area_index,body_index);
+        }}
+    {}
+
+    void operator()(uint32_t area_index,uint32_t body_index) const{
+        invoke(callable,area_index,body_index);
+    }
+};
+
+/*
+ * Common interface for the structures used by
+ * universe_map to speed up the spatial queries, the
+ * bodies are identified by their index in the
+ * universe_map storage.
+ */
+class spatial_index
+{
+public:
+    virtual void insert(uint32_t body_index,
+                        const object_coordinates& position) = 0;
+    virtual void erase(uint32_t body_index,
+                       const object_coordinates& position) = 0;
+    virtual void relocate(uint32_t body_index,
+                          const object_coordinates& old_position,
+                          const object_coordinates& new_position) = 0;
+    virtual void clear() = 0;
+    /*
+     * Replace the content with the given bodies, indexed
+     * from 0. The workers, if provided, may be used to
+     * speed up the construction.
+     */
+    virtual void build(const uint32_t* x,
+                       const uint32_t* y,
+                       uint32_t count,
+                       game_workers::worker_pool* /*workers*/){
+        clear();
+        for(uint32_t body_index{0};body_index < count;++body_index){
+            insert(body_index,object_coordinates(x[body_index],y[body_index]));
+        }
+    }
+
+    virtual void query(const object_area& area,
+                       body_visitor visitor) const = 0;
+    virtual ~spatial_index() {}
+};
+
+}
+
+#endif
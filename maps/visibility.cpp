@@ -0,0 +1,352 @@
+#include "../logger/logger.hpp"
+#include "visibility.hpp"
+#include "broad_phase.hpp"
+#include <algorithm>
+#include <atomic>
+
+namespace game_maps
+{
+
+namespace
+{
+
+const uint32_t bits_per_word = 64;
+
+bool test_bit(const std::vector<uint64_t>& bits,uint32_t position)
+{
+    return (bits[position / bits_per_word] >> (position % bits_per_word)) & 1;
+}
+
+void flip_bit(std::vector<uint64_t>& bits,uint32_t position)
+{
+    bits[position / bits_per_word] ^= uint64_t(1) << (position % bits_per_word);
+}
+
+}
+
+visibility_map::visibility_map() :
+    universe_width{0},
+    universe_height{0},
+    cell_size{default_visibility_cell_size},
+    cells_per_row{1},
+    cells_per_column{1},
+    last_changed_cells{0}
+{}
+
+void visibility_map::configure(game_configuration::game_config_ptr game_conf)
+{
+    std::string option = game_conf->get_option("visibility_cell_size");
+    if(!option.empty()){
+        set_cell_size(std::stoul(option));
+    }
+}
+
+void visibility_map::set_worker_pool(game_workers::worker_pool_ptr worker_pool)
+{
+    workers = worker_pool;
+}
+
+void visibility_map::set_universe_size(uint32_t width,
+                                       uint32_t height)
+{
+    universe_width = width;
+    universe_height = height;
+    resize_grid(cell_size);
+}
+
+void visibility_map::set_cell_size(uint32_t requested_cell_size)
+{
+    resize_grid(requested_cell_size);
+}
+
+uint32_t visibility_map::get_cell_size() const
+{
+    return cell_size;
+}
+
+/*
+ * The cell size is increased if the requested one would
+ * produce more than max_visibility_cells cells. Nothing is
+ * visible after the resize, the cells covered by the sensors
+ * are marked as changed for the next update.
+ */
+void visibility_map::resize_grid(uint32_t requested_cell_size)
+{
+    uint64_t new_cell_size = std::max<uint32_t>(1,requested_cell_size);
+    uint64_t columns,rows;
+    while(true){
+        columns = std::max<uint64_t>(1,(universe_width + new_cell_size - 1) / new_cell_size);
+        rows = std::max<uint64_t>(1,(universe_height + new_cell_size - 1) / new_cell_size);
+        if(columns * rows <= max_visibility_cells)
+            break;
+        new_cell_size *= 2;
+    }
+    if(new_cell_size != requested_cell_size){
+        WARN1("Visibility cell size ",requested_cell_size," too small for the universe, using ",
+              new_cell_size);
+    }
+    cell_size = new_cell_size;
+    cells_per_row = columns;
+    cells_per_column = rows;
+    LOG3("Visibility grid ready, ",columns,"x",rows," cells of size ",cell_size);
+
+    std::size_t cells = columns * rows,
+                words = (cells + bits_per_word - 1) / bits_per_word;
+    for(auto& vision : players){
+        vision.coverage.assign(cells,0);
+        vision.visible_cells.assign(words,0);
+        vision.changed_marks.assign(words,0);
+        vision.changed_cells.clear();
+        vision.visible_bodies.clear();
+    }
+    for(auto& covering : sensors){
+        cover_cells(covering.second,1);
+    }
+}
+
+uint32_t visibility_map::cell_of(const object_coordinates& position) const
+{
+    return std::min(position.y / cell_size,cells_per_column - 1) * cells_per_row +
+           std::min(position.x / cell_size,cells_per_row - 1);
+}
+
+//The last row and column hold also what is beyond the universe size
+object_area visibility_map::cell_area(uint32_t cell) const
+{
+    uint32_t column = cell % cells_per_row,
+             row = cell / cells_per_row;
+    return object_area(column * cell_size,
+                       column == cells_per_row - 1 ? UINT32_MAX : (column + 1) * cell_size - 1,
+                       row * cell_size,
+                       row == cells_per_column - 1 ? UINT32_MAX : (row + 1) * cell_size - 1);
+}
+
+void visibility_map::mark_changed(player_vision& vision,
+                                  uint32_t cell)
+{
+    if(!test_bit(vision.changed_marks,cell)){
+        flip_bit(vision.changed_marks,cell);
+        vision.changed_cells.push_back(cell);
+    }
+}
+
+/*
+ * Add delta to the counters of the cells touched by the range
+ * of the sensor, a cell is changed when its counter moves
+ * from or to zero.
+ */
+void visibility_map::cover_cells(const sensor& covering,
+                                 int32_t delta)
+{
+    player_vision& vision = players[covering.player];
+    const object_area range_box = proximity_area(covering.position,covering.range);
+    uint32_t first_column = std::min(range_box.x_from / cell_size,cells_per_row - 1),
+             last_column = std::min(range_box.x_to / cell_size,cells_per_row - 1),
+             first_row = std::min(range_box.y_from / cell_size,cells_per_column - 1),
+             last_row = std::min(range_box.y_to / cell_size,cells_per_column - 1);
+    double squared_range = double(covering.range) * covering.range;
+    for(uint32_t row{first_row};row <= last_row;++row){
+        for(uint32_t column{first_column};column <= last_column;++column){
+            uint32_t cell = row * cells_per_row + column;
+            //Distance from the sensor to the closest point of the cell
+            object_area area = cell_area(cell);
+            double dx = covering.position.x < area.x_from ? area.x_from - covering.position.x :
+                        covering.position.x > area.x_to ? covering.position.x - area.x_to : 0,
+                   dy = covering.position.y < area.y_from ? area.y_from - covering.position.y :
+                        covering.position.y > area.y_to ? covering.position.y - area.y_to : 0;
+            if(dx * dx + dy * dy > squared_range)
+                continue;
+            uint32_t& count = vision.coverage[cell];
+            if(delta > 0 ? count++ == 0 : --count == 0){
+                mark_changed(vision,cell);
+            }
+        }
+    }
+}
+
+uint32_t visibility_map::add_player()
+{
+    std::size_t cells = std::size_t(cells_per_row) * cells_per_column,
+                words = (cells + bits_per_word - 1) / bits_per_word;
+    players.emplace_back();
+    player_vision& vision = players.back();
+    vision.coverage.resize(cells);
+    vision.visible_cells.resize(words);
+    vision.changed_marks.resize(words);
+    return players.size() - 1;
+}
+
+uint32_t visibility_map::get_players_count() const
+{
+    return players.size();
+}
+
+bool visibility_map::add_sensor(uint32_t player,
+                                uint64_t sensor_id,
+                                const object_coordinates& position,
+                                uint32_t range)
+{
+    if(player >= players.size()){
+        WARN1("Unknown player ",player," for the sensor ",sensor_id);
+        return false;
+    }
+    auto added = sensors.emplace(sensor_id,sensor{player,position,range});
+    if(!added.second)
+        return false;
+    cover_cells(added.first->second,1);
+    return true;
+}
+
+/*
+ * The new cells are covered before the old ones are released,
+ * the cells covered by both do not appear as changed.
+ */
+bool visibility_map::update_sensor(uint64_t sensor_id,
+                                   const object_coordinates& position,
+                                   uint32_t range)
+{
+    auto moved = sensors.find(sensor_id);
+    if(moved == sensors.end())
+        return false;
+    sensor previous = moved->second;
+    moved->second.position = position;
+    moved->second.range = range;
+    cover_cells(moved->second,1);
+    cover_cells(previous,-1);
+    return true;
+}
+
+bool visibility_map::remove_sensor(uint64_t sensor_id)
+{
+    auto removed = sensors.find(sensor_id);
+    if(removed == sensors.end())
+        return false;
+    cover_cells(removed->second,-1);
+    sensors.erase(removed);
+    return true;
+}
+
+std::size_t visibility_map::get_sensors_count() const
+{
+    return sensors.size();
+}
+
+/*
+ * The cells whose coverage differs from the visible state
+ * are queried in a single batch, the bodies within them are
+ * set or reset all together.
+ */
+std::size_t visibility_map::apply_changes(player_vision& vision,
+                                          const universe_map& star_chart)
+{
+    std::vector<object_area> areas;
+    std::vector<bool> covered;
+    for(uint32_t cell : vision.changed_cells){
+        flip_bit(vision.changed_marks,cell);
+        bool is_covered = vision.coverage[cell] > 0;
+        if(is_covered != test_bit(vision.visible_cells,cell)){
+            flip_bit(vision.visible_cells,cell);
+            areas.push_back(cell_area(cell));
+            covered.push_back(is_covered);
+        }
+    }
+    vision.changed_cells.clear();
+    if(areas.empty())
+        return 0;
+    star_chart.for_each_body_within(areas,[&vision,&covered](uint32_t area_index,
+                                                             const celestial_body_view& body){
+        uint32_t slot = body.get_body_handle().slot;
+        if(covered[area_index]){
+            vision.visible_bodies.set(slot);
+        }else{
+            vision.visible_bodies.reset(slot);
+        }
+    });
+    return areas.size();
+}
+
+//The players are independent, each is updated by a worker
+std::size_t visibility_map::update(const universe_map& star_chart)
+{
+    std::atomic<std::size_t> changed{0};
+    auto update_players = [this,&star_chart,&changed](std::size_t first,std::size_t last){
+        for(std::size_t player{first};player < last;++player){
+            changed += apply_changes(players[player],star_chart);
+        }
+    };
+    if(workers && players.size() > 1){
+        workers->parallel_for(players.size(),update_players,1);
+    }else{
+        update_players(0,players.size());
+    }
+    last_changed_cells = changed;
+    return last_changed_cells;
+}
+
+/*
+ * The handle of a removed body resets its slot, so it shall
+ * be passed before the handle of a body which reuses the slot.
+ */
+void visibility_map::refresh_bodies(const universe_map& star_chart,
+                                    const std::vector<body_handle>& handles)
+{
+    for(const auto& handle : handles){
+        uint32_t body_index = star_chart.find_body(handle);
+        if(body_index == no_body){
+            for(auto& vision : players){
+                vision.visible_bodies.reset(handle.slot);
+            }
+            continue;
+        }
+        uint32_t cell = cell_of(star_chart.get_body(body_index).get_body_coordinates());
+        for(auto& vision : players){
+            if(test_bit(vision.visible_cells,cell)){
+                vision.visible_bodies.set(handle.slot);
+            }else{
+                vision.visible_bodies.reset(handle.slot);
+            }
+        }
+    }
+}
+
+void visibility_map::rebuild(const universe_map& star_chart)
+{
+    LOG3("Rebuilding the visibility of ",players.size()," players");
+    for(auto& vision : players){
+        std::fill(vision.coverage.begin(),vision.coverage.end(),0);
+        std::fill(vision.visible_cells.begin(),vision.visible_cells.end(),0);
+        std::fill(vision.changed_marks.begin(),vision.changed_marks.end(),0);
+        vision.changed_cells.clear();
+        vision.visible_bodies.clear();
+    }
+    for(auto& covering : sensors){
+        cover_cells(covering.second,1);
+    }
+    update(star_chart);
+}
+
+std::size_t visibility_map::get_last_changed_cells() const
+{
+    return last_changed_cells;
+}
+
+const body_bitset& visibility_map::get_visible(uint32_t player) const
+{
+    if(player >= players.size())
+        return nothing_visible;
+    return players[player].visible_bodies;
+}
+
+bool visibility_map::is_visible(uint32_t player,
+                                const body_handle& handle) const
+{
+    return player < players.size() && players[player].visible_bodies.test(handle.slot);
+}
+
+bool visibility_map::is_visible(uint32_t player,
+                                const object_coordinates& position) const
+{
+    return player < players.size() && test_bit(players[player].visible_cells,cell_of(position));
+}
+
+}
@@ -0,0 +1,114 @@
+#ifndef VISIBILITY_HPP
+#define VISIBILITY_HPP
+
+#include "maps.hpp"
+#include <unordered_map>
+
+namespace game_maps
+{
+
+using namespace coordinates;
+
+//Side of the visibility cells, unless configured otherwise
+static const uint32_t default_visibility_cell_size = 4096;
+//Most cells of the visibility grid, bigger cells are used above it
+static const uint32_t max_visibility_cells = 1 << 20;
+
+/*
+ * Fog of war: the universe is split in square cells and each
+ * player sees the bodies in the cells touched by the range of
+ * one of its sensors. For each player the map keeps how many
+ * sensors cover each cell and the bodies visible, one bit for
+ * each body handle slot.
+ * A sensor change updates at once the counters of its cells
+ * and remembers the cells which were covered or uncovered,
+ * update() then touches only the bodies of those cells. The
+ * bodies moved, added or removed since the last update shall
+ * be passed to refresh_bodies().
+ */
+class visibility_map
+{
+    struct sensor
+    {
+        uint32_t           player;
+        object_coordinates position;
+        uint32_t           range;
+    };
+
+    struct player_vision
+    {
+        //Amount of sensors covering each cell
+        std::vector<uint32_t> coverage;
+        //Cells whose bodies are in visible_bodies
+        std::vector<uint64_t> visible_cells,
+        //Cells in changed_cells
+                              changed_marks;
+        std::vector<uint32_t> changed_cells;
+        body_bitset           visible_bodies;
+    };
+
+    uint32_t universe_width,
+             universe_height,
+             cell_size,
+             cells_per_row,
+             cells_per_column;
+    std::vector<player_vision> players;
+    std::unordered_map<uint64_t,sensor> sensors;
+    body_bitset   nothing_visible;
+    std::size_t   last_changed_cells;
+    game_workers::worker_pool_ptr workers;
+
+    void resize_grid(uint32_t requested_cell_size);
+    uint32_t cell_of(const object_coordinates& position) const;
+    object_area cell_area(uint32_t cell) const;
+    void cover_cells(const sensor& covering,
+                     int32_t delta);
+    void mark_changed(player_vision& vision,
+                      uint32_t cell);
+    std::size_t apply_changes(player_vision& vision,
+                              const universe_map& star_chart);
+public:
+    visibility_map();
+    void configure(game_configuration::game_config_ptr game_conf);
+    void set_worker_pool(game_workers::worker_pool_ptr worker_pool);
+    //Both reset what the players see, the next update recomputes it
+    void set_universe_size(uint32_t width,
+                           uint32_t height);
+    void set_cell_size(uint32_t requested_cell_size);
+    uint32_t get_cell_size() const;
+
+    //Return the new player
+    uint32_t add_player();
+    uint32_t get_players_count() const;
+
+    //The sensors are identified by the caller, i.e. by the id of the ship
+    bool add_sensor(uint32_t player,
+                    uint64_t sensor_id,
+                    const object_coordinates& position,
+                    uint32_t range);
+    bool update_sensor(uint64_t sensor_id,
+                       const object_coordinates& position,
+                       uint32_t range);
+    bool remove_sensor(uint64_t sensor_id);
+    std::size_t get_sensors_count() const;
+
+    //Bring the visible bodies up to date with the sensors, return the cells changed
+    std::size_t update(const universe_map& star_chart);
+    //Visibility of bodies moved, added or removed, by their handle
+    void refresh_bodies(const universe_map& star_chart,
+                        const std::vector<body_handle>& handles);
+    //Recompute the coverage and the visible bodies from scratch
+    void rebuild(const universe_map& star_chart);
+    std::size_t get_last_changed_cells() const;
+
+    const body_bitset& get_visible(uint32_t player) const;
+    bool is_visible(uint32_t player,
+                    const body_handle& handle) const;
+    //As of the last update
+    bool is_visible(uint32_t player,
+                    const object_coordinates& position) const;
+};
+
+}
+
+#endif
@@ -14,10 +14,12 @@ runner::runner(){
     game_conf = std::make_shared<game_configuration::configuration_loader>("config.txt");
     game_random_engine = std::make_shared<random_engine::random>();
     game_event_queue = std::make_shared<game_events::events>();
+    game_worker_pool = std::make_shared<game_workers::worker_pool>();
     game_ui = std::make_shared<game_graphics::ui>(game_conf,
                                                   game_event_queue);
 
-    game = std::make_shared<game_engine>();
+    game = std::make_shared<game_engine>(game_conf,
+                                         game_worker_pool);
 
     setup_logger();
 
@@ -33,7 +35,17 @@ void runner::start()
 void runner::game_loop(){
     SET_LOG_THREAD_NAME("GLOOP");
     LOG3("Entering the game loop");
+    event_queue_container_t pending_events;
     while(1){
+        if(!game_event_queue->empty()){
+            game_event_queue->move_events(pending_events);
+        }
+        while(!pending_events.empty()){
+            game->process_event(pending_events.front());
+            pending_events.pop();
+        }
+        game_time->clock_tick();
+        game->tick(game_time->game_time().tick_count);
         std::this_thread::sleep_for(std::chrono::milliseconds{100});
     }
 }
@@ -54,9 +66,55 @@ void runner::setup_logger(){
     }
 }
 
-game_engine::game_engine()
+game_engine::game_engine(game_config_ptr game_conf,
+                         worker_pool_ptr workers)
 {
     LOG3("Starting the game engine");
+    star_chart.set_worker_pool(workers);
+    star_chart.configure(game_conf);
+    orbits.set_worker_pool(workers);
+    galaxy_parameters galaxy_params;
+    galaxy_params.configure(game_conf);
+    //The resident star chart holds a whole galaxy as big as its universe
+    if(star_chart.get_universe_width() > 0 && star_chart.get_universe_height() > 0){
+        uint32_t body_count = galaxy_generator(galaxy_params,workers).populate(star_chart);
+        LOG3("Star chart populated with ",body_count," bodies");
+        orbits.add_planet_orbits(star_chart,0);
+    }
+}
+
+void game_engine::process_event(event_type_ptr game_event)
+{
+    if(game_event->get_id() == 1){
+        auto click = game_event->cast_pointer<mouse_left_button_down_evt>(game_event);
+        select_body_at(click->get_x(),click->get_y());
+    }
+}
+
+//The bodies move at each tick of the game clock
+void game_engine::tick(long long tick_count)
+{
+    orbits.advance(star_chart,tick_count);
+}
+
+/*
+ * Select the body under the mouse click,
+ * if any.
+ */
+void game_engine::select_body_at(uint32_t x,uint32_t y)
+{
+    static const uint32_t click_tolerance{5};
+    uint32_t body_index = star_chart.pick_body(object_coordinates(x,y),
+                                               click_tolerance);
+    if(body_index == no_body){
+        selected_body = body_handle();
+        return;
+    }
+    //The handle stays valid while the bodies are added or removed
+    auto body = star_chart.get_body(body_index);
+    selected_body = body.get_body_handle();
+    LOG3("Selected body ",body.get_body_unique_id()," ",
+         body.get_body_name());
 }
 
 }
@@ -8,6 +8,9 @@
 #include "../configuration/configuration.hpp"
 #include "../random/random.hpp"
 #include "../maps/maps.hpp"
+#include "../maps/generator.hpp"
+#include "../maps/orbits.hpp"
+#include "../workers/workers.hpp"
 
 namespace game_runner
 {
@@ -16,6 +19,7 @@ using namespace game_configuration;
 using namespace game_events;
 using namespace random_engine;
 using namespace game_maps;
+using namespace game_workers;
 
 using game_chrono_pointer = std::shared_ptr<game_chrono::chrono>;
 using game_ui_pointer = std::shared_ptr<game_graphics::ui>;
@@ -23,8 +27,14 @@ using game_ui_pointer = std::shared_ptr<game_graphics::ui>;
 class game_engine
 {
     universe_map star_chart;
+    body_handle  selected_body;
+    orbit_system orbits;
 public:
-    game_engine();
+    game_engine(game_config_ptr game_conf,
+                worker_pool_ptr workers);
+    void process_event(event_type_ptr game_event);
+    void tick(long long tick_count);
+    void select_body_at(uint32_t x,uint32_t y);
 };
 
 using game_engine_ptr = std::shared_ptr<game_engine>;
@@ -36,6 +46,7 @@ class runner
     game_config_ptr     game_conf;
     game_ui_pointer     game_ui;
     random_engine_ptr   game_random_engine;
+    worker_pool_ptr     game_worker_pool;
 
     game_engine_ptr     game;
 
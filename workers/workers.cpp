@@ -0,0 +1,89 @@
+#include "../logger/logger.hpp"
+#include "workers.hpp"
+
+namespace game_workers
+{
+
+worker_pool::worker_pool(uint32_t num_of_workers) :
+    stopping{false}
+{
+    LOG3("Starting the worker pool with ",num_of_workers," workers");
+    for(uint32_t i{0};i < num_of_workers;++i){
+        workers.emplace_back(&worker_pool::worker_loop,this);
+    }
+}
+
+worker_pool::~worker_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(jobs_mtx);
+        stopping = true;
+    }
+    jobs_cv.notify_all();
+    for(auto& worker : workers){
+        worker.join();
+    }
+}
+
+uint32_t worker_pool::size() const
+{
+    return workers.size();
+}
+
+void worker_pool::submit(job_t job)
+{
+    {
+        std::lock_guard<std::mutex> lock(jobs_mtx);
+        jobs.push(std::move(job));
+    }
+    jobs_cv.notify_one();
+}
+
+void worker_pool::submit_background(job_t job)
+{
+    {
+        std::lock_guard<std::mutex> lock(jobs_mtx);
+        background_jobs.push(std::move(job));
+    }
+    jobs_cv.notify_one();
+}
+
+void worker_pool::worker_loop()
+{
+    while(true){
+        job_t job;
+        {
+            std::unique_lock<std::mutex> lock(jobs_mtx);
+            jobs_cv.wait(lock,[this](){
+                return stopping || !jobs.empty() || !background_jobs.empty();
+            });
+            std::queue<job_t>& next_jobs = jobs.empty() ? background_jobs : jobs;
+            if(next_jobs.empty())
+                return;
+            job = std::move(next_jobs.front());
+            next_jobs.pop();
+        }
+        job();
+    }
+}
+
+/*
+ * Executed by the threads waiting for their jobs,
+ * return false if there was nothing to do. The
+ * background jobs are left to the workers.
+ */
+bool worker_pool::run_pending_job()
+{
+    job_t job;
+    {
+        std::lock_guard<std::mutex> lock(jobs_mtx);
+        if(jobs.empty())
+            return false;
+        job = std::move(jobs.front());
+        jobs.pop();
+    }
+    job();
+    return true;
+}
+
+}
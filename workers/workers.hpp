@@ -0,0 +1,131 @@
+#ifndef WORKERS_HPP
+#define WORKERS_HPP
+
+#include <memory>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+#include <iterator>
+
+namespace game_workers
+{
+
+class worker_pool;
+
+using worker_pool_ptr = std::shared_ptr<worker_pool>;
+using job_t = std::function<void()>;
+
+//Below this amount of elements parallel_for does not split the work
+static const std::size_t min_parallel_chunk = 4096;
+
+/*
+ * Pool of threads executing the submitted jobs. A thread
+ * waiting for its jobs to complete executes the pending
+ * jobs in the meanwhile, this allows nested parallel_for.
+ * The background jobs are run only by the idle workers,
+ * after the other jobs, so that a long background job never
+ * delays a thread waiting in parallel_for.
+ */
+class worker_pool
+{
+    std::vector<std::thread> workers;
+    std::queue<job_t>        jobs,
+                             background_jobs;
+    std::mutex               jobs_mtx;
+    std::condition_variable  jobs_cv;
+    bool                     stopping;
+
+    void worker_loop();
+    bool run_pending_job();
+public:
+    explicit worker_pool(uint32_t num_of_workers = std::thread::hardware_concurrency());
+    ~worker_pool();
+    uint32_t size() const;
+    void submit(job_t job);
+    void submit_background(job_t job);
+
+    template<typename FUNC>
+    void parallel_for(std::size_t count,FUNC&& func,
+                      std::size_t min_chunk = min_parallel_chunk);
+};
+
+/*
+ * Call func(first,last) over chunks of [0,count), the
+ * caller executes the first chunk and returns when all
+ * the chunks are done.
+ */
+template<typename FUNC>
+void worker_pool::parallel_for(std::size_t count,FUNC&& func,
+                               std::size_t min_chunk)
+{
+    std::size_t chunks = std::min<std::size_t>(size() + 1,
+                                               std::max<std::size_t>(1,count / std::max<std::size_t>(1,min_chunk)));
+    if(chunks <= 1){
+        func(std::size_t(0),count);
+        return;
+    }
+    std::size_t chunk_size = (count + chunks - 1) / chunks;
+    std::atomic<std::size_t> remaining{chunks - 1};
+    for(std::size_t chunk{1};chunk < chunks;++chunk){
+        std::size_t first = chunk * chunk_size,
+                    last = std::min(count,first + chunk_size);
+        submit([&func,&remaining,first,last](){
+            func(first,last);
+            --remaining;
+        });
+    }
+    func(std::size_t(0),std::min(count,chunk_size));
+    while(remaining > 0){
+        if(!run_pending_job()){
+            std::this_thread::yield();
+        }
+    }
+}
+
+/*
+ * Sort each chunk in parallel and then merge
+ * the sorted chunks in pairs.
+ */
+template<typename ITERATOR,typename COMPARE>
+void parallel_sort(worker_pool* pool,
+                   ITERATOR first,
+                   ITERATOR last,
+                   COMPARE compare)
+{
+    std::size_t count = std::distance(first,last);
+    std::size_t chunks = pool ? std::min<std::size_t>(pool->size() + 1,
+                                                      count / min_parallel_chunk) : 1;
+    if(chunks <= 1){
+        std::sort(first,last,compare);
+        return;
+    }
+    std::size_t chunk_size = (count + chunks - 1) / chunks;
+    pool->parallel_for(chunks,[&](std::size_t from,std::size_t to){
+        for(std::size_t chunk{from};chunk < to;++chunk){
+            std::sort(first + std::min(count,chunk * chunk_size),
+                      first + std::min(count,(chunk + 1) * chunk_size),
+                      compare);
+        }
+    },1);
+    for(std::size_t width{chunk_size};width < count;width *= 2){
+        std::size_t merges = (count + 2 * width - 1) / (2 * width);
+        pool->parallel_for(merges,[&](std::size_t from,std::size_t to){
+            for(std::size_t merge{from};merge < to;++merge){
+                std::size_t begin = merge * 2 * width,
+                            middle = std::min(count,begin + width),
+                            end = std::min(count,begin + 2 * width);
+                std::inplace_merge(first + begin,first + middle,
+                                   first + end,compare);
+            }
+        },1);
+    }
+}
+
+}
+
+#endif